@@ -0,0 +1,6819 @@
+/*
+    UDP client (userspace)
+
+    Runs on Ubuntu 22.04 LTS 64bit with Linux Kernel 6.5+ *ONLY*
+
+    Derived from https://github.com/xdp-project/xdp-tutorial/tree/master/advanced03-AF_XDP
+*/
+
+#define _GNU_SOURCE
+
+#include <memory.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <xdp/xsk.h>
+#include <xdp/libxdp.h>
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/tcp.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <linux/if_link.h>
+#include <linux/if_ether.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <openssl/evp.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+#define MAX_INTERFACES 8
+
+#define MAX_QUEUES 64
+
+#define MAX_SOCKETS ( MAX_INTERFACES * MAX_QUEUES )
+
+#define MAX_THREADS 64
+
+#define MAX_CPUS 1024
+
+const char * INTERFACE_NAME = "enp8s0f0";
+
+const uint8_t CLIENT_ETHERNET_ADDRESS[] = { 0xa0, 0x36, 0x9f, 0x68, 0xeb, 0x98 };
+
+const uint8_t SERVER_ETHERNET_ADDRESS[] = { 0xa0, 0x36, 0x9f, 0x1e, 0x1a, 0xec };
+
+const uint32_t SERVER_IPV4_ADDRESS = 0xc0a8b77c; // 192.168.183.124
+
+const uint8_t SERVER_IPV6_PREFIX[] = { 0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };     // fd00::c0a8:b77c, the same low 32 bits as the ipv4 address
+
+const uint16_t SERVER_PORT = 40000;
+
+const uint16_t CLIENT_PORT = 40000;
+
+#define MAX_PAYLOAD_BYTES 1472
+
+#define MAX_SEND_BATCH_SIZE 256
+
+#define NUM_FRAMES (4096*16)
+
+#define FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
+
+#define INVALID_FRAME UINT64_MAX
+
+#define SLOT_ALIGN_BYTES 64                 // with --unaligned-umem, frames are packed into slots that are a whole number of cache lines
+
+#define HUGE_PAGE_BYTES ( 2 * 1024 * 1024 )
+
+#define WORKING_SET_UNBOUNDED 0
+
+#define WORKING_SET_AUTO -1
+
+#define WORKING_SET_MIN_FRAMES ( 2 * MAX_SEND_BATCH_SIZE )
+
+#define WORKING_SET_SAMPLES 1000            // batches sent unbounded to get the send rate, then timed from queued to completed under the provisional cap, before --working-set auto picks a size
+
+#define WORKING_SET_PROVISIONAL_FRAMES WORKING_SET_MIN_FRAMES   // cap while --working-set auto times completions, so they aren't stuck behind full rings
+
+#define MAX_KSOFTIRQD 1024
+
+#define PACKET_FRAME_SIZE 2048
+
+#define PACKET_BLOCK_SIZE ( 1 << 16 )
+
+#define PACKET_NUM_FRAMES 4096
+
+#define GSO_MAX_SEGMENTS 64
+
+#define MAX_FLOWS ( 1 << 24 )
+
+#define FLOW_TABLE_SAMPLES ( 1 << 20 )
+
+#define RSS_MAX_KEY_BYTES 52
+
+#define RSS_MAX_INDIRECTION 4096
+
+#define RSS_MAX_QUEUES 256
+
+#define MAX_FRAME_BYTES 2048
+
+#define MAX_CHECKSUM_SPANS 8
+
+#define TCP_SYN_BYTES 40                            // tcp header with mss, sack permitted, timestamp and window scale options
+
+#define DNS_HEADER_BYTES 12
+
+#define DNS_LABEL_BYTES 8                           // random label in front of the domain, so every query misses the cache
+
+#define MAX_DESTINATIONS 256
+
+#define CHECKSUM_WIDE_BYTES 64                      // checksum spans this long go through checksum_add_wide
+
+#define CHECKSUM_TIME_INTERVAL 64                   // one packet in this many has its l4 checksum timed
+
+#define CRC_TAG_BYTES 4                             // crc32c of the rest of the payload, little endian, at the end of the payload
+
+#define CRC32C_POLYNOMIAL 0x82F63B78                // reflected
+
+#define CRC32C_STREAM_BYTES 128                     // each of the three interleaved streams in crc32c_update_pclmul
+
+#define AEAD_NONCE_BYTES 8                          // an encrypted payload is the nonce, the ciphertext, then the tag
+#define AEAD_TAG_BYTES 16
+#define AEAD_OVERHEAD_BYTES ( AEAD_NONCE_BYTES + AEAD_TAG_BYTES )
+#define AEAD_IV_BYTES 12                            // four zero bytes, then the nonce
+#define AEAD_MAX_KEY_BYTES 32
+
+
+#define MAX_DESTINATION_SCHEDULE 65536               // sum of destination weights
+
+#define MAX_SIZES 64
+
+#define SIZE_TABLE_SAMPLES ( 1 << 16 )
+
+#define NUM_SIZE_CLASSES 5
+
+#define MAX_TEMPLATES 4096                          // destinations times sizes, per socket
+
+#define MAX_DNS_NAME_BYTES 255
+
+#define VXLAN_PORT 4789
+
+#define GUE_PORT 6080
+
+#define GRE_FLAG_KEY 0x2000
+
+#define RSS_INPUT_BYTES 36                          // ipv6 source and destination address, source and destination port
+
+enum backend_type_t
+{
+    BACKEND_XDP,                    // AF_XDP zero copy, the default
+    BACKEND_SENDMMSG,               // regular udp sockets, one sendmmsg per batch
+    BACKEND_GSO,                    // udp sockets with UDP_SEGMENT, so the kernel splits each send into up to 64 packets
+    BACKEND_PACKET,                 // AF_PACKET with a TPACKET_V3 tx ring and PACKET_QDISC_BYPASS
+    BACKEND_NUM_BACKENDS
+};
+
+int backend = BACKEND_XDP;
+
+bool run_all_backends = false;      // --backend all runs each backend for --duration seconds, then prints a comparison table
+
+int duration_seconds = 0;           // 0 means run until CTRL-C
+
+volatile int payload_bytes = 32;
+
+volatile int send_batch_size = 256; // packets per batch, up to MAX_SEND_BATCH_SIZE
+
+const char * config_filename = NULL;    // re-read on SIGHUP, so queues, threads, batch size etc. can change without a restart
+
+bool follow_channels = false;       // add or remove sockets when the channel count on the nic changes
+
+const char * daemon_socket_path = NULL; // in daemon mode we set everything up, then wait for commands on this unix socket
+
+volatile bool paused = false;       // socket threads stop sending, but keep their sockets and umem
+
+volatile uint64_t send_rate = 0;    // packets per second across all sockets. 0 means as fast as we can
+
+enum flow_distribution_t
+{
+    FLOW_DISTRIBUTION_SEQUENTIAL,   // each socket thread cycles through its share of the flows in order
+    FLOW_DISTRIBUTION_RANDOM,       // every packet picks a flow uniformly at random
+    FLOW_DISTRIBUTION_ZIPF,         // every packet picks a flow from a zipf distribution, so a few flows get most of the packets
+    FLOW_DISTRIBUTION_FIXED,        // like sequential, but each flow gets exactly flow_packets_per_flow packets in a row
+    FLOW_DISTRIBUTION_NUM_DISTRIBUTIONS
+};
+
+const char * flow_distribution_names[] = { "sequential", "random", "zipf", "fixed" };
+
+struct flow_range_t
+{
+    uint32_t first;                 // host byte order
+    uint32_t last;
+};
+
+bool ipv6 = false;                  // send ipv6/udp instead of ipv4/udp. flows only vary the low 32 bits of each ipv6 address
+
+uint8_t flow_source_prefix[12];     // upper 96 bits of ipv6 source and destination addresses
+uint8_t flow_destination_prefix[12];
+
+struct flow_range_t flow_source_addresses;  // ipv4 address, or the low 32 bits of an ipv6 address
+struct flow_range_t flow_destination_addresses;
+struct flow_range_t flow_source_ports;
+struct flow_range_t flow_destination_ports;
+
+enum profile_t
+{
+    PROFILE_UDP,                    // udp to the flow's destination port, with --payload-bytes of payload
+    PROFILE_TCP_SYN,                // tcp syn with a random isn, and mss, sack permitted, timestamp and window scale options
+    PROFILE_ICMP,                   // icmp or icmpv6 echo request. the flow's source port is the identifier, and the sequence number counts up
+    PROFILE_DNS,                    // dns query for a random label under --dns-domain, with a random id
+    PROFILE_NUM_PROFILES
+};
+
+const char * profile_names[] = { "udp", "tcp-syn", "icmp", "dns" };
+
+int profile = PROFILE_UDP;
+
+const char * dns_domain = "example.com";
+
+uint8_t dns_question[MAX_DNS_NAME_BYTES + 4];   // encoded name with a zeroed random label first, then type A and class IN
+
+int dns_question_bytes = 0;
+
+enum encap_type_t
+{
+    ENCAP_NONE,
+    ENCAP_VXLAN,                    // outer ipv4 + udp + vxlan header + inner ethernet
+    ENCAP_GRE,                      // outer ipv4 + gre header with a key
+    ENCAP_GUE,                      // outer ipv4 + udp + gue header, with the inner ip packet directly after
+    ENCAP_NUM_TYPES
+};
+
+const char * encap_names[] = { "none", "vxlan", "gre", "gue" };
+
+int encap = ENCAP_NONE;
+
+uint32_t outer_source_address = 0xc0a80001;             // 192.168.0.1, host byte order
+
+uint32_t outer_destination_address = 0xc0a8b77c;        // 192.168.183.124
+
+struct flow_range_t outer_source_ports = { 49152, 65535 };  // each flow picks one from a hash of its inner tuple, so tunnels have entropy
+
+int outer_destination_port = 0;     // 0 means the usual port for the tunnel
+
+uint32_t tunnel_id = 1;             // vxlan network identifier or gre key
+
+struct destination_t
+{
+    uint8_t ethernet_address[ETH_ALEN];
+    uint8_t prefix[12];                 // upper 96 bits of an ipv6 address
+    uint32_t address;                   // network byte order. ipv4 address, or the low 32 bits of an ipv6 address
+    uint16_t port;                      // network byte order
+    int weight;
+    char name[INET6_ADDRSTRLEN + 8];    // address and port, for the stats
+};
+
+enum destination_schedule_t
+{
+    DESTINATION_SCHEDULE_WEIGHTED,      // each destination gets its weight's share of packets, spread evenly through the schedule
+    DESTINATION_SCHEDULE_ROUND_ROBIN,   // one packet to each destination in turn, ignoring weights
+    DESTINATION_SCHEDULE_NUM_SCHEDULES
+};
+
+const char * destination_schedule_names[] = { "weighted", "round-robin" };
+
+const char * destinations_filename = NULL;  // mac, address, port and optional weight per line. without it, the destination comes from the flow
+
+int num_destinations = 0;
+
+struct destination_t destination[MAX_DESTINATIONS];
+
+int destination_schedule_type = DESTINATION_SCHEDULE_WEIGHTED;
+
+uint8_t destination_schedule[MAX_DESTINATION_SCHEDULE];    // destination index for each packet in turn, shared by every socket
+
+int destination_schedule_length = 0;
+
+struct packet_size_t
+{
+    int frame_bytes;                    // on the wire, with the fcs, after clamping to what fits our headers and the mtu
+    int payload_bytes;
+    uint64_t weight;
+    int size_class;                     // smallest class with a slot that holds the frame
+};
+
+const int size_class_slot_bytes[NUM_SIZE_CLASSES] = { 128, 256, 512, 1024, 2048 };    // frames in each class fit a slot this big. all divide FRAME_SIZE
+
+const char * size_class_names[NUM_SIZE_CLASSES] = { "128", "256", "512", "1024", "2048" };
+
+enum payload_mode_t
+{
+    PAYLOAD_MODE_RAMP,              // 0, 1, 2, 3... the same for every packet
+    PAYLOAD_MODE_RANDOM,            // every byte random, different for every packet
+    PAYLOAD_MODE_RANDOM_TAIL,       // the ramp, with the last random_tail_bytes random
+    PAYLOAD_MODE_NUM_MODES
+};
+
+const char * payload_mode_names[] = { "ramp", "random", "random-tail" };
+
+int payload_mode = PAYLOAD_MODE_RAMP;
+
+int random_tail_bytes = 16;
+
+bool crc_tag = false;               // end each udp payload with a crc32c of the rest of it, so the server can check it
+
+bool benchmark_crc = false;
+
+uint32_t crc32c_table[8][256];
+
+uint64_t crc32c_shift_constant[2];  // x^(8n-33) mod p, for shifting a crc over n = 1 and 2 streams of bytes
+
+enum aead_type_t
+{
+    AEAD_NONE,
+    AEAD_AES_128_GCM,
+    AEAD_AES_256_GCM,
+    AEAD_CHACHA20_POLY1305,
+    AEAD_NUM_TYPES
+};
+
+const char * aead_names[] = { "none", "aes-128-gcm", "aes-256-gcm", "chacha20-poly1305" };
+
+const int aead_key_bytes[] = { 0, 16, 32, 32 };
+
+int aead = AEAD_NONE;               // encrypt each udp payload, like game traffic is
+
+int aead_key_bytes_given = 0;       // from --aead-key. 0 means the default key
+
+bool udp_checksum = false;          // fill in udp checksums over ipv4 too. ipv6 always has them
+
+bool unaligned_umem = false;        // register the umem with XDP_UMEM_UNALIGNED_CHUNK_FLAG, and pack frames into cache line slots instead of chunks
+
+int working_set_frames = WORKING_SET_UNBOUNDED;     // cap on frames in flight per socket, or auto to size it from the send rate and completion latency
+
+bool report_working_set = false;    // --working-set was given, even as unbounded, so print the umem touched and llc misses per packet
+
+enum long_option_t                  // long options without a letter, now those have run out
+{
+    OPTION_IPV6 = 256,
+    OPTION_DESTINATION_SCHEDULE,
+    OPTION_SIZES,
+    OPTION_SIZES_FILE,
+    OPTION_PAYLOAD_MODE,
+    OPTION_RANDOM_TAIL_BYTES,
+    OPTION_CRC,
+    OPTION_BENCHMARK_CRC,
+    OPTION_AEAD,
+    OPTION_AEAD_KEY,
+    OPTION_UDP_CHECKSUM,
+    OPTION_UNALIGNED_UMEM,
+    OPTION_WORKING_SET,
+};
+
+uint8_t aead_key[AEAD_MAX_KEY_BYTES] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+                                         0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+
+struct random_lanes_t
+{
+    uint64_t s[4][4];                   // xoshiro256++ state word, then lane. each word of all four lanes is one avx2 register
+};
+
+void random_fill_scalar( struct random_lanes_t * lanes, uint8_t * data, int bytes );
+
+void ( *random_fill )( struct random_lanes_t * lanes, uint8_t * data, int bytes ) = random_fill_scalar;    // avx2 if the cpu has it
+
+const char * sizes_spec = NULL;     // imix, or size:weight,... with frame sizes including the fcs
+const char * sizes_filename = NULL; // histogram, one "size count" or "first-last count" per line
+
+int num_sizes = 0;                  // 0 means every packet has payload_bytes of payload
+
+struct packet_size_t packet_size[MAX_SIZES];
+
+uint8_t size_table[SIZE_TABLE_SAMPLES];     // size index for each packet in turn, shuffled, with each size in proportion to its weight
+
+int vlan_tags = 0;                  // 1 for an 802.1Q tag, 2 for qinq: an 802.1ad service tag, then an 802.1Q tag
+
+struct flow_range_t flow_vlan_ids;  // flow n gets the nth combination of vlan ids, with the inner id varying fastest
+struct flow_range_t flow_outer_vlan_ids;
+
+int num_flows = 256;                // flow n is tuple n in the space above, with source address varying fastest, then source port, destination address, destination port
+
+int flow_distribution = FLOW_DISTRIBUTION_SEQUENTIAL;
+
+double flow_zipf_s = 1.0;
+
+int flow_packets_per_flow = 64;
+
+uint64_t flow_seed = 1;
+
+double * flow_zipf_cdf = NULL;
+
+uint64_t * flow_tuple_index = NULL; // if set, flow n is tuple flow_tuple_index[n], picked so flows land on server queues the way we want
+
+uint8_t rss_key[RSS_MAX_KEY_BYTES]; // the server nic's rss key. if we have one we predict which server queue each flow lands on
+
+int rss_key_bytes = 0;
+
+int rss_indirection[RSS_MAX_INDIRECTION];
+
+int rss_indirection_size = 0;       // 0 means hash % rss_queues, like a default indirection table
+
+int rss_queues = 0;                 // server queues to spread flows over. 0 means every queue in the indirection table
+
+bool rss_hash_ports = true;         // udp 4-tuple hash. false means the nic only hashes the addresses
+
+double rss_weight[RSS_MAX_QUEUES];  // share of flows for each server queue. all equal if not set
+
+int num_rss_weights = 0;
+
+uint32_t rss_table[RSS_INPUT_BYTES][256];
+
+enum drive_mode_t
+{
+    DRIVE_MODE_ALWAYS_KICK,         // sendto on every kick, socket bound without XDP_USE_NEED_WAKEUP
+    DRIVE_MODE_NEED_WAKEUP,         // sendto only when the driver sets the need wakeup flag on the send queue
+    DRIVE_MODE_POLL,                // poll( POLLOUT ) on every kick instead of sendto
+    DRIVE_MODE_BUSY_POLL,           // SO_PREFER_BUSY_POLL + SO_BUSY_POLL_BUDGET, sendto on every kick drives the napi loop
+    DRIVE_MODE_IO_URING,            // like need wakeup, but the sendmsg is submitted to an SQPOLL io_uring, so we don't enter the kernel
+    DRIVE_MODE_NUM_MODES
+};
+
+const char * drive_mode_names[] = { "always-kick", "need-wakeup", "poll", "busy-poll", "io-uring" };
+
+// these can be overridden on the command line, see print_usage
+
+volatile int drive_mode = DRIVE_MODE_NEED_WAKEUP;
+
+int compare_seconds = 0;            // if non-zero, switch between need-wakeup and io-uring modes every n seconds and print a summary at the end
+
+int uring_sq_idle = 1000;           // milliseconds the io_uring SQPOLL kernel thread spins before it goes to sleep
+
+int uring_sq_cpu = -1;              // cpu to pin the io_uring SQPOLL kernel threads to. -1 means don't pin
+
+volatile int kick_every = 1;        // kick at most once every n batches
+
+volatile int kick_threshold = 0;    // if non-zero, kick only once at least this many descriptors are outstanding in the send queue
+
+int busy_poll_usecs = 20;
+
+int busy_poll_budget = 64;
+
+enum idle_strategy_t
+{
+    IDLE_STRATEGY_SPIN,             // always spin in socket_update, 100% cpu per socket thread
+    IDLE_STRATEGY_ADAPTIVE,         // spin, then pause, then block in poll until the send queue has room again, or sleep while waiting on completions
+    IDLE_STRATEGY_NUM_STRATEGIES
+};
+
+const char * idle_strategy_names[] = { "spin", "adaptive" };
+
+int idle_strategy = IDLE_STRATEGY_ADAPTIVE;
+
+volatile int idle_spin_iterations = 1024; // empty socket updates before we start pausing
+
+volatile int idle_pause_iterations = 1024; // empty socket updates with a pause instruction before we block in poll
+
+volatile int idle_poll_timeout = 1; // milliseconds
+
+#define IDLE_SLEEP_NANOSECONDS 20000    // how long an idle xdp socket thread sleeps while its rings have room but nothing has completed
+
+#define RATE_SPIN_NANOSECONDS 50000     // with --rate, sleep until this long before the next round, then spin the rest, since sleeps overshoot
+
+int num_interfaces = 1;
+
+const char * interface_names[MAX_INTERFACES];
+
+int num_queues = 4;                 // one xsk socket per nic queue per interface, starting at queue 0
+
+int num_threads = 0;                // socket threads. 0 means one per socket
+
+bool thread_per_socket = false;     // set when num_threads was 0, so the thread count follows the queue count
+
+int socket_thread_index[MAX_SOCKETS];   // which thread drives each socket. -1 means round robin
+
+int thread_cpu[MAX_THREADS];        // which cpu each thread is pinned to. -1 means pick a cpu on the numa node of its first nic
+
+struct interface_t
+{
+    const char * name;
+    int interface_index;
+    int numa_node;
+    uint8_t ethernet_address[ETH_ALEN];
+    struct xdp_program * program;
+    bool attached_native;
+    bool attached_skb;
+    uint64_t previous_sent_packets;
+    uint64_t retired_sent_packets;      // sent by sockets that were removed on reconfigure
+};
+
+struct checksum_span_t
+{
+    int offset;                         // from the start of the frame. always even, so words line up with the checksummed data
+    int bytes;
+};
+
+struct packet_template_t;
+
+struct flow_t;
+
+typedef int ( *packet_writer_t )( uint8_t * packet, const struct packet_template_t * template, const struct flow_t * flow );
+
+struct packet_template_t
+{
+    uint8_t data[MAX_FRAME_BYTES];      // the frame for an all zero flow. everything that changes per packet is zero here
+    packet_writer_t write;              // writer for the template's header stack with its offsets built in, or NULL for the generic path
+    int bytes;
+    int payload_bytes;                  // what it was built for, so it's rebuilt when payload bytes change. 0 until built
+    int vlan_offset;                    // where each per packet field goes, or 0 if the frame doesn't have it
+    int outer_vlan_offset;
+    int outer_port_offset;
+    int address_offset;                 // source address, or the low 32 bits of it with ipv6
+    int address_stride;                 // from the source address to the destination address
+    int port_offset;                    // source and destination port, or the icmp identifier
+    int sequence_offset;                // tcp sequence number, icmp sequence number or dns id
+    int timestamp_offset;               // tcp timestamp value
+    int name_offset;                    // random dns label
+    int random_offset;                  // random payload bytes, up to the crc tag or the end of the frame
+    int random_bytes;
+    int crc_offset;                     // crc tag over random bytes, or 0 if the tag is constant and already in data
+    uint32_t crc_base;                  // crc state over the payload bytes in front of the random ones
+    int aead_offset;                    // payload to encrypt after the packet is written, or 0. the l4 checksum waits for it
+    int aead_bytes;
+    int ip_checksum_offset;             // ipv4 header checksum
+    uint64_t ip_checksum_base;          // sum of the header without the addresses
+    int l4_checksum_offset;
+    uint64_t l4_checksum_base;          // sum of the pseudo header and l4 bytes that don't change per packet
+    int num_l4_spans;
+    struct checksum_span_t l4_span[MAX_CHECKSUM_SPANS];     // bytes under the l4 checksum that change per packet
+};
+
+struct frame_pool_t
+{
+    uint64_t * frames;                  // stack of free frames
+    uint32_t num_frames;
+    uint32_t max_frames;
+    uint64_t first_address;             // the pool's slots are all the umem from here to end_address
+    uint64_t end_address;
+    int slot_bytes;
+    uint32_t min_free_frames;           // kept back to cap the working set. the stack is lifo, so frames below these are never touched
+    uint32_t low_frames;                // fewest free frames seen, so max_frames - low_frames have been touched
+};
+
+struct socket_t
+{
+    struct interface_t * interface;
+    int fd;
+    void * buffer;
+    size_t buffer_bytes;
+    bool buffer_huge;                   // mapped from huge pages, so munmap it rather than free
+    uint64_t contiguous_bytes;          // slots don't cross a multiple of this: a chunk, or a page of the umem when it is unaligned
+    struct xsk_umem * umem;
+    struct xsk_ring_prod send_queue;
+    struct xsk_ring_cons complete_queue;
+    struct xsk_ring_prod fill_queue; // not used
+    struct xsk_socket * xsk;
+    uint64_t frames[NUM_FRAMES];        // free frame stacks, one slice per pool
+    struct frame_pool_t pool[NUM_SIZE_CLASSES];     // with sizes, one pool per size class in use. otherwise pool 0 has every frame
+    uint64_t sent_packets;
+    uint64_t queued_packets;
+    uint64_t kicks;
+    uint64_t kick_syscalls;
+    uint32_t counter;
+    uint32_t batches_since_kick;
+    struct uring_t * uring;
+    bool uring_pending;
+    struct flow_table_t * flow_table;   // owned by the socket thread driving this socket
+    void * packet_ring;                 // AF_PACKET tx ring
+    size_t packet_ring_bytes;
+    uint32_t packet_send_index;
+    uint32_t packet_complete_index;
+    uint32_t packet_in_flight;
+    int segment_bytes;                  // UDP_SEGMENT size currently set on a gso socket
+    int queue_id;
+    bool initialized;
+    uint64_t random_state;              // tcp sequence numbers, dns ids and labels
+    struct random_lanes_t random_lanes; // random payloads
+    struct packet_template_t * template;    // the packet we send for each destination and size, with patch points for everything that changes per packet
+    int template_payload_bytes;         // payload bytes the templates were built for, so they're rebuilt when it changes. 0 until built
+    uint32_t destination_index;         // where this socket is in the destination schedule
+    uint32_t size_table_index;          // where this socket is in the size table
+    uint64_t destination_sent_packets[MAX_DESTINATIONS];   // counted as packets are queued. only the socket thread writes them
+    uint64_t size_sent_packets[MAX_SIZES];
+    EVP_CIPHER_CTX * aead_context;      // keyed once. each packet only sets the iv
+    uint64_t aead_nonce;
+    uint64_t aead_packets;
+    uint64_t aead_cycles;               // tsc cycles spent encrypting, not counting the checksums after
+    uint64_t checksum_packets;          // packets that had their l4 checksum timed, one in CHECKSUM_TIME_INTERVAL
+    uint64_t checksum_cycles;
+    int num_unsealed;                   // payloads written this batch that still need encrypting, see socket_seal_packets
+    uint8_t * unsealed_payload[MAX_SEND_BATCH_SIZE];
+    int unsealed_payload_bytes[MAX_SEND_BATCH_SIZE];
+    uint8_t * unsealed_packet[MAX_SEND_BATCH_SIZE];     // with its template, to finish the l4 checksum. NULL with the udp socket backends
+    const struct packet_template_t * unsealed_template[MAX_SEND_BATCH_SIZE];
+    uint32_t working_set_frames;        // frames this socket may have in flight. 0 is unbounded. the provisional cap while measuring with --working-set auto
+    bool measuring_working_set;         // with --working-set auto, until the working set is sized
+    uint64_t working_set_start_tsc;     // with --working-set auto: when the socket started measuring its rate, and what it had sent by then
+    uint64_t working_set_start_packets;
+    double working_set_packets_per_tsc; // the send rate while unbounded. 0 until it's measured
+    uint64_t timed_batch_tsc;           // one batch at a time is timed from queued to completed. 0 when none is
+    uint64_t timed_batch_end;           // queued_packets once that batch was in
+    uint64_t max_completion_tsc;
+    int completion_samples;
+};
+
+struct uring_t
+{
+    int fd;
+    unsigned entries;
+    unsigned * sq_head;
+    unsigned * sq_tail;
+    unsigned * sq_mask;
+    unsigned * sq_flags;
+    unsigned * sq_array;
+    struct io_uring_sqe * sqes;
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    unsigned * cq_mask;
+    struct io_uring_cqe * cqes;
+    void * sq_ring;
+    size_t sq_ring_bytes;
+    void * cq_ring;
+    size_t cq_ring_bytes;
+    size_t sqes_bytes;
+    struct msghdr msg;
+};
+
+struct flow_t
+{
+    uint32_t source_address;        // network byte order, ready to write into the packet
+    uint32_t destination_address;
+    uint16_t source_port;
+    uint16_t destination_port;
+    uint16_t vlan_tci;              // network byte order, only used with vlan tags
+    uint16_t outer_vlan_tci;
+    uint16_t outer_source_port;     // network byte order, only used with udp tunnels
+};
+
+struct flow_table_t
+{
+    struct flow_t * flow;
+    uint32_t num_flows;
+    uint32_t index;
+    uint32_t repeat;
+    uint32_t packets_per_flow;
+};
+
+struct thread_t
+{
+    struct client_t * client;
+    int thread_index;
+    int init_result;
+    int cpu;
+    int num_sockets;
+    struct socket_t * socket[MAX_SOCKETS];
+    uint64_t idle_nanoseconds;
+    uint64_t next_send_nanoseconds;
+    int flow_partition;                 // this thread sends flows n where n % num_flow_partitions == flow_partition
+    int num_flow_partitions;
+    struct flow_table_t flow_table;
+    struct uring_t uring;
+};
+
+struct client_t
+{
+    struct interface_t interface[MAX_INTERFACES];
+    int num_sockets;
+    struct socket_t * socket[MAX_SOCKETS];     // socket for queue q on interface i is socket[i*MAX_QUEUES+q], so sockets stay put when the queue count changes
+    struct thread_t thread[MAX_THREADS];
+    pthread_t stats_thread;
+    pthread_t socket_thread[MAX_THREADS];
+    bool socket_thread_created[MAX_THREADS];
+    volatile bool stop_socket_threads;
+    pthread_barrier_t ready_barrier;
+    pthread_barrier_t go_barrier;
+    uint64_t start_tsc;
+    double tsc_per_millisecond;
+    uint64_t setup_nanoseconds;
+    pthread_mutex_t mutex;              // held by the stats thread while it reads sockets, and while sockets are added or removed
+    bool stats_thread_created;
+    uint64_t retired_kicks;
+    uint64_t retired_kick_syscalls;
+    uint64_t retired_destination_sent_packets[MAX_DESTINATIONS];
+    uint64_t retired_size_sent_packets[MAX_SIZES];
+    uint64_t retired_aead_packets;
+    uint64_t retired_aead_cycles;
+    uint64_t retired_checksum_packets;
+    uint64_t retired_checksum_cycles;
+    uint64_t previous_sent_packets;
+    uint64_t previous_destination_sent_packets[MAX_DESTINATIONS];
+    uint64_t previous_size_sent_packets[MAX_SIZES];
+    uint64_t previous_kicks;
+    uint64_t previous_kick_syscalls;
+    uint64_t previous_aead_packets;
+    uint64_t previous_aead_cycles;
+    uint64_t previous_checksum_packets;
+    uint64_t previous_checksum_cycles;
+    uint64_t previous_idle_nanoseconds;
+    int num_ksoftirqd;
+    int ksoftirqd_pid[MAX_KSOFTIRQD];
+    uint64_t previous_ksoftirqd_ticks;
+    uint64_t previous_cpu_microseconds;
+    uint64_t total_seconds;
+    uint64_t total_sent_packets;
+    double total_cpu;
+    double total_ksoftirqd_cpu;
+    uint64_t last_sent_delta;           // last second, for the stats control command
+    double last_cpu;
+    double last_ksoftirqd_cpu;
+    int llc_miss_fd;                    // with --working-set: last level cache misses of every thread in the process, or -1
+    uint64_t previous_llc_misses;
+};
+
+struct backend_t
+{
+    const char * name;
+    int ( *init )( struct socket_t * socket );
+    bool ( *update )( struct socket_t * socket );
+    void ( *shutdown )( struct socket_t * socket );
+};
+
+extern const struct backend_t backends[BACKEND_NUM_BACKENDS];
+
+volatile bool quit;
+
+static void * stats_thread( void * arg );
+static void * socket_thread( void * arg );
+static void find_ksoftirqd_threads( struct client_t * client );
+static uint64_t get_ksoftirqd_ticks( struct client_t * client );
+static uint64_t get_cpu_microseconds();
+static inline uint64_t get_nanoseconds();
+static inline uint64_t get_tsc();
+int flow_init();
+int client_frame_bytes( int payload_bytes );
+double client_wire_bits( int payload_bytes );
+int client_num_templates();
+void random_lanes_seed( struct random_lanes_t * lanes, uint64_t seed );
+void socket_init_frame_pools( struct socket_t * socket );
+static inline uint64_t random_next( uint64_t * state );
+const EVP_CIPHER * aead_cipher();
+
+int get_interface_numa_node( const char * interface_name )
+{
+    char filename[256];
+    snprintf( filename, sizeof(filename), "/sys/class/net/%s/device/numa_node", interface_name );
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+        return -1;
+
+    int numa_node = -1;
+    if ( fscanf( file, "%d", &numa_node ) != 1 )
+        numa_node = -1;
+
+    fclose( file );
+
+    return numa_node;
+}
+
+bool get_interface_ethernet_address( const char * interface_name, uint8_t * address )
+{
+    char filename[256];
+    snprintf( filename, sizeof(filename), "/sys/class/net/%s/address", interface_name );
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+        return false;
+
+    int result = fscanf( file, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &address[0], &address[1], &address[2], &address[3], &address[4], &address[5] );
+
+    fclose( file );
+
+    return result == ETH_ALEN;
+}
+
+int get_numa_node_cpus( int numa_node, int * cpus, int max_cpus )
+{
+    // parses a cpu list like "0-7,16-23"
+
+    char filename[256];
+    snprintf( filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", numa_node );
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+        return 0;
+
+    char buffer[4096];
+    if ( !fgets( buffer, sizeof(buffer), file ) )
+        buffer[0] = '\0';
+
+    fclose( file );
+
+    int num_cpus = 0;
+    char * save = NULL;
+    for ( char * token = strtok_r( buffer, ",\n", &save ); token; token = strtok_r( NULL, ",\n", &save ) )
+    {
+        int first, last;
+        int fields = sscanf( token, "%d-%d", &first, &last );
+        if ( fields < 1 )
+            continue;
+        if ( fields == 1 )
+            last = first;
+        for ( int cpu = first; cpu <= last && num_cpus < max_cpus; cpu++ )
+        {
+            cpus[num_cpus++] = cpu;
+        }
+    }
+
+    return num_cpus;
+}
+
+int get_interface_channels( const char * interface_name )
+{
+    // combined channels, or tx channels on nics that have separate ones. 0 if we can't tell
+
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( fd < 0 )
+        return 0;
+
+    struct ethtool_channels channels;
+    memset( &channels, 0, sizeof(channels) );
+    channels.cmd = ETHTOOL_GCHANNELS;
+
+    struct ifreq ifr;
+    memset( &ifr, 0, sizeof(ifr) );
+    strncpy( ifr.ifr_name, interface_name, IFNAMSIZ - 1 );
+    ifr.ifr_data = (void*) &channels;
+
+    int result = ioctl( fd, SIOCETHTOOL, &ifr );
+
+    close( fd );
+
+    if ( result )
+        return 0;
+
+    return channels.combined_count > 0 ? channels.combined_count : channels.tx_count;
+}
+
+void prefault_memory( void * memory, size_t bytes )
+{
+    // write to every page from the thread that will use it, so the page faults happen now instead of while we're sending, and the pages land on this cpu's numa node
+
+    const size_t page_size = getpagesize();
+
+    for ( size_t i = 0; i < bytes; i += page_size )
+    {
+        ( (volatile uint8_t*) memory )[i] = 0;
+    }
+}
+
+void bind_memory_to_numa_node( void * memory, size_t bytes, int numa_node )
+{
+    // prefer the numa node the nic is attached to. must be called before the memory is first touched
+
+    if ( numa_node < 0 || numa_node >= 64 )
+        return;
+
+    unsigned long nodemask = 1UL << numa_node;
+
+    if ( syscall( SYS_mbind, memory, bytes, MPOL_PREFERRED, &nodemask, 64, 0 ) != 0 )
+    {
+        printf( "warning: could not bind umem to numa node %d: %s\n", numa_node, strerror(errno) );
+    }
+}
+
+int client_init_interface( struct interface_t * interface, const char * interface_name )
+{
+    interface->name = interface_name;
+
+    // find the network interface that matches the interface name
+    {
+        bool found = false;
+
+        struct ifaddrs * addrs;
+        if ( getifaddrs( &addrs ) != 0 )
+        {
+            printf( "\nerror: getifaddrs failed\n\n" );
+            return 1;
+        }
+
+        for ( struct ifaddrs * iap = addrs; iap != NULL; iap = iap->ifa_next ) 
+        {
+            if ( iap->ifa_addr && ( iap->ifa_flags & IFF_UP ) && iap->ifa_addr->sa_family == AF_INET )
+            {
+                struct sockaddr_in * sa = (struct sockaddr_in*) iap->ifa_addr;
+                if ( strcmp( interface_name, iap->ifa_name ) == 0 )
+                {
+                    printf( "found network interface: '%s'\n", iap->ifa_name );
+                    interface->interface_index = if_nametoindex( iap->ifa_name );
+                    if ( !interface->interface_index ) 
+                    {
+                        printf( "\nerror: if_nametoindex failed\n\n" );
+                        return 1;
+                    }
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        freeifaddrs( addrs );
+
+        if ( !found )
+        {
+            printf( "\nerror: could not find any network interface matching '%s'\n\n", interface_name );
+            return 1;
+        }
+    }
+
+    // load the client_xdp program and attach it to the network interface. the other backends don't need it
+
+    if ( backend != BACKEND_XDP )
+        goto skip_xdp;
+
+    printf( "loading client_xdp...\n" );
+
+    interface->program = xdp_program__open_file( "client_xdp.o", "client_xdp", NULL );
+    if ( libxdp_get_error( interface->program ) ) 
+    {
+        interface->program = NULL;
+        printf( "\nerror: could not load client_xdp program\n\n");
+        return 1;
+    }
+
+    printf( "client_xdp loaded successfully.\n" );
+
+    printf( "attaching client_xdp to network interface '%s'\n", interface_name );
+
+    int ret = xdp_program__attach( interface->program, interface->interface_index, XDP_MODE_NATIVE, 0 );
+    if ( ret == 0 )
+    {
+        interface->attached_native = true;
+    } 
+    else
+    {
+        printf( "falling back to skb mode...\n" );
+        ret = xdp_program__attach( interface->program, interface->interface_index, XDP_MODE_SKB, 0 );
+        if ( ret == 0 )
+        {
+            interface->attached_skb = true;
+        }
+        else
+        {
+            printf( "\nerror: failed to attach client_xdp program to interface\n\n" );
+            return 1;
+        }
+    }
+
+skip_xdp:
+
+    // each port has its own ethernet address, and we want umem and socket threads on the numa node the nic is attached to
+
+    if ( !get_interface_ethernet_address( interface_name, interface->ethernet_address ) )
+    {
+        memcpy( interface->ethernet_address, CLIENT_ETHERNET_ADDRESS, ETH_ALEN );
+    }
+
+    interface->numa_node = get_interface_numa_node( interface_name );
+
+    printf( "network interface '%s' is on numa node %d\n", interface_name, interface->numa_node );
+
+    return 0;
+}
+
+int socket_init_xdp( struct socket_t * socket )
+{
+    struct interface_t * interface = socket->interface;
+
+    int ret;
+
+    // allocate buffer for umem on the same numa node as the nic
+
+    const int buffer_size = NUM_FRAMES * FRAME_SIZE;
+
+    socket->buffer_bytes = buffer_size;
+
+    socket->contiguous_bytes = FRAME_SIZE;
+
+    if ( unaligned_umem )
+    {
+        // packed slots can cross pages, but in zero copy mode only pages that are contiguous for dma. huge pages are, so try for them first,
+        // and otherwise keep each slot within a page
+
+        socket->buffer = mmap( NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ( 21 << MAP_HUGE_SHIFT ), -1, 0 );
+
+        if ( socket->buffer != MAP_FAILED )
+        {
+            socket->buffer_huge = true;
+            socket->contiguous_bytes = HUGE_PAGE_BYTES;
+        }
+        else
+        {
+            printf( "warning: no huge pages for the umem [%d], so slots stay within 4k pages: %s\n", socket->queue_id, strerror(errno) );
+            socket->buffer = NULL;
+            socket->contiguous_bytes = getpagesize();
+        }
+    }
+
+    if ( !socket->buffer && posix_memalign( &socket->buffer, getpagesize(), buffer_size ) ) 
+    {
+        printf( "\nerror: could not allocate buffer\n\n" );
+        return 1;
+    }
+
+    bind_memory_to_numa_node( socket->buffer, buffer_size, interface->numa_node );
+
+    prefault_memory( socket->buffer, buffer_size );
+
+    // allocate umem. unaligned, the chunk size only sets the largest frame, and descriptors can start anywhere
+
+    struct xsk_umem_config umem_config;
+    memset( &umem_config, 0, sizeof(umem_config) );
+    umem_config.fill_size = XSK_RING_PROD__DEFAULT_NUM_DESCS;
+    umem_config.comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+    umem_config.frame_size = FRAME_SIZE;
+    umem_config.frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM;
+    umem_config.flags = unaligned_umem ? XDP_UMEM_UNALIGNED_CHUNK_FLAG : 0;
+
+    ret = xsk_umem__create( &socket->umem, socket->buffer, buffer_size, &socket->fill_queue, &socket->complete_queue, &umem_config );
+    if ( ret ) 
+    {
+        printf( "\nerror: could not create umem\n\n" );
+        return 1;
+    }
+
+    // create xsk socket and assign to network interface queue
+
+    struct xsk_socket_config xsk_config;
+
+    memset( &xsk_config, 0, sizeof(xsk_config) );
+
+    xsk_config.rx_size = 0;
+    xsk_config.tx_size = XSK_RING_PROD__DEFAULT_NUM_DESCS;
+    xsk_config.xdp_flags = XDP_ZEROCOPY;                                            // force zero copy mode
+    xsk_config.bind_flags = ( drive_mode != DRIVE_MODE_ALWAYS_KICK || compare_seconds > 0 ) ? XDP_USE_NEED_WAKEUP : 0;  // manually wake up the driver when it needs to do work to send packets
+    xsk_config.libbpf_flags = XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD;
+
+    ret = xsk_socket__create( &socket->xsk, interface->name, socket->queue_id, socket->umem, NULL, &socket->send_queue, &xsk_config );
+    if ( ret )
+    {
+        printf( "\nerror: could not create xsk socket [%s:%d]\n\n", interface->name, socket->queue_id );
+        return 1;
+    }
+
+    socket->fd = xsk_socket__fd( socket->xsk );
+
+    // in busy poll mode the driver napi loop runs in our sendto calls instead of softirq
+
+    if ( drive_mode == DRIVE_MODE_BUSY_POLL )
+    {
+        int fd = socket->fd;
+
+        int value = 1;
+        if ( setsockopt( fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &value, sizeof(value) ) )
+        {
+            printf( "\nerror: could not set SO_PREFER_BUSY_POLL on xsk socket [%d]: %s\n\n", socket->queue_id, strerror(errno) );
+            return 1;
+        }
+
+        value = busy_poll_usecs;
+        if ( setsockopt( fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value) ) )
+        {
+            printf( "\nerror: could not set SO_BUSY_POLL on xsk socket [%d]: %s\n\n", socket->queue_id, strerror(errno) );
+            return 1;
+        }
+
+        value = busy_poll_budget;
+        if ( setsockopt( fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &value, sizeof(value) ) )
+        {
+            printf( "\nerror: could not set SO_BUSY_POLL_BUDGET on xsk socket [%d]: %s\n\n", socket->queue_id, strerror(errno) );
+            return 1;
+        }
+    }
+
+    socket->working_set_frames = ( working_set_frames > 0 ) ? working_set_frames : 0;
+
+    socket->measuring_working_set = working_set_frames == WORKING_SET_AUTO;
+
+    socket_init_frame_pools( socket );
+
+    return 0;
+}
+
+void socket_shutdown_xdp( struct socket_t * socket )
+{
+    if ( socket->xsk )
+    {
+        xsk_socket__delete( socket->xsk );
+    }
+
+    if ( socket->umem )
+    {
+        xsk_umem__delete( socket->umem );
+    }
+}
+
+int client_add_socket( struct client_t * client, int interface_index, int queue_id )
+{
+    struct socket_t * socket = calloc( 1, sizeof(struct socket_t) );
+    if ( !socket )
+    {
+        printf( "\nerror: could not allocate socket\n\n" );
+        return 1;
+    }
+
+    socket->interface = &client->interface[interface_index];
+    socket->queue_id = queue_id;
+    socket->random_state = flow_seed ^ ( ( interface_index * MAX_QUEUES + queue_id + 1 ) * 0x9E3779B97F4A7C15ULL );
+
+    socket->size_table_index = random_next( &socket->random_state );
+
+    random_lanes_seed( &socket->random_lanes, socket->random_state );
+
+    socket->template = calloc( client_num_templates(), sizeof(struct packet_template_t) );
+    if ( !socket->template )
+    {
+        printf( "\nerror: could not allocate packet templates\n\n" );
+        free( socket );
+        return 1;
+    }
+
+    if ( aead != AEAD_NONE )
+    {
+        // a random start, so sockets, and runs with the same key, don't reuse nonces
+
+        socket->aead_nonce = random_next( &socket->random_state ) ^ get_nanoseconds();
+
+        socket->aead_context = EVP_CIPHER_CTX_new();
+        if ( !socket->aead_context || !EVP_EncryptInit_ex( socket->aead_context, aead_cipher(), NULL, aead_key, NULL ) )
+        {
+            printf( "\nerror: could not set up %s\n\n", aead_names[aead] );
+            EVP_CIPHER_CTX_free( socket->aead_context );
+            free( socket->template );
+            free( socket );
+            return 1;
+        }
+    }
+
+    pthread_mutex_lock( &client->mutex );
+    client->socket[interface_index * MAX_QUEUES + queue_id] = socket;
+    client->num_sockets++;
+    pthread_mutex_unlock( &client->mutex );
+
+    return 0;
+}
+
+void client_remove_socket( struct client_t * client, int interface_index, int queue_id )
+{
+    struct socket_t * socket = client->socket[interface_index * MAX_QUEUES + queue_id];
+    if ( !socket )
+        return;
+
+    // keep its counters, so the stats don't go backwards
+
+    pthread_mutex_lock( &client->mutex );
+    client->socket[interface_index * MAX_QUEUES + queue_id] = NULL;
+    client->num_sockets--;
+    socket->interface->retired_sent_packets += socket->sent_packets;
+    client->retired_kicks += socket->kicks;
+    client->retired_kick_syscalls += socket->kick_syscalls;
+    for ( int i = 0; i < num_destinations; i++ )
+    {
+        client->retired_destination_sent_packets[i] += socket->destination_sent_packets[i];
+    }
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        client->retired_size_sent_packets[i] += socket->size_sent_packets[i];
+    }
+    client->retired_aead_packets += socket->aead_packets;
+    client->retired_aead_cycles += socket->aead_cycles;
+    client->retired_checksum_packets += socket->checksum_packets;
+    client->retired_checksum_cycles += socket->checksum_cycles;
+    pthread_mutex_unlock( &client->mutex );
+
+    backends[backend].shutdown( socket );
+
+    EVP_CIPHER_CTX_free( socket->aead_context );
+    free( socket->template );
+    if ( socket->buffer_huge )
+        munmap( socket->buffer, socket->buffer_bytes );
+    else
+        free( socket->buffer );
+    free( socket );
+}
+
+int client_start_socket_threads( struct client_t * client )
+{
+    // assign sockets to socket threads. socket n is queue n % num_queues on interface n / num_queues
+
+    for ( int i = 0; i < MAX_THREADS; i++ )
+    {
+        client->thread[i].num_sockets = 0;
+    }
+
+    for ( int i = 0; i < num_interfaces * num_queues; i++ )
+    {
+        struct socket_t * socket = client->socket[( i / num_queues ) * MAX_QUEUES + ( i % num_queues )];
+        int thread_index = ( socket_thread_index[i] >= 0 && socket_thread_index[i] < num_threads ) ? socket_thread_index[i] : ( i % num_threads );
+        struct thread_t * thread = &client->thread[thread_index];
+        thread->socket[thread->num_sockets++] = socket;
+    }
+
+    // pin each socket thread to a cpu on the numa node of the first nic it sends on, unless told otherwise
+
+    int numa_node_threads[64];
+    memset( numa_node_threads, 0, sizeof(numa_node_threads) );
+
+    int num_active_threads = 0;
+
+    for ( int i = 0; i < num_threads; i++ )
+    {
+        struct thread_t * thread = &client->thread[i];
+
+        thread->client = client;
+        thread->thread_index = i;
+        thread->cpu = i;
+
+        if ( thread->num_sockets > 0 )
+        {
+            thread->flow_partition = num_active_threads++;
+        }
+
+        if ( thread_cpu[i] >= 0 )
+        {
+            thread->cpu = thread_cpu[i];
+        }
+        else if ( thread->num_sockets > 0 )
+        {
+            int numa_node = thread->socket[0]->interface->numa_node;
+            if ( numa_node >= 0 && numa_node < 64 )
+            {
+                int cpus[MAX_CPUS];
+                int num_numa_cpus = get_numa_node_cpus( numa_node, cpus, MAX_CPUS );
+                if ( num_numa_cpus > 0 )
+                {
+                    thread->cpu = cpus[numa_node_threads[numa_node]++ % num_numa_cpus];
+                }
+            }
+        }
+    }
+
+    for ( int i = 0; i < num_threads; i++ )
+    {
+        client->thread[i].num_flow_partitions = num_active_threads;
+    }
+
+    // create socket threads. each one sets up its new sockets in parallel on the cpu that will drive them, then waits for everybody else
+
+    client->stop_socket_threads = false;
+
+    pthread_barrier_init( &client->ready_barrier, NULL, num_active_threads + 1 );
+    pthread_barrier_init( &client->go_barrier, NULL, num_active_threads + 1 );
+
+    for ( int i = 0; i < num_threads; i++ )
+    {
+        if ( client->thread[i].num_sockets == 0 )
+            continue;
+
+        if ( pthread_create( &client->socket_thread[i], NULL, socket_thread, &client->thread[i] ) ) 
+        {
+            // the threads we already created are stuck waiting on the barrier for this one, so there's no clean way back
+
+            printf( "\nerror: could not create socket thread #%d\n\n", i );
+            exit( 1 );
+        }
+
+        client->socket_thread_created[i] = true;
+    }
+
+    pthread_barrier_wait( &client->ready_barrier );
+
+    client->setup_nanoseconds = get_nanoseconds();
+
+    bool init_failed = false;
+
+    for ( int i = 0; i < num_threads; i++ )
+    {
+        if ( client->thread[i].num_sockets > 0 && client->thread[i].init_result != 0 )
+            init_failed = true;
+    }
+
+    if ( init_failed )
+    {
+        quit = true;
+    }
+
+    // every socket thread starts sending at the same tsc instant, 1ms from now
+
+    client->start_tsc = get_tsc() + (uint64_t) client->tsc_per_millisecond;
+
+    pthread_barrier_wait( &client->go_barrier );
+
+    if ( init_failed )
+        return 1;
+
+    while ( get_tsc() < client->start_tsc )
+    {
+        usleep( 100 );
+    }
+
+    return 0;
+}
+
+void client_stop_socket_threads( struct client_t * client )
+{
+    client->stop_socket_threads = true;
+
+    bool stopped = false;
+
+    for ( int i = 0; i < MAX_THREADS; i++ )
+    {
+        if ( client->socket_thread_created[i] )
+        {
+            pthread_join( client->socket_thread[i], NULL );
+            client->socket_thread_created[i] = false;
+            stopped = true;
+        }
+    }
+
+    if ( stopped )
+    {
+        pthread_barrier_destroy( &client->ready_barrier );
+        pthread_barrier_destroy( &client->go_barrier );
+    }
+
+    // each thread's io_uring went away with it
+
+    for ( int i = 0; i < MAX_SOCKETS; i++ )
+    {
+        if ( client->socket[i] )
+        {
+            client->socket[i]->uring = NULL;
+            client->socket[i]->uring_pending = false;
+            client->socket[i]->flow_table = NULL;
+        }
+    }
+}
+
+int client_reconfigure( struct client_t * client, int new_num_queues, int new_num_threads )
+{
+    if ( new_num_queues == num_queues && new_num_threads == num_threads )
+        return 0;
+
+    const uint64_t start_nanoseconds = get_nanoseconds();
+
+    printf( "reconfiguring from %d queues on %d threads to %d queues on %d threads\n", num_queues, num_threads, new_num_queues, new_num_threads );
+
+    // xdp stays attached, and sockets for queues we keep aren't touched. only the socket threads restart
+
+    client_stop_socket_threads( client );
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        for ( int j = new_num_queues; j < num_queues; j++ )
+        {
+            client_remove_socket( client, i, j );
+        }
+
+        for ( int j = num_queues; j < new_num_queues; j++ )
+        {
+            if ( client_add_socket( client, i, j ) != 0 )
+                return 1;
+        }
+    }
+
+    num_queues = new_num_queues;
+    num_threads = new_num_threads;
+
+    if ( client_start_socket_threads( client ) != 0 )
+        return 1;
+
+    printf( "reconfigure took %.1fms\n", ( get_nanoseconds() - start_nanoseconds ) / 1000000.0 );
+
+    return 0;
+}
+
+int client_set_flows( struct client_t * client, int new_num_flows )
+{
+    // flow tables are built by the socket threads when they start, so restart them. sockets and umem are left alone.
+    // returns 1 if the new flows can't be set up, eg. the ranges can't meet the rss quotas, and the previous flows are back.
+    // returns -1 if we couldn't get going again at all
+
+    client_stop_socket_threads( client );
+
+    const int previous_num_flows = num_flows;
+
+    num_flows = new_num_flows;
+
+    int result = 0;
+
+    if ( flow_init() != 0 )
+    {
+        num_flows = previous_num_flows;
+        result = 1;
+
+        if ( flow_init() != 0 )
+            return -1;
+    }
+
+    if ( client_start_socket_threads( client ) != 0 )
+        return -1;
+
+    return result;
+}
+
+int client_init( struct client_t * client )
+{
+    const uint64_t start_nanoseconds = get_nanoseconds();
+
+    // we can only run xdp programs as root
+
+    if ( geteuid() != 0 ) 
+    {
+        printf( "\nerror: this program must be run as root\n\n" );
+        return 1;
+    }
+
+    // find each network interface, and load and attach the client_xdp program to it
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        if ( client_init_interface( &client->interface[i], interface_names[i] ) != 0 )
+            return 1;
+    }
+
+    // allow unlimited locking of memory, so all memory needed for packet buffers can be locked
+
+    struct rlimit rlim = { RLIM_INFINITY, RLIM_INFINITY };
+
+    if ( setrlimit( RLIMIT_MEMLOCK, &rlim ) ) 
+    {
+        printf( "\nerror: could not setrlimit\n\n");
+        return 1;
+    }
+
+    pthread_mutex_init( &client->mutex, NULL );
+
+    // count llc misses for this thread and every thread started after it, which is all the socket threads
+
+    client->llc_miss_fd = -1;
+
+    if ( report_working_set )
+    {
+        struct perf_event_attr attr;
+        memset( &attr, 0, sizeof(attr) );
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+
+        client->llc_miss_fd = syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+        if ( client->llc_miss_fd < 0 )
+        {
+            printf( "warning: could not count llc misses: %s\n", strerror(errno) );
+        }
+    }
+
+    // per-queue socket setup. each socket thread sets up the sockets it drives
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        for ( int j = 0; j < num_queues; j++ )
+        {
+            if ( client_add_socket( client, i, j ) != 0 )
+                return 1;
+        }
+    }
+
+    if ( flow_init() != 0 )
+        return 1;
+
+    // work out how many tsc ticks there are in a millisecond, so we can pick a start instant a little in the future
+
+    const uint64_t calibrate_tsc = get_tsc();
+    const uint64_t calibrate_nanoseconds = get_nanoseconds();
+    usleep( 10000 );
+    client->tsc_per_millisecond = ( get_tsc() - calibrate_tsc ) * 1000000.0 / ( get_nanoseconds() - calibrate_nanoseconds );
+
+    if ( client_start_socket_threads( client ) != 0 )
+        return 1;
+
+    printf( "startup took %.1fms, %.1fms of that setting up %d sockets on %d threads\n", ( get_nanoseconds() - start_nanoseconds ) / 1000000.0, ( client->setup_nanoseconds - start_nanoseconds ) / 1000000.0, client->num_sockets, num_threads );
+
+    // find ksoftirqd threads so the stats thread can report how much cpu the kernel spends sending for us
+
+    find_ksoftirqd_threads( client );
+
+    client->previous_ksoftirqd_ticks = get_ksoftirqd_ticks( client );
+
+    client->previous_cpu_microseconds = get_cpu_microseconds();
+
+    // create stats thread
+
+    int ret = pthread_create( &client->stats_thread, NULL, stats_thread, client );
+    if ( ret ) 
+    {
+        printf( "\nerror: could not create stats thread\n\n" );
+        return 1;
+    }
+
+    client->stats_thread_created = true;
+
+    return 0;
+}
+
+void client_shutdown( struct client_t * client )
+{
+    assert( client );
+
+    client_stop_socket_threads( client );
+
+    if ( client->stats_thread_created )
+    {
+        pthread_join( client->stats_thread, NULL );
+    }
+
+    for ( int i = 0; i < MAX_SOCKETS; i++ )
+    {
+        if ( client->socket[i] )
+        {
+            client_remove_socket( client, i / MAX_QUEUES, i % MAX_QUEUES );
+        }
+    }
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        struct interface_t * interface = &client->interface[i];
+
+        if ( interface->program != NULL )
+        {
+            if ( interface->attached_native )
+            {
+                xdp_program__detach( interface->program, interface->interface_index, XDP_MODE_NATIVE, 0 );
+            }
+
+            if ( interface->attached_skb )
+            {
+                xdp_program__detach( interface->program, interface->interface_index, XDP_MODE_SKB, 0 );
+            }
+
+            xdp_program__close( interface->program );
+        }
+    }
+}
+
+static void * stats_thread( void * arg )
+{
+    struct client_t * client = (struct client_t*) arg;
+
+    int seconds_in_mode = 0;
+    uint64_t compare_seconds_total[DRIVE_MODE_NUM_MODES];
+    uint64_t compare_sent_packets[DRIVE_MODE_NUM_MODES];
+    uint64_t compare_syscalls[DRIVE_MODE_NUM_MODES];
+    memset( compare_seconds_total, 0, sizeof(compare_seconds_total) );
+    memset( compare_sent_packets, 0, sizeof(compare_sent_packets) );
+    memset( compare_syscalls, 0, sizeof(compare_syscalls) );
+
+    while ( !quit )
+    {
+        usleep( 1000000 );
+
+        uint64_t sent_packets = 0;
+        uint64_t kicks = 0;
+        uint64_t kick_syscalls = 0;
+        uint64_t idle_nanoseconds = 0;
+        uint64_t interface_sent_packets[MAX_INTERFACES];
+        memset( interface_sent_packets, 0, sizeof(interface_sent_packets) );
+        uint64_t destination_sent_packets[MAX_DESTINATIONS];
+        uint64_t size_sent_packets[MAX_SIZES];
+        pthread_mutex_lock( &client->mutex );
+        kicks = client->retired_kicks;
+        kick_syscalls = client->retired_kick_syscalls;
+        uint64_t aead_packets = client->retired_aead_packets;
+        uint64_t aead_cycles = client->retired_aead_cycles;
+        uint64_t checksum_packets = client->retired_checksum_packets;
+        uint64_t checksum_cycles = client->retired_checksum_cycles;
+        uint64_t working_set_frames_total = 0;
+        uint64_t touched_bytes = 0;
+        uint64_t umem_bytes = 0;
+        bool measuring = false;
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            interface_sent_packets[i] = client->interface[i].retired_sent_packets;
+        }
+        for ( int i = 0; i < num_destinations; i++ )
+        {
+            destination_sent_packets[i] = client->retired_destination_sent_packets[i];
+        }
+        for ( int i = 0; i < num_sizes; i++ )
+        {
+            size_sent_packets[i] = client->retired_size_sent_packets[i];
+        }
+        for ( int i = 0; i < MAX_SOCKETS; i++ )
+        {
+            struct socket_t * socket = client->socket[i];
+            if ( !socket )
+                continue;
+            kicks += socket->kicks;
+            kick_syscalls += socket->kick_syscalls;
+            aead_packets += socket->aead_packets;
+            aead_cycles += socket->aead_cycles;
+            checksum_packets += socket->checksum_packets;
+            checksum_cycles += socket->checksum_cycles;
+            interface_sent_packets[i / MAX_QUEUES] += socket->sent_packets;
+            working_set_frames_total += socket->working_set_frames;
+            measuring |= socket->measuring_working_set;
+            umem_bytes += socket->buffer_bytes;
+            for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+            {
+                touched_bytes += (uint64_t) ( socket->pool[c].max_frames - socket->pool[c].low_frames ) * socket->pool[c].slot_bytes;
+            }
+            for ( int j = 0; j < num_destinations; j++ )
+            {
+                destination_sent_packets[j] += socket->destination_sent_packets[j];
+            }
+            for ( int j = 0; j < num_sizes; j++ )
+            {
+                size_sent_packets[j] += socket->size_sent_packets[j];
+            }
+        }
+        pthread_mutex_unlock( &client->mutex );
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            sent_packets += interface_sent_packets[i];
+        }
+        for ( int i = 0; i < MAX_THREADS; i++ )
+        {
+            idle_nanoseconds += client->thread[i].idle_nanoseconds;
+        }
+
+        uint64_t ksoftirqd_ticks = get_ksoftirqd_ticks( client );
+
+        uint64_t sent_delta = sent_packets - client->previous_sent_packets;
+
+        uint64_t kick_delta = kicks - client->previous_kicks;
+
+        uint64_t syscall_delta = kick_syscalls - client->previous_kick_syscalls;
+
+        double ksoftirqd_cpu = 100.0 * ( ksoftirqd_ticks - client->previous_ksoftirqd_ticks ) / sysconf( _SC_CLK_TCK );
+
+        double cpu_saved = ( idle_nanoseconds - client->previous_idle_nanoseconds ) / 10000000.0;
+
+        uint64_t cpu_microseconds = get_cpu_microseconds();
+
+        double cpu = ( cpu_microseconds - client->previous_cpu_microseconds ) / 10000.0;
+
+        // the first second includes startup, so leave it out of the totals
+
+        if ( client->previous_sent_packets > 0 )
+        {
+            client->total_seconds++;
+            client->total_sent_packets += sent_delta;
+            client->total_cpu += cpu;
+            client->total_ksoftirqd_cpu += ksoftirqd_cpu;
+        }
+
+        if ( num_interfaces > 1 )
+        {
+            for ( int i = 0; i < num_interfaces; i++ )
+            {
+                struct interface_t * interface = &client->interface[i];
+                printf( "    %s sent delta %" PRId64 "\n", interface->name, interface_sent_packets[i] - interface->previous_sent_packets );
+                interface->previous_sent_packets = interface_sent_packets[i];
+            }
+        }
+
+        // per destination counts are of packets queued, so they lead the sent delta by up to a ring of packets
+
+        for ( int i = 0; i < num_destinations; i++ )
+        {
+            printf( "    %s sent delta %" PRId64 "\n", destination[i].name, destination_sent_packets[i] - client->previous_destination_sent_packets[i] );
+            client->previous_destination_sent_packets[i] = destination_sent_packets[i];
+        }
+
+        // with sizes, the wire rate adds up each size, from packets queued. print it per size class too
+
+        double wire_gbps = sent_delta * client_wire_bits( payload_bytes ) / 1000000000.0;
+
+        if ( num_sizes > 0 )
+        {
+            uint64_t class_sent_delta[NUM_SIZE_CLASSES];
+            double class_wire_bits[NUM_SIZE_CLASSES];
+            memset( class_sent_delta, 0, sizeof(class_sent_delta) );
+            memset( class_wire_bits, 0, sizeof(class_wire_bits) );
+
+            for ( int i = 0; i < num_sizes; i++ )
+            {
+                const uint64_t size_delta = size_sent_packets[i] - client->previous_size_sent_packets[i];
+                class_sent_delta[packet_size[i].size_class] += size_delta;
+                class_wire_bits[packet_size[i].size_class] += size_delta * client_wire_bits( packet_size[i].payload_bytes );
+                client->previous_size_sent_packets[i] = size_sent_packets[i];
+            }
+
+            wire_gbps = 0.0;
+            for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+            {
+                wire_gbps += class_wire_bits[c] / 1000000000.0;
+                if ( class_sent_delta[c] > 0 )
+                    printf( "    up to %s byte frames sent delta %" PRId64 ", wire %.2f gbps\n", size_class_names[c], class_sent_delta[c], class_wire_bits[c] / 1000000000.0 );
+            }
+        }
+
+        // encryption cost on its own, so we can work out how many cores a given packet rate of encrypted traffic needs
+
+        if ( aead_packets > client->previous_aead_packets )
+        {
+            const double cycles_per_packet = (double) ( aead_cycles - client->previous_aead_cycles ) / ( aead_packets - client->previous_aead_packets );
+            printf( "    %s encrypt %.0f cycles per packet, %.2f cores per mpps\n", aead_names[aead], cycles_per_packet, cycles_per_packet * 1000.0 / client->tsc_per_millisecond );
+        }
+
+        client->previous_aead_packets = aead_packets;
+        client->previous_aead_cycles = aead_cycles;
+
+        // same for the l4 checksum, from the sample of packets that had theirs timed
+
+        if ( checksum_packets > client->previous_checksum_packets )
+        {
+            const double cycles_per_packet = (double) ( checksum_cycles - client->previous_checksum_cycles ) / ( checksum_packets - client->previous_checksum_packets );
+            printf( "    l4 checksum %.0f cycles per packet, %.2f cores per mpps\n", cycles_per_packet, cycles_per_packet * 1000.0 / client->tsc_per_millisecond );
+        }
+
+        client->previous_checksum_packets = checksum_packets;
+        client->previous_checksum_cycles = checksum_cycles;
+
+        // with --working-set, how much umem the frames in flight have touched since the working set was applied, and the llc misses
+        // per packet sent for the whole process, to compare against --working-set unbounded
+
+        if ( report_working_set )
+        {
+            printf( "    working set " );
+
+            if ( measuring )
+                printf( "measuring" );
+            else if ( working_set_frames_total > 0 )
+                printf( "%" PRId64 " frames", working_set_frames_total );
+            else
+                printf( "unbounded" );
+
+            printf( ", %.2f MB touched of %.0f MB umem", touched_bytes / ( 1024.0 * 1024.0 ), umem_bytes / ( 1024.0 * 1024.0 ) );
+
+            uint64_t llc_misses = 0;
+
+            if ( client->llc_miss_fd >= 0 && read( client->llc_miss_fd, &llc_misses, sizeof(llc_misses) ) == sizeof(llc_misses) )
+            {
+                if ( sent_delta > 0 )
+                    printf( ", llc misses per packet %.2f", (double) ( llc_misses - client->previous_llc_misses ) / sent_delta );
+
+                client->previous_llc_misses = llc_misses;
+            }
+
+            printf( "\n" );
+        }
+
+        const int mode = drive_mode;
+
+        printf( "sent delta %" PRId64 ", kicks %" PRId64 ", syscalls %" PRId64 ", cpu %.1f%%, ksoftirqd cpu %.1f%%, cpu saved %.1f%%, wire %.2f gbps", sent_delta, kick_delta, syscall_delta, cpu, ksoftirqd_cpu, cpu_saved, wire_gbps );
+
+        if ( compare_seconds > 0 )
+        {
+            printf( " [%s]", drive_mode_names[mode] );
+
+            // the first interval after a switch is a mix of both modes, so leave it out of the summary
+
+            if ( seconds_in_mode > 0 )
+            {
+                compare_seconds_total[mode]++;
+                compare_sent_packets[mode] += sent_delta;
+                compare_syscalls[mode] += syscall_delta;
+            }
+
+            if ( ++seconds_in_mode > compare_seconds )
+            {
+                drive_mode = ( mode == DRIVE_MODE_IO_URING ) ? DRIVE_MODE_NEED_WAKEUP : DRIVE_MODE_IO_URING;
+                seconds_in_mode = 0;
+            }
+        }
+
+        printf( "\n" );
+
+        client->last_sent_delta = sent_delta;
+        client->last_cpu = cpu;
+        client->last_ksoftirqd_cpu = ksoftirqd_cpu;
+
+        client->previous_sent_packets = sent_packets;
+        client->previous_kicks = kicks;
+        client->previous_kick_syscalls = kick_syscalls;
+        client->previous_idle_nanoseconds = idle_nanoseconds;
+        client->previous_ksoftirqd_ticks = ksoftirqd_ticks;
+        client->previous_cpu_microseconds = cpu_microseconds;
+    }
+
+    if ( compare_seconds > 0 )
+    {
+        printf( "\n%-16s%16s%16s\n", "mode", "packets/sec", "syscalls/sec" );
+        for ( int i = 0; i < DRIVE_MODE_NUM_MODES; i++ )
+        {
+            if ( compare_seconds_total[i] == 0 )
+                continue;
+            printf( "%-16s%16" PRId64 "%16" PRId64 "\n", drive_mode_names[i], compare_sent_packets[i] / compare_seconds_total[i], compare_syscalls[i] / compare_seconds_total[i] );
+        }
+    }
+
+    return NULL;
+}
+
+static void find_ksoftirqd_threads( struct client_t * client )
+{
+    client->num_ksoftirqd = 0;
+
+    DIR * dir = opendir( "/proc" );
+    if ( !dir )
+        return;
+
+    struct dirent * entry;
+    while ( ( entry = readdir( dir ) ) != NULL && client->num_ksoftirqd < MAX_KSOFTIRQD )
+    {
+        int pid = atoi( entry->d_name );
+        if ( pid <= 0 )
+            continue;
+
+        char filename[256];
+        snprintf( filename, sizeof(filename), "/proc/%d/comm", pid );
+
+        FILE * file = fopen( filename, "r" );
+        if ( !file )
+            continue;
+
+        char comm[64];
+        if ( fgets( comm, sizeof(comm), file ) && strncmp( comm, "ksoftirqd/", 10 ) == 0 )
+        {
+            client->ksoftirqd_pid[client->num_ksoftirqd++] = pid;
+        }
+
+        fclose( file );
+    }
+
+    closedir( dir );
+}
+
+static uint64_t get_cpu_microseconds()
+{
+    // user + system time for all threads in this process
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint64_t get_ksoftirqd_ticks( struct client_t * client )
+{
+    // sum of utime + stime across all ksoftirqd threads, in clock ticks
+
+    uint64_t ticks = 0;
+
+    for ( int i = 0; i < client->num_ksoftirqd; i++ )
+    {
+        char filename[256];
+        snprintf( filename, sizeof(filename), "/proc/%d/stat", client->ksoftirqd_pid[i] );
+
+        FILE * file = fopen( filename, "r" );
+        if ( !file )
+            continue;
+
+        char buffer[1024];
+        size_t bytes = fread( buffer, 1, sizeof(buffer) - 1, file );
+        buffer[bytes] = '\0';
+        fclose( file );
+
+        // skip past the comm field, which is in parentheses, then utime and stime are fields 14 and 15
+
+        char * p = strrchr( buffer, ')' );
+        if ( !p )
+            continue;
+
+        unsigned long long utime = 0, stime = 0;
+        if ( sscanf( p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime ) == 2 )
+        {
+            ticks += utime + stime;
+        }
+    }
+
+    return ticks;
+}
+
+bool pin_thread_to_cpu( int cpu ) 
+{
+    int num_cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    if ( cpu < 0 || cpu >= num_cpus  )
+        return false;
+
+    cpu_set_t cpuset;
+    CPU_ZERO( &cpuset );
+    CPU_SET( cpu, &cpuset );
+
+    pthread_t current_thread = pthread_self();    
+
+    pthread_setaffinity_np( current_thread, sizeof(cpu_set_t), &cpuset );
+}
+
+static struct client_t client;
+
+volatile bool interrupted;
+
+volatile bool reload_config;
+
+void reload_config_handler( int signal )
+{
+    (void) signal;
+    reload_config = true;
+}
+
+void interrupt_handler( int signal )
+{
+    (void) signal; quit = true; interrupted = true;
+}
+
+void clean_shutdown_handler( int signal )
+{
+    (void) signal;
+    quit = true;
+    interrupted = true;
+}
+
+static void cleanup()
+{
+    client_shutdown( &client );
+    fflush( stdout );
+}
+
+static void socket_add_frame_pool( struct socket_t * socket, int pool_index, uint64_t first_address, uint32_t num_frames, int slot_bytes, uint64_t * frames )
+{
+    // slots go back to back, except that one never crosses a multiple of contiguous_bytes
+
+    struct frame_pool_t * pool = &socket->pool[pool_index];
+
+    pool->frames = frames;
+    pool->max_frames = num_frames;
+    pool->num_frames = num_frames;
+    pool->first_address = first_address;
+    pool->slot_bytes = slot_bytes;
+
+    uint64_t address = first_address;
+
+    for ( uint32_t j = 0; j < num_frames; j++ )
+    {
+        if ( address / socket->contiguous_bytes != ( address + slot_bytes - 1 ) / socket->contiguous_bytes )
+            address = ( address / socket->contiguous_bytes + 1 ) * socket->contiguous_bytes;
+
+        pool->frames[j] = address;
+
+        address += slot_bytes;
+    }
+
+    pool->end_address = address;
+}
+
+static int unaligned_slot_bytes( int frame_bytes )
+{
+    return ( frame_bytes + SLOT_ALIGN_BYTES - 1 ) / SLOT_ALIGN_BYTES * SLOT_ALIGN_BYTES;
+}
+
+static void socket_apply_working_set( struct socket_t * socket )
+{
+    // keep back all but the working set in each pool. with sizes, each pool gets the share of the working set its class is sent with,
+    // and never less than a batch, since a batch can take all its frames from one pool
+
+    uint32_t class_samples[NUM_SIZE_CLASSES];
+    memset( class_samples, 0, sizeof(class_samples) );
+
+    if ( num_sizes > 0 && socket->working_set_frames > 0 )
+    {
+        for ( int i = 0; i < SIZE_TABLE_SAMPLES; i++ )
+        {
+            class_samples[packet_size[size_table[i]].size_class]++;
+        }
+    }
+
+    for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+    {
+        struct frame_pool_t * pool = &socket->pool[c];
+
+        if ( pool->max_frames == 0 )
+            continue;
+
+        uint32_t frames = pool->max_frames;
+
+        if ( socket->working_set_frames > 0 )
+        {
+            frames = ( num_sizes > 0 ) ? (uint64_t) socket->working_set_frames * class_samples[c] / SIZE_TABLE_SAMPLES + 1 : socket->working_set_frames;
+            if ( frames < MAX_SEND_BATCH_SIZE )
+                frames = MAX_SEND_BATCH_SIZE;
+            if ( frames > pool->max_frames )
+                frames = pool->max_frames;
+        }
+
+        pool->min_free_frames = pool->max_frames - frames;
+        pool->low_frames = pool->num_frames;
+    }
+}
+
+void socket_init_frame_pools( struct socket_t * socket )
+{
+    // without sizes, every frame is a whole umem chunk. with sizes, each size class in use gets an equal share of the free stack, and its own stretch of umem
+    // cut into slots just big enough for the class. small frames are then packed many to a chunk, so the ones in flight stay dense in cache and tlb.
+    // with an unaligned umem, slots don't have to divide the chunk, so they are cut to the largest frame they hold, rounded up to a cache line
+
+    memset( socket->pool, 0, sizeof(socket->pool) );
+
+    if ( num_sizes == 0 )
+    {
+        socket_add_frame_pool( socket, 0, 0, NUM_FRAMES, unaligned_umem ? unaligned_slot_bytes( client_frame_bytes( payload_bytes ) ) : FRAME_SIZE, socket->frames );
+        socket_apply_working_set( socket );
+        return;
+    }
+
+    bool in_use[NUM_SIZE_CLASSES];
+    memset( in_use, 0, sizeof(in_use) );
+
+    int slot_bytes[NUM_SIZE_CLASSES];
+    memcpy( slot_bytes, size_class_slot_bytes, sizeof(slot_bytes) );
+
+    if ( unaligned_umem )
+        memset( slot_bytes, 0, sizeof(slot_bytes) );
+
+    int classes_in_use = 0;
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        const int c = packet_size[i].size_class;
+        if ( !in_use[c] )
+            classes_in_use++;
+        in_use[c] = true;
+        if ( unaligned_umem && unaligned_slot_bytes( client_frame_bytes( packet_size[i].payload_bytes ) ) > slot_bytes[c] )
+            slot_bytes[c] = unaligned_slot_bytes( client_frame_bytes( packet_size[i].payload_bytes ) );
+    }
+
+    const uint32_t frames_per_pool = NUM_FRAMES / classes_in_use;
+
+    uint64_t address = 0;
+    uint64_t * frames = socket->frames;
+
+    for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+    {
+        if ( !in_use[c] )
+            continue;
+
+        socket_add_frame_pool( socket, c, address, frames_per_pool, slot_bytes[c], frames );
+
+        address = socket->pool[c].end_address;
+        frames += frames_per_pool;
+    }
+
+    assert( address <= (uint64_t) NUM_FRAMES * FRAME_SIZE );
+
+    socket_apply_working_set( socket );
+}
+
+uint64_t socket_alloc_frame( struct socket_t * socket, int pool_index )
+{
+    struct frame_pool_t * pool = &socket->pool[pool_index];
+    if ( pool->num_frames == 0 )
+        return INVALID_FRAME;
+    pool->num_frames--;
+    if ( pool->num_frames < pool->low_frames )
+        pool->low_frames = pool->num_frames;
+    uint64_t frame = pool->frames[pool->num_frames];
+    pool->frames[pool->num_frames] = INVALID_FRAME;
+    return frame;
+}
+
+void socket_free_frame( struct socket_t * socket, uint64_t frame )
+{
+    // completions don't say which pool a frame came from, but its address does
+
+    struct frame_pool_t * pool = &socket->pool[0];
+    for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+    {
+        if ( frame >= socket->pool[c].first_address && frame < socket->pool[c].end_address )
+        {
+            pool = &socket->pool[c];
+            break;
+        }
+    }
+
+    assert( pool->num_frames < pool->max_frames );
+    pool->frames[pool->num_frames] = frame;
+    pool->num_frames++;
+}
+
+uint16_t ipv4_checksum( const void * data, size_t header_length )
+{
+    unsigned long sum = 0;
+
+    const uint16_t * p = (const uint16_t*) data;
+
+    while ( header_length > 1 )
+    {
+        sum += *p++;
+        if ( sum & 0x80000000 )
+        {
+            sum = ( sum & 0xFFFF ) + ( sum >> 16 );
+        }
+        header_length -= 2;
+    }
+
+    while ( sum >> 16 )
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return ~sum;
+}
+
+static inline uint64_t checksum_add( uint64_t sum, const void * data, int bytes )
+{
+    // one's complement sum of 16 bit words, read in memory order. an odd last byte is padded with zero
+
+    const uint8_t * p = (const uint8_t*) data;
+
+    int i = 0;
+    for ( ; i + 1 < bytes; i += 2 )
+    {
+        uint16_t word;
+        memcpy( &word, p + i, 2 );
+        sum += word;
+    }
+
+    if ( i < bytes )
+    {
+        sum += p[i];
+    }
+
+    return sum;
+}
+
+uint64_t checksum_add_wide_scalar( uint64_t sum, const void * data, int bytes )
+{
+    // same sum as checksum_add, four bytes at a time. 2^16 is 1 mod 0xFFFF, so adding 32 bit words folds to the same thing
+
+    const uint8_t * p = (const uint8_t*) data;
+
+    int i = 0;
+    for ( ; i + 4 <= bytes; i += 4 )
+    {
+        uint32_t word;
+        memcpy( &word, p + i, 4 );
+        sum += word;
+    }
+
+    return checksum_add( sum, p + i, bytes - i );
+}
+
+__attribute__ ((target ("avx2"))) uint64_t checksum_add_wide_avx2( uint64_t sum, const void * data, int bytes )
+{
+    // widen 16 bit words to 32 bit lanes and add 32 bytes at a time. a span is under 64k, so the lanes can't overflow
+
+    const uint8_t * p = (const uint8_t*) data;
+
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i lanes = zero;
+
+    int i = 0;
+    for ( ; i + 32 <= bytes; i += 32 )
+    {
+        const __m256i words = _mm256_loadu_si256( (const __m256i*) ( p + i ) );
+        lanes = _mm256_add_epi32( lanes, _mm256_unpacklo_epi16( words, zero ) );
+        lanes = _mm256_add_epi32( lanes, _mm256_unpackhi_epi16( words, zero ) );
+    }
+
+    uint32_t lane[8];
+    _mm256_storeu_si256( (__m256i*) lane, lanes );
+
+    for ( int j = 0; j < 8; j++ )
+    {
+        sum += lane[j];
+    }
+
+    return checksum_add_wide_scalar( sum, p + i, bytes - i );
+}
+
+uint64_t ( *checksum_add_wide )( uint64_t sum, const void * data, int bytes ) = checksum_add_wide_scalar;  // avx2 if the cpu has it
+
+static inline uint16_t checksum_fold( uint64_t sum )
+{
+    while ( sum >> 16 )
+    {
+        sum = ( sum & 0xFFFF ) + ( sum >> 16 );
+    }
+
+    return ~sum;
+}
+
+static uint32_t crc32c_power( int n )
+{
+    // x^n mod p, in reflected order. bit 31 is x^0
+
+    uint32_t value = 0x80000000;
+    for ( int i = 0; i < n; i++ )
+    {
+        value = ( value & 1 ) ? ( value >> 1 ) ^ CRC32C_POLYNOMIAL : value >> 1;
+    }
+    return value;
+}
+
+uint32_t crc32c_update_scalar( uint32_t crc, const void * data, int bytes )
+{
+    // slicing by 8: eight table lookups per 8 bytes
+
+    const uint8_t * p = data;
+
+    for ( ; bytes >= 8; bytes -= 8, p += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, p, 8 );
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xFF] ^ crc32c_table[6][( word >> 8 ) & 0xFF] ^ crc32c_table[5][( word >> 16 ) & 0xFF] ^ crc32c_table[4][( word >> 24 ) & 0xFF] ^
+              crc32c_table[3][( word >> 32 ) & 0xFF] ^ crc32c_table[2][( word >> 40 ) & 0xFF] ^ crc32c_table[1][( word >> 48 ) & 0xFF] ^ crc32c_table[0][word >> 56];
+    }
+
+    for ( ; bytes > 0; bytes--, p++ )
+    {
+        crc = crc32c_table[0][( crc ^ *p ) & 0xFF] ^ ( crc >> 8 );
+    }
+
+    return crc;
+}
+
+__attribute__ ((target ("sse4.2"))) uint32_t crc32c_update_sse42( uint32_t crc, const void * data, int bytes )
+{
+    // one crc32 instruction per 8 bytes. each depends on the last, so this runs at the instruction's latency, not its throughput
+
+    const uint8_t * p = data;
+
+    uint64_t crc64 = crc;
+
+    for ( ; bytes >= 8; bytes -= 8, p += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, p, 8 );
+        crc64 = _mm_crc32_u64( crc64, word );
+    }
+
+    crc = crc64;
+
+    for ( ; bytes > 0; bytes--, p++ )
+    {
+        crc = _mm_crc32_u8( crc, *p );
+    }
+
+    return crc;
+}
+
+__attribute__ ((target ("sse4.2,pclmul"))) uint32_t crc32c_update_pclmul( uint32_t crc, const void * data, int bytes )
+{
+    // three independent streams keep the crc32 unit busy. then shift the first two streams' crcs past the bytes that followed them with a
+    // carry-less multiply by x^(8n-33), and fold them into the third with one more crc32. short tails go one stream at a time
+
+    const uint8_t * p = data;
+
+    uint64_t crc0 = crc;
+
+    while ( bytes >= 3 * CRC32C_STREAM_BYTES )
+    {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+
+        for ( int i = 0; i < CRC32C_STREAM_BYTES; i += 8 )
+        {
+            uint64_t word0, word1, word2;
+            memcpy( &word0, p + i, 8 );
+            memcpy( &word1, p + CRC32C_STREAM_BYTES + i, 8 );
+            memcpy( &word2, p + 2 * CRC32C_STREAM_BYTES + i, 8 );
+            crc0 = _mm_crc32_u64( crc0, word0 );
+            crc1 = _mm_crc32_u64( crc1, word1 );
+            crc2 = _mm_crc32_u64( crc2, word2 );
+        }
+
+        const __m128i shift0 = _mm_clmulepi64_si128( _mm_cvtsi64_si128( crc0 ), _mm_cvtsi64_si128( crc32c_shift_constant[1] ), 0x00 );
+        const __m128i shift1 = _mm_clmulepi64_si128( _mm_cvtsi64_si128( crc1 ), _mm_cvtsi64_si128( crc32c_shift_constant[0] ), 0x00 );
+
+        crc0 = crc2 ^ _mm_crc32_u64( 0, _mm_cvtsi128_si64( _mm_xor_si128( shift0, shift1 ) ) );
+
+        p += 3 * CRC32C_STREAM_BYTES;
+        bytes -= 3 * CRC32C_STREAM_BYTES;
+    }
+
+    return crc32c_update_sse42( crc0, p, bytes );
+}
+
+uint32_t ( *crc32c_update )( uint32_t crc, const void * data, int bytes ) = crc32c_update_scalar;  // the fastest one this cpu has
+
+const char * crc32c_init()
+{
+    // build the tables and shift constants, then pick an implementation. they all give the same crc. returns its name
+
+    for ( int i = 0; i < 256; i++ )
+    {
+        uint32_t value = i;
+        for ( int bit = 0; bit < 8; bit++ )
+        {
+            value = ( value & 1 ) ? ( value >> 1 ) ^ CRC32C_POLYNOMIAL : value >> 1;
+        }
+        crc32c_table[0][i] = value;
+    }
+
+    for ( int i = 0; i < 256; i++ )
+    {
+        for ( int j = 1; j < 8; j++ )
+        {
+            crc32c_table[j][i] = crc32c_table[0][crc32c_table[j - 1][i] & 0xFF] ^ ( crc32c_table[j - 1][i] >> 8 );
+        }
+    }
+
+    crc32c_shift_constant[0] = crc32c_power( 8 * CRC32C_STREAM_BYTES - 33 );
+    crc32c_shift_constant[1] = crc32c_power( 16 * CRC32C_STREAM_BYTES - 33 );
+
+    if ( __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "pclmul" ) )
+    {
+        crc32c_update = crc32c_update_pclmul;
+        return "sse4.2 + pclmul";
+    }
+
+    if ( __builtin_cpu_supports( "sse4.2" ) )
+    {
+        crc32c_update = crc32c_update_sse42;
+        return "sse4.2";
+    }
+
+    crc32c_update = crc32c_update_scalar;
+    return "scalar";
+}
+
+const EVP_CIPHER * aead_cipher()
+{
+    // libcrypto picks aes-ni, vaes or avx2 code for these itself, from what the cpu has
+
+    switch ( aead )
+    {
+        case AEAD_AES_128_GCM:          return EVP_aes_128_gcm();
+        case AEAD_AES_256_GCM:          return EVP_aes_256_gcm();
+        case AEAD_CHACHA20_POLY1305:    return EVP_chacha20_poly1305();
+        default:                        return NULL;
+    }
+}
+
+static inline bool aead_seal( EVP_CIPHER_CTX * context, uint8_t * payload, int payload_bytes, uint64_t nonce )
+{
+    // write the nonce, encrypt what follows it in place, and put the tag at the end. the context is already keyed, so only the iv changes
+
+    const uint64_t wire_nonce = htobe64( nonce );
+
+    uint8_t iv[AEAD_IV_BYTES];
+    memset( iv, 0, AEAD_IV_BYTES - AEAD_NONCE_BYTES );
+    memcpy( iv + AEAD_IV_BYTES - AEAD_NONCE_BYTES, &wire_nonce, AEAD_NONCE_BYTES );
+
+    memcpy( payload, &wire_nonce, AEAD_NONCE_BYTES );
+
+    uint8_t * text = payload + AEAD_NONCE_BYTES;
+    const int text_bytes = payload_bytes - AEAD_OVERHEAD_BYTES;
+
+    int bytes = 0;
+    int final_bytes = 0;
+
+    return EVP_EncryptInit_ex( context, NULL, NULL, NULL, iv ) &&
+           EVP_EncryptUpdate( context, text, &bytes, text, text_bytes ) &&
+           EVP_EncryptFinal_ex( context, text + bytes, &final_bytes ) &&
+           EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_AEAD_GET_TAG, AEAD_TAG_BYTES, text + text_bytes );
+}
+
+int client_encap_bytes()
+{
+    // outer headers in front of the inner ip packet, not counting the outer ethernet header
+
+    switch ( encap )
+    {
+        case ENCAP_VXLAN:   return sizeof(struct iphdr) + sizeof(struct udphdr) + 8 + sizeof(struct ethhdr);
+        case ENCAP_GRE:     return sizeof(struct iphdr) + 8;
+        case ENCAP_GUE:     return sizeof(struct iphdr) + sizeof(struct udphdr) + 4;
+        default:            return 0;
+    }
+}
+
+int client_l4_bytes( int payload_bytes )
+{
+    // l4 header and payload for the profile. only udp and icmp have a payload we choose
+
+    switch ( profile )
+    {
+        case PROFILE_TCP_SYN:   return TCP_SYN_BYTES;
+        case PROFILE_ICMP:      return 8 + payload_bytes;
+        case PROFILE_DNS:       return sizeof(struct udphdr) + DNS_HEADER_BYTES + dns_question_bytes;
+        default:                return sizeof(struct udphdr) + payload_bytes;
+    }
+}
+
+int client_frame_bytes( int payload_bytes )
+{
+    // ethernet frame without the fcs, as built by client_build_template
+
+    const int ip_header_bytes = ipv6 ? sizeof(struct ipv6hdr) : sizeof(struct iphdr);
+
+    return sizeof(struct ethhdr) + vlan_tags * 4 + client_encap_bytes() + ip_header_bytes + client_l4_bytes( payload_bytes );
+}
+
+double client_wire_bits( int payload_bytes )
+{
+    // what each packet costs on the wire: short frames are padded to 60 bytes, then add the fcs, preamble and inter frame gap
+
+    int frame_bytes = client_frame_bytes( payload_bytes );
+
+    if ( frame_bytes < 60 )
+        frame_bytes = 60;
+
+    return ( frame_bytes + 4 + 8 + 12 ) * 8.0;
+}
+
+int max_payload_bytes()
+{
+    // keep the ip packet within a 1500 byte mtu
+
+    const int ip_header_bytes = ipv6 ? sizeof(struct ipv6hdr) : sizeof(struct iphdr);
+
+    return MAX_PAYLOAD_BYTES - ( ip_header_bytes - sizeof(struct iphdr) ) - client_encap_bytes();
+}
+
+int min_payload_bytes()
+{
+    // the crc tag, or the nonce and tag of an encrypted payload, need room
+
+    if ( aead != AEAD_NONE )
+        return AEAD_OVERHEAD_BYTES;
+
+    return crc_tag ? CRC_TAG_BYTES : 1;
+}
+
+static inline uint64_t random_next( uint64_t * state )
+{
+    // splitmix64. builds the flow tables and seeds the xoshiro lanes, and on the per packet path it gives the tcp syn sequence number and the
+    // dns id and label. one 64 bit value per packet is an add, two multiplies and a few shifts, which is cheap enough there
+
+    uint64_t z = ( *state += 0x9E3779B97F4A7C15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+void random_lanes_seed( struct random_lanes_t * lanes, uint64_t seed )
+{
+    // xoshiro256++ needs a state that isn't all zero, so fill it from splitmix64, as its authors recommend
+
+    for ( int word = 0; word < 4; word++ )
+    {
+        for ( int lane = 0; lane < 4; lane++ )
+        {
+            lanes->s[word][lane] = random_next( &seed );
+        }
+    }
+}
+
+static inline uint64_t rotl64( uint64_t x, int k )
+{
+    return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+void random_fill_scalar( struct random_lanes_t * lanes, uint8_t * data, int bytes )
+{
+    // four xoshiro256++ generators side by side, 32 bytes per step. the same bytes as the avx2 version, just one lane at a time
+
+    uint64_t (*s)[4] = lanes->s;
+
+    while ( bytes > 0 )
+    {
+        uint64_t result[4];
+
+        for ( int lane = 0; lane < 4; lane++ )
+        {
+            result[lane] = rotl64( s[0][lane] + s[3][lane], 23 ) + s[0][lane];
+            const uint64_t t = s[1][lane] << 17;
+            s[2][lane] ^= s[0][lane];
+            s[3][lane] ^= s[1][lane];
+            s[1][lane] ^= s[2][lane];
+            s[0][lane] ^= s[3][lane];
+            s[2][lane] ^= t;
+            s[3][lane] = rotl64( s[3][lane], 45 );
+        }
+
+        const int step_bytes = ( bytes < 32 ) ? bytes : 32;
+        memcpy( data, result, step_bytes );
+        data += step_bytes;
+        bytes -= step_bytes;
+    }
+}
+
+__attribute__ ((target ("avx2"))) void random_fill_avx2( struct random_lanes_t * lanes, uint8_t * data, int bytes )
+{
+    // sockets come from calloc, so the state is only 16 byte aligned. it's loaded once per call, so unaligned loads cost nothing
+
+    __m256i s0 = _mm256_loadu_si256( (__m256i*) lanes->s[0] );
+    __m256i s1 = _mm256_loadu_si256( (__m256i*) lanes->s[1] );
+    __m256i s2 = _mm256_loadu_si256( (__m256i*) lanes->s[2] );
+    __m256i s3 = _mm256_loadu_si256( (__m256i*) lanes->s[3] );
+
+    while ( bytes > 0 )
+    {
+        // avx2 has no 64 bit rotate, so it's two shifts and an or
+
+        const __m256i sum = _mm256_add_epi64( s0, s3 );
+        const __m256i result = _mm256_add_epi64( _mm256_or_si256( _mm256_slli_epi64( sum, 23 ), _mm256_srli_epi64( sum, 64 - 23 ) ), s0 );
+        const __m256i t = _mm256_slli_epi64( s1, 17 );
+        s2 = _mm256_xor_si256( s2, s0 );
+        s3 = _mm256_xor_si256( s3, s1 );
+        s1 = _mm256_xor_si256( s1, s2 );
+        s0 = _mm256_xor_si256( s0, s3 );
+        s2 = _mm256_xor_si256( s2, t );
+        s3 = _mm256_or_si256( _mm256_slli_epi64( s3, 45 ), _mm256_srli_epi64( s3, 64 - 45 ) );
+
+        if ( bytes >= 32 )
+        {
+            _mm256_storeu_si256( (__m256i*) data, result );
+            data += 32;
+            bytes -= 32;
+        }
+        else
+        {
+            // never write past the end. the frame after this one may be in flight
+
+            uint8_t tail[32];
+            _mm256_storeu_si256( (__m256i*) tail, result );
+            memcpy( data, tail, bytes );
+            bytes = 0;
+        }
+    }
+
+    _mm256_storeu_si256( (__m256i*) lanes->s[0], s0 );
+    _mm256_storeu_si256( (__m256i*) lanes->s[1], s1 );
+    _mm256_storeu_si256( (__m256i*) lanes->s[2], s2 );
+    _mm256_storeu_si256( (__m256i*) lanes->s[3], s3 );
+}
+
+static inline int payload_random_bytes( int payload_bytes )
+{
+    // how many bytes at the end of the payload are random
+
+    switch ( payload_mode )
+    {
+        case PAYLOAD_MODE_RANDOM:       return payload_bytes;
+        case PAYLOAD_MODE_RANDOM_TAIL:  return ( random_tail_bytes < payload_bytes ) ? random_tail_bytes : payload_bytes;
+        default:                        return 0;
+    }
+}
+
+static inline void client_finish_payload( struct random_lanes_t * lanes, uint8_t * payload, int payload_bytes )
+{
+    // randomize the end of a socket backend payload, then tag it. the xdp backend does this from its templates instead
+
+    const int data_bytes = crc_tag ? payload_bytes - CRC_TAG_BYTES : payload_bytes;
+
+    const int random_bytes = payload_random_bytes( data_bytes );
+    if ( random_bytes > 0 )
+        random_fill( lanes, payload + data_bytes - random_bytes, random_bytes );
+
+    if ( crc_tag )
+    {
+        const uint32_t tag = htole32( ~crc32c_update( ~0U, payload, data_bytes ) );
+        memcpy( payload + data_bytes, &tag, CRC_TAG_BYTES );
+    }
+}
+
+uint64_t flow_space_size()
+{
+    // number of distinct tuples in the configured ranges, saturating at UINT64_MAX
+
+    const struct flow_range_t * ranges[] = { &flow_source_addresses, &flow_source_ports, &flow_destination_addresses, &flow_destination_ports };
+
+    uint64_t size = 1;
+
+    for ( int i = 0; i < 4; i++ )
+    {
+        uint64_t range_size = (uint64_t) ranges[i]->last - ranges[i]->first + 1;
+        if ( size > UINT64_MAX / range_size )
+            return UINT64_MAX;
+        size *= range_size;
+    }
+
+    return size;
+}
+
+void flow_get_tuple( uint64_t index, struct flow_t * flow )
+{
+    const uint64_t source_addresses = (uint64_t) flow_source_addresses.last - flow_source_addresses.first + 1;
+    const uint64_t source_ports = flow_source_ports.last - flow_source_ports.first + 1;
+    const uint64_t destination_addresses = (uint64_t) flow_destination_addresses.last - flow_destination_addresses.first + 1;
+    const uint64_t destination_ports = flow_destination_ports.last - flow_destination_ports.first + 1;
+
+    flow->source_address = htonl( flow_source_addresses.first + index % source_addresses );
+    index /= source_addresses;
+    flow->source_port = htons( flow_source_ports.first + index % source_ports );
+    index /= source_ports;
+    flow->destination_address = htonl( flow_destination_addresses.first + index % destination_addresses );
+    index /= destination_addresses;
+    flow->destination_port = htons( flow_destination_ports.first + index % destination_ports );
+
+    // like a vxlan endpoint, the outer source port is a hash of the inner tuple
+
+    uint64_t state = ( (uint64_t) flow->source_address << 32 ) ^ flow->destination_address ^ ( (uint64_t) flow->source_port << 16 ) ^ ( (uint64_t) flow->destination_port << 48 );
+    const uint64_t outer_ports = outer_source_ports.last - outer_source_ports.first + 1;
+    flow->outer_source_port = htons( outer_source_ports.first + random_next( &state ) % outer_ports );
+}
+
+void flow_get_vlans( uint64_t flow_index, struct flow_t * flow )
+{
+    // vlans go by flow number, not tuple, so every vlan gets the same share of flows whatever the ranges are
+
+    const uint64_t vlans = flow_vlan_ids.last - flow_vlan_ids.first + 1;
+    const uint64_t outer_vlans = flow_outer_vlan_ids.last - flow_outer_vlan_ids.first + 1;
+
+    flow->vlan_tci = htons( flow_vlan_ids.first + flow_index % vlans );
+    flow->outer_vlan_tci = htons( flow_outer_vlan_ids.first + ( flow_index / vlans ) % outer_vlans );
+}
+
+void rss_init_table()
+{
+    // toeplitz: for every set bit n of the input, xor in the 32 bits of the key starting at bit n. do it a byte at a time with a table per input byte
+
+    for ( int i = 0; i < RSS_INPUT_BYTES; i++ )
+    {
+        for ( int value = 0; value < 256; value++ )
+        {
+            uint32_t hash = 0;
+
+            for ( int bit = 0; bit < 8; bit++ )
+            {
+                if ( ( value & ( 0x80 >> bit ) ) == 0 )
+                    continue;
+
+                int key_bit = i * 8 + bit;
+                uint32_t window = 0;
+                for ( int j = 0; j < 32; j++ )
+                {
+                    int k = key_bit + j;
+                    int set = ( k / 8 < rss_key_bytes ) ? ( rss_key[k / 8] >> ( 7 - k % 8 ) ) & 1 : 0;
+                    window = ( window << 1 ) | set;
+                }
+
+                hash ^= window;
+            }
+
+            rss_table[i][value] = hash;
+        }
+    }
+}
+
+uint32_t rss_hash( const struct flow_t * flow )
+{
+    // the input is source address, destination address, source port, destination port, all in network byte order, which is how struct flow_t stores them
+
+    uint8_t input[RSS_INPUT_BYTES];
+    int address_bytes;
+
+    if ( encap != ENCAP_NONE )
+    {
+        // the nic hashes the outer headers. gre has no ports, so only the addresses
+
+        const uint32_t outer_addresses[2] = { htonl( outer_source_address ), htonl( outer_destination_address ) };
+        const uint16_t outer_ports[2] = { flow->outer_source_port, htons( outer_destination_port ) };
+        memcpy( input, outer_addresses, 8 );
+        memcpy( input + 8, outer_ports, 4 );
+
+        const int input_bytes = ( rss_hash_ports && encap != ENCAP_GRE ) ? 12 : 8;
+
+        uint32_t hash = 0;
+        for ( int i = 0; i < input_bytes; i++ )
+        {
+            hash ^= rss_table[i][input[i]];
+        }
+
+        return hash;
+    }
+
+    if ( ipv6 )
+    {
+        memcpy( input, flow_source_prefix, 12 );
+        memcpy( input + 12, &flow->source_address, 4 );
+        memcpy( input + 16, flow_destination_prefix, 12 );
+        memcpy( input + 28, &flow->destination_address, 4 );
+        address_bytes = 32;
+    }
+    else
+    {
+        memcpy( input, &flow->source_address, 4 );
+        memcpy( input + 4, &flow->destination_address, 4 );
+        address_bytes = 8;
+    }
+
+    memcpy( input + address_bytes, &flow->source_port, 2 );
+    memcpy( input + address_bytes + 2, &flow->destination_port, 2 );
+
+    // nics hash tcp by ports too, and icmp has no ports. --rss-fields is only about udp
+
+    const bool hash_ports = ( profile == PROFILE_TCP_SYN ) || ( profile != PROFILE_ICMP && rss_hash_ports );
+
+    const int input_bytes = hash_ports ? address_bytes + 4 : address_bytes;
+
+    uint32_t hash = 0;
+    for ( int i = 0; i < input_bytes; i++ )
+    {
+        hash ^= rss_table[i][input[i]];
+    }
+
+    return hash;
+}
+
+int rss_queue( const struct flow_t * flow )
+{
+    uint32_t hash = rss_hash( flow );
+
+    if ( rss_indirection_size > 0 )
+        return rss_indirection[hash % rss_indirection_size];
+
+    return hash % rss_queues;
+}
+
+int rss_init()
+{
+    // pick flows so they land on the server queues in proportion to rss_weight. we walk the tuple space in order and keep a tuple if its queue still needs flows
+
+    free( flow_tuple_index );
+    flow_tuple_index = NULL;
+
+    if ( rss_key_bytes == 0 )
+        return 0;
+
+    rss_init_table();
+
+    uint64_t quota[RSS_MAX_QUEUES];
+    uint64_t count[RSS_MAX_QUEUES];
+    memset( count, 0, sizeof(count) );
+
+    double total_weight = 0.0;
+    for ( int i = 0; i < rss_queues; i++ )
+    {
+        total_weight += ( i < num_rss_weights ) ? rss_weight[i] : 1.0;
+    }
+
+    uint64_t total_quota = 0;
+    for ( int i = 0; i < rss_queues; i++ )
+    {
+        double weight = ( i < num_rss_weights ) ? rss_weight[i] : 1.0;
+        quota[i] = (uint64_t) ( num_flows * weight / total_weight );
+        total_quota += quota[i];
+    }
+
+    for ( int i = 0; total_quota < num_flows; i = ( i + 1 ) % rss_queues )
+    {
+        if ( i < num_rss_weights && rss_weight[i] == 0.0 )
+            continue;
+        quota[i]++;
+        total_quota++;
+    }
+
+    // selected tuples per queue, so we can interleave them afterwards
+
+    uint64_t * queue_tuples[RSS_MAX_QUEUES];
+    memset( queue_tuples, 0, sizeof(queue_tuples) );
+
+    int result = 0;
+
+    for ( int i = 0; i < rss_queues; i++ )
+    {
+        queue_tuples[i] = malloc( ( quota[i] + 1 ) * sizeof(uint64_t) );
+        if ( !queue_tuples[i] )
+        {
+            printf( "\nerror: could not allocate rss tables\n\n" );
+            result = 1;
+            goto cleanup;
+        }
+    }
+
+    const uint64_t space = flow_space_size();
+    const uint64_t max_candidates = (uint64_t) num_flows * 1024 + ( 1 << 20 );
+
+    uint64_t found = 0;
+    uint64_t candidate = 0;
+
+    for ( ; found < num_flows && candidate < space && candidate < max_candidates; candidate++ )
+    {
+        struct flow_t flow;
+        flow_get_tuple( candidate, &flow );
+
+        int queue = rss_queue( &flow );
+        if ( queue < 0 || queue >= rss_queues || count[queue] == quota[queue] )
+            continue;
+
+        queue_tuples[queue][count[queue]++] = candidate;
+        found++;
+    }
+
+    if ( found < num_flows )
+    {
+        printf( "\nerror: only found %" PRIu64 " of %d flows with the right rss queues in the first %" PRIu64 " tuples. widen the ranges, or check the indirection table covers every queue\n\n", found, num_flows, candidate );
+        result = 1;
+    }
+    else
+    {
+        flow_tuple_index = malloc( num_flows * sizeof(uint64_t) );
+        if ( !flow_tuple_index )
+        {
+            printf( "\nerror: could not allocate flow tuple index\n\n" );
+            result = 1;
+        }
+        else
+        {
+            // interleave the queues, so consecutive flows go to different server queues
+
+            uint64_t taken[RSS_MAX_QUEUES];
+            memset( taken, 0, sizeof(taken) );
+
+            int n = 0;
+            while ( n < num_flows )
+            {
+                for ( int i = 0; i < rss_queues && n < num_flows; i++ )
+                {
+                    if ( taken[i] < count[i] )
+                        flow_tuple_index[n++] = queue_tuples[i][taken[i]++];
+                }
+            }
+        }
+    }
+
+cleanup:
+
+    for ( int i = 0; i < rss_queues; i++ )
+    {
+        free( queue_tuples[i] );
+    }
+
+    return result;
+}
+
+void rss_print_distribution()
+{
+    // predicted share of flows and packets for each server queue. with zipf, packets follow the flow probabilities instead of the flow count
+
+    if ( rss_key_bytes == 0 )
+        return;
+
+    uint64_t flows[RSS_MAX_QUEUES];
+    double packets[RSS_MAX_QUEUES];
+    memset( flows, 0, sizeof(flows) );
+    memset( packets, 0, sizeof(packets) );
+
+    for ( int i = 0; i < num_flows; i++ )
+    {
+        struct flow_t flow;
+        flow_get_tuple( flow_tuple_index ? flow_tuple_index[i] : i, &flow );
+
+        int queue = rss_queue( &flow );
+        if ( queue < 0 || queue >= RSS_MAX_QUEUES )
+            continue;
+
+        flows[queue]++;
+
+        if ( flow_distribution == FLOW_DISTRIBUTION_ZIPF )
+            packets[queue] += flow_zipf_cdf[i] - ( i > 0 ? flow_zipf_cdf[i-1] : 0.0 );
+        else
+            packets[queue] += 1.0 / num_flows;
+    }
+
+    printf( "\npredicted rss distribution over %d server queues:\n\n", rss_queues );
+    printf( "%8s%12s%12s\n", "queue", "flows", "packets" );
+    for ( int i = 0; i < rss_queues; i++ )
+    {
+        printf( "%8d%12" PRIu64 "%11.2f%%\n", i, flows[i], packets[i] * 100.0 );
+    }
+    printf( "\n" );
+}
+
+int flow_init()
+{
+    // the zipf cdf is shared by all socket threads, and only read while they build their tables
+
+    free( flow_zipf_cdf );
+    flow_zipf_cdf = NULL;
+
+    if ( flow_distribution != FLOW_DISTRIBUTION_ZIPF )
+        goto rss;
+
+    flow_zipf_cdf = malloc( num_flows * sizeof(double) );
+    if ( !flow_zipf_cdf )
+    {
+        printf( "\nerror: could not allocate zipf table\n\n" );
+        return 1;
+    }
+
+    double sum = 0.0;
+    for ( int i = 0; i < num_flows; i++ )
+    {
+        sum += 1.0 / pow( i + 1, flow_zipf_s );
+        flow_zipf_cdf[i] = sum;
+    }
+
+    for ( int i = 0; i < num_flows; i++ )
+    {
+        flow_zipf_cdf[i] /= sum;
+    }
+
+rss:
+
+    if ( rss_init() != 0 )
+        return 1;
+
+    rss_print_distribution();
+
+    return 0;
+}
+
+uint32_t flow_sample_zipf( uint64_t * state )
+{
+    const double u = ( random_next( state ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+
+    uint32_t low = 0;
+    uint32_t high = num_flows - 1;
+
+    while ( low < high )
+    {
+        uint32_t middle = ( low + high ) / 2;
+        if ( flow_zipf_cdf[middle] < u )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+int flow_table_create( struct flow_table_t * table, int partition, int num_partitions )
+{
+    // precompute the tuples this thread sends, in order, so the hot path just walks the table
+
+    uint64_t num_entries;
+
+    if ( flow_distribution == FLOW_DISTRIBUTION_SEQUENTIAL || flow_distribution == FLOW_DISTRIBUTION_FIXED )
+    {
+        num_entries = ( partition < num_flows ) ? ( num_flows - partition + num_partitions - 1 ) / num_partitions : 1;
+    }
+    else
+    {
+        num_entries = FLOW_TABLE_SAMPLES;
+    }
+
+    table->flow = malloc( num_entries * sizeof(struct flow_t) );
+    if ( !table->flow )
+    {
+        printf( "\nerror: could not allocate flow table\n\n" );
+        return 1;
+    }
+
+    uint64_t state = flow_seed ^ ( ( partition + 1 ) * 0xD1B54A32D192ED03ULL );
+
+    for ( uint64_t i = 0; i < num_entries; i++ )
+    {
+        uint64_t index;
+
+        switch ( flow_distribution )
+        {
+            case FLOW_DISTRIBUTION_RANDOM:  index = random_next( &state ) % num_flows; break;
+            case FLOW_DISTRIBUTION_ZIPF:    index = flow_sample_zipf( &state ); break;
+            default:                        index = ( partition + i * num_partitions ) % num_flows; break;
+        }
+
+        flow_get_tuple( flow_tuple_index ? flow_tuple_index[index] : index, &table->flow[i] );
+
+        flow_get_vlans( index, &table->flow[i] );
+    }
+
+    table->num_flows = num_entries;
+    table->index = 0;
+    table->repeat = 0;
+    table->packets_per_flow = ( flow_distribution == FLOW_DISTRIBUTION_FIXED ) ? flow_packets_per_flow : 1;
+
+    return 0;
+}
+
+void flow_table_destroy( struct flow_table_t * table )
+{
+    free( table->flow );
+    table->flow = NULL;
+}
+
+static inline const struct flow_t * flow_table_next( struct flow_table_t * table )
+{
+    const struct flow_t * flow = &table->flow[table->index];
+
+    if ( ++table->repeat >= table->packets_per_flow )
+    {
+        table->repeat = 0;
+        if ( ++table->index == table->num_flows )
+            table->index = 0;
+    }
+
+    return flow;
+}
+
+void client_generate_payload( uint8_t * payload, int payload_bytes, uint32_t counter )
+{
+    (void) counter;
+
+    for ( int i = 0; i < payload_bytes; i++ )
+    {
+        payload[i] = i;
+    }
+}
+
+static inline void * client_generate_ethernet( void * data, const uint8_t * client_ethernet_address, const uint8_t * server_ethernet_address, const struct flow_t * flow, uint16_t protocol )
+{
+    // ethernet header, then any vlan tags. each tag is a tpid and tci, and the last one is followed by the real ethertype. returns where the ip header goes
+
+    struct ethhdr * eth = data;
+
+    memcpy( eth->h_dest, server_ethernet_address, ETH_ALEN );
+    memcpy( eth->h_source, client_ethernet_address, ETH_ALEN );
+
+    uint8_t * field = (uint8_t*) &eth->h_proto;
+
+    if ( vlan_tags == 2 )
+    {
+        const uint16_t tag[2] = { htons( ETH_P_8021AD ), flow->outer_vlan_tci };
+        memcpy( field, tag, 4 );
+        field += 4;
+    }
+
+    if ( vlan_tags >= 1 )
+    {
+        const uint16_t tag[2] = { htons( ETH_P_8021Q ), flow->vlan_tci };
+        memcpy( field, tag, 4 );
+        field += 4;
+    }
+
+    const uint16_t ethertype = htons( protocol );
+    memcpy( field, &ethertype, 2 );
+
+    return field + 2;
+}
+
+static inline void client_generate_encap( void * header, const uint8_t * client_ethernet_address, const uint8_t * server_ethernet_address, const struct flow_t * flow, int inner_bytes )
+{
+    // outer ipv4 header, then the gre header, or the udp header and vxlan or gue header, in front of the inner packet
+
+    const int encap_bytes = client_encap_bytes();
+
+    const uint16_t inner_protocol = ipv6 ? ETH_P_IPV6 : ETH_P_IP;
+
+    struct iphdr * ip = header;
+
+    ip->ihl      = 5;
+    ip->version  = 4;
+    ip->tos      = 0x0;
+    ip->id       = 0;
+    ip->frag_off = htons(0x4000);
+    ip->ttl      = 64;
+    ip->tot_len  = htons( encap_bytes + inner_bytes );
+    ip->protocol = ( encap == ENCAP_GRE ) ? IPPROTO_GRE : IPPROTO_UDP;
+    ip->saddr    = htonl( outer_source_address );
+    ip->daddr    = htonl( outer_destination_address );
+    ip->check    = 0; 
+    ip->check    = ipv4_checksum( ip, sizeof( struct iphdr ) );
+
+    uint8_t * tunnel = header + sizeof( struct iphdr );
+
+    if ( encap == ENCAP_GRE )
+    {
+        const uint16_t gre[2] = { htons( GRE_FLAG_KEY ), htons( inner_protocol ) };
+        const uint32_t key = htonl( tunnel_id );
+        memcpy( tunnel, gre, 4 );
+        memcpy( tunnel + 4, &key, 4 );
+        return;
+    }
+
+    // the outer udp checksum is optional over ipv4, so leave it zero like the kernel does for tunnels
+
+    struct udphdr * udp = (struct udphdr*) tunnel;
+
+    udp->source  = flow->outer_source_port;
+    udp->dest    = htons( outer_destination_port );
+    udp->len     = htons( encap_bytes - sizeof( struct iphdr ) + inner_bytes );
+    udp->check   = 0;
+
+    uint8_t * tunnel_header = tunnel + sizeof( struct udphdr );
+
+    if ( encap == ENCAP_VXLAN )
+    {
+        // flags with the vni present bit, 3 reserved bytes, 24 bit vni, 1 reserved byte. then the inner ethernet header
+
+        memset( tunnel_header, 0, 8 );
+        tunnel_header[0] = 0x08;
+        tunnel_header[4] = ( tunnel_id >> 16 ) & 0xFF;
+        tunnel_header[5] = ( tunnel_id >> 8 ) & 0xFF;
+        tunnel_header[6] = tunnel_id & 0xFF;
+
+        struct ethhdr * eth = (struct ethhdr*) ( tunnel_header + 8 );
+        memcpy( eth->h_dest, server_ethernet_address, ETH_ALEN );
+        memcpy( eth->h_source, client_ethernet_address, ETH_ALEN );
+        eth->h_proto = htons( inner_protocol );
+    }
+    else
+    {
+        // gue variant 0 with no extension fields: version, control bit and header length all zero, then the inner ip protocol and flags
+
+        tunnel_header[0] = 0;
+        tunnel_header[1] = ipv6 ? IPPROTO_IPV6 : IPPROTO_IPIP;
+        tunnel_header[2] = 0;
+        tunnel_header[3] = 0;
+    }
+}
+
+static inline void template_add_l4_span( struct packet_template_t * template, int offset, int bytes )
+{
+    // spans start on a checksum word. only a span that runs to the end of the frame can have an odd length
+
+    assert( template->num_l4_spans < MAX_CHECKSUM_SPANS );
+    assert( ( offset & 1 ) == 0 );
+    template->l4_span[template->num_l4_spans].offset = offset;
+    template->l4_span[template->num_l4_spans].bytes = bytes;
+    template->num_l4_spans++;
+}
+
+packet_writer_t template_pick_writer( const struct packet_template_t * template );
+
+void client_build_template( struct packet_template_t * template, const uint8_t * client_ethernet_address, const struct destination_t * destination, int payload_bytes )
+{
+    // build the packet once for an all zero flow, and remember where everything that changes per packet goes. without a destination, it's the server, with addresses from the flow
+
+    memset( template, 0, sizeof(struct packet_template_t) );
+
+    const uint8_t * server_ethernet_address = destination ? destination->ethernet_address : SERVER_ETHERNET_ADDRESS;
+
+    const uint8_t * destination_prefix = destination ? destination->prefix : flow_destination_prefix;
+
+    struct flow_t flow;
+    memset( &flow, 0, sizeof(flow) );
+
+    uint8_t * data = template->data;
+
+    // generate ethernet header. with a tunnel, the outer ip header is always ipv4
+
+    const uint16_t protocol = ( ipv6 && encap == ENCAP_NONE ) ? ETH_P_IPV6 : ETH_P_IP;
+
+    uint8_t * header = client_generate_ethernet( data, client_ethernet_address, server_ethernet_address, &flow, protocol );
+
+    if ( vlan_tags == 2 )
+    {
+        template->outer_vlan_offset = 2 * ETH_ALEN + 2;
+        template->vlan_offset = 2 * ETH_ALEN + 6;
+    }
+    else if ( vlan_tags == 1 )
+    {
+        template->vlan_offset = 2 * ETH_ALEN + 2;
+    }
+
+    const int encap_bytes = client_encap_bytes();
+
+    const int ip_header_bytes = ipv6 ? sizeof(struct ipv6hdr) : sizeof(struct iphdr);
+
+    const int l4_bytes = client_l4_bytes( payload_bytes );
+
+    const int l4_protocol = ( profile == PROFILE_TCP_SYN ) ? IPPROTO_TCP : ( profile == PROFILE_ICMP ) ? ( ipv6 ? IPPROTO_ICMPV6 : IPPROTO_ICMP ) : IPPROTO_UDP;
+
+    uint8_t * ip = header + encap_bytes;
+
+    uint8_t * l4 = ip + ip_header_bytes;
+
+    const int l4_offset = l4 - data;
+
+    if ( ipv6 )
+    {
+        struct ipv6hdr * ip6 = (struct ipv6hdr*) ip;
+
+        // generate ipv6 header
+
+        ip6->version     = 6;
+        ip6->priority    = 0;
+        ip6->payload_len = htons( l4_bytes );
+        ip6->nexthdr     = l4_protocol;
+        ip6->hop_limit   = 64;
+        memcpy( &ip6->saddr, flow_source_prefix, 12 );
+        memcpy( &ip6->daddr, destination_prefix, 12 );
+
+        template->address_offset = ip - data + 8 + 12;
+        template->address_stride = 16;
+    }
+    else
+    {
+        struct iphdr * ip4 = (struct iphdr*) ip;
+
+        // generate ip header
+
+        ip4->ihl      = 5;
+        ip4->version  = 4;
+        ip4->tos      = 0x0;
+        ip4->id       = 0;
+        ip4->frag_off = htons(0x4000);
+        ip4->ttl      = 64;
+        ip4->tot_len  = htons( sizeof(struct iphdr) + l4_bytes );
+        ip4->protocol = l4_protocol;
+        ip4->check    = 0;
+
+        template->address_offset = ip - data + 12;
+        template->address_stride = 4;
+        template->ip_checksum_offset = ip - data + 10;
+        template->ip_checksum_base = checksum_add( 0, ip, sizeof(struct iphdr) );
+    }
+
+    // generate l4 header and payload
+
+    switch ( profile )
+    {
+        case PROFILE_TCP_SYN:
+        {
+            struct tcphdr * tcp = (struct tcphdr*) l4;
+            tcp->doff   = TCP_SYN_BYTES / 4;
+            tcp->syn    = 1;
+            tcp->window = htons( 65535 );
+
+            // mss 1460, sack permitted, timestamps, nop, window scale 7
+
+            const uint8_t options[TCP_SYN_BYTES - sizeof(struct tcphdr)] = { 2, 4, 0x05, 0xb4, 4, 2, 8, 10, 0, 0, 0, 0, 0, 0, 0, 0, 1, 3, 3, 7 };
+            memcpy( l4 + sizeof(struct tcphdr), options, sizeof(options) );
+
+            template->port_offset = l4_offset;
+            template->sequence_offset = l4_offset + 4;
+            template->timestamp_offset = l4_offset + sizeof(struct tcphdr) + 8;
+            template->l4_checksum_offset = l4_offset + 16;
+            template_add_l4_span( template, template->port_offset, 4 );
+            template_add_l4_span( template, template->sequence_offset, 4 );
+            template_add_l4_span( template, template->timestamp_offset, 4 );
+        }
+        break;
+
+        case PROFILE_ICMP:
+        {
+            l4[0] = ipv6 ? 128 : 8;     // echo request
+            client_generate_payload( l4 + 8, payload_bytes, 0 );
+
+            template->port_offset = l4_offset + 4;
+            template->sequence_offset = l4_offset + 6;
+            template->l4_checksum_offset = l4_offset + 2;
+            template_add_l4_span( template, template->port_offset, 4 );
+        }
+        break;
+
+        case PROFILE_DNS:
+        {
+            struct udphdr * udp = (struct udphdr*) l4;
+            udp->len = htons( l4_bytes );
+
+            // recursion desired, one question
+
+            uint8_t * dns = l4 + sizeof(struct udphdr);
+            dns[2] = 0x01;
+            dns[5] = 1;
+            memcpy( dns + DNS_HEADER_BYTES, dns_question, dns_question_bytes );
+
+            template->port_offset = l4_offset;
+            template->sequence_offset = l4_offset + sizeof(struct udphdr);
+            template->name_offset = template->sequence_offset + DNS_HEADER_BYTES + 1;
+
+            // the udp checksum is optional over ipv4, like with the udp profile
+
+            if ( ipv6 || udp_checksum )
+            {
+                template->l4_checksum_offset = l4_offset + 6;
+                template_add_l4_span( template, template->port_offset, 4 );
+                template_add_l4_span( template, template->sequence_offset, 2 );
+                template_add_l4_span( template, template->name_offset - 1, DNS_LABEL_BYTES + 2 );
+            }
+        }
+        break;
+
+        default:
+        {
+            struct udphdr * udp = (struct udphdr*) l4;
+            udp->len = htons( l4_bytes );
+            client_generate_payload( l4 + sizeof(struct udphdr), payload_bytes, 0 );
+
+            template->port_offset = l4_offset;
+
+            // ipv6 needs a udp checksum. over ipv4 it's optional, and zero means there isn't one
+
+            if ( ipv6 || udp_checksum )
+            {
+                template->l4_checksum_offset = l4_offset + 6;
+                template_add_l4_span( template, template->port_offset, 4 );
+            }
+        }
+        break;
+    }
+
+    // random payload bytes go at the end of the payload, then the crc tag if there is one. when nothing is random the tag is
+    // constant, so it goes in the template. otherwise keep the crc over the bytes in front of the random ones, and finish it per packet
+
+    const int payload_offset = l4_offset + l4_bytes - payload_bytes;
+    const int tag_bytes = ( profile == PROFILE_UDP && crc_tag ) ? CRC_TAG_BYTES : 0;
+    const int data_bytes = payload_bytes - tag_bytes;
+    const int random_bytes = ( profile == PROFILE_UDP || profile == PROFILE_ICMP ) ? payload_random_bytes( data_bytes ) : 0;
+
+    int changing_offset = 0;            // bytes from here to the end of the frame change per packet
+
+    if ( random_bytes > 0 )
+    {
+        template->random_offset = payload_offset + data_bytes - random_bytes;
+        template->random_bytes = random_bytes;
+
+        if ( tag_bytes )
+        {
+            template->crc_offset = payload_offset + data_bytes;
+            template->crc_base = crc32c_update( ~0U, data + payload_offset, data_bytes - random_bytes );
+        }
+
+        changing_offset = template->random_offset;
+    }
+    else if ( tag_bytes )
+    {
+        const uint32_t tag = htole32( ~crc32c_update( ~0U, data + payload_offset, data_bytes ) );
+        memcpy( data + payload_offset + data_bytes, &tag, CRC_TAG_BYTES );
+    }
+
+    // an encrypted payload is different every packet, whatever the plaintext is
+
+    if ( profile == PROFILE_UDP && aead != AEAD_NONE )
+    {
+        template->aead_offset = payload_offset;
+        template->aead_bytes = payload_bytes;
+        changing_offset = payload_offset;
+    }
+
+    // the span starts on a checksum word and runs to the end of the frame, which is fine with an odd length
+
+    if ( template->l4_checksum_offset && changing_offset )
+    {
+        const int span_offset = changing_offset & ~1;
+        template_add_l4_span( template, span_offset, l4_offset + l4_bytes - span_offset );
+    }
+
+    if ( template->l4_checksum_offset )
+    {
+        // everything but icmpv4 has a pseudo header: the addresses, which change per packet, then the l4 length and protocol
+
+        if ( !( profile == PROFILE_ICMP && !ipv6 ) )
+        {
+            template_add_l4_span( template, template->address_offset, 4 );
+            template_add_l4_span( template, template->address_offset + template->address_stride, 4 );
+
+            template->l4_checksum_base += htons( l4_bytes );
+            template->l4_checksum_base += htons( l4_protocol );
+
+            if ( ipv6 )
+            {
+                template->l4_checksum_base = checksum_add( template->l4_checksum_base, flow_source_prefix, 12 );
+                template->l4_checksum_base = checksum_add( template->l4_checksum_base, destination_prefix, 12 );
+            }
+        }
+
+        // sum the rest of the l4 bytes, leaving out the spans we add per packet
+
+        uint8_t l4_copy[MAX_FRAME_BYTES];
+        memcpy( l4_copy, l4, l4_bytes );
+        for ( int i = 0; i < template->num_l4_spans; i++ )
+        {
+            if ( template->l4_span[i].offset >= l4_offset )
+                memset( l4_copy + template->l4_span[i].offset - l4_offset, 0, template->l4_span[i].bytes );
+        }
+
+        template->l4_checksum_base = checksum_add( template->l4_checksum_base, l4_copy, l4_bytes );
+    }
+
+    if ( encap != ENCAP_NONE )
+    {
+        client_generate_encap( header, client_ethernet_address, server_ethernet_address, &flow, ip_header_bytes + l4_bytes );
+
+        if ( encap != ENCAP_GRE )
+            template->outer_port_offset = header - data + sizeof(struct iphdr);
+    }
+
+    template->bytes = l4_offset + l4_bytes;
+    template->payload_bytes = payload_bytes;
+
+    template->write = template_pick_writer( template );
+}
+
+static inline void client_finish_l4_checksum( uint8_t * packet, const struct packet_template_t * template )
+{
+    // most spans are a few bytes of tuple or sequence. random and encrypted payloads make long ones, and those are worth vectorizing
+
+    uint64_t sum = template->l4_checksum_base;
+    for ( int i = 0; i < template->num_l4_spans; i++ )
+    {
+        if ( template->l4_span[i].bytes >= CHECKSUM_WIDE_BYTES )
+            sum = checksum_add_wide( sum, packet + template->l4_span[i].offset, template->l4_span[i].bytes );
+        else
+            sum = checksum_add( sum, packet + template->l4_span[i].offset, template->l4_span[i].bytes );
+    }
+
+    // a zero udp checksum means there isn't one, so it goes on the wire as all ones
+
+    uint16_t checksum = checksum_fold( sum );
+    if ( checksum == 0 && profile != PROFILE_TCP_SYN && profile != PROFILE_ICMP )
+        checksum = 0xFFFF;
+
+    memcpy( packet + template->l4_checksum_offset, &checksum, 2 );
+}
+
+// the header stacks sent most, as packed structs, so every offset in them is a compile time constant. adding a stack is a struct
+// and a line in packet_layouts, not another hand written function
+
+struct layout_udp4_t
+{
+    struct ethhdr eth;
+    struct iphdr ip;
+    struct udphdr udp;
+} __attribute__((packed));
+
+struct layout_vlan_udp4_t
+{
+    struct ethhdr eth;
+    uint16_t vlan_tci;
+    uint16_t vlan_protocol;
+    struct iphdr ip;
+    struct udphdr udp;
+} __attribute__((packed));
+
+struct layout_udp6_t
+{
+    struct ethhdr eth;
+    struct ipv6hdr ip;
+    struct udphdr udp;
+} __attribute__((packed));
+
+struct layout_vlan_udp6_t
+{
+    struct ethhdr eth;
+    uint16_t vlan_tci;
+    uint16_t vlan_protocol;
+    struct ipv6hdr ip;
+    struct udphdr udp;
+} __attribute__((packed));
+
+static inline __attribute__((always_inline)) int client_write_layout( uint8_t * packet, const struct packet_template_t * template, const struct flow_t * flow,
+    const int vlan_offset, const int address_offset, const int address_stride, const int port_offset, const int ip_checksum_offset, const int l4_checksum_offset )
+{
+    // inlined into each layout's writer with constant offsets, so all that's left is the template copy and a few stores. the checksums
+    // are the template's base plus the flow's fields, added as whole words since a one's complement sum doesn't care how it's split
+
+    memcpy( packet, template->data, template->bytes );
+
+    if ( vlan_offset )
+        memcpy( packet + vlan_offset, &flow->vlan_tci, 2 );
+
+    memcpy( packet + address_offset, &flow->source_address, 4 );
+    memcpy( packet + address_offset + address_stride, &flow->destination_address, 4 );
+    memcpy( packet + port_offset, &flow->source_port, 2 );
+    memcpy( packet + port_offset + 2, &flow->destination_port, 2 );
+
+    const uint64_t address_sum = (uint64_t) flow->source_address + flow->destination_address;
+
+    if ( ip_checksum_offset )
+    {
+        const uint16_t checksum = checksum_fold( template->ip_checksum_base + address_sum );
+        memcpy( packet + ip_checksum_offset, &checksum, 2 );
+    }
+
+    if ( l4_checksum_offset )
+    {
+        uint16_t checksum = checksum_fold( template->l4_checksum_base + address_sum + flow->source_port + flow->destination_port );
+        if ( checksum == 0 )
+            checksum = 0xFFFF;
+        memcpy( packet + l4_checksum_offset, &checksum, 2 );
+    }
+
+    return template->bytes;
+}
+
+// each layout's name, writer and struct, then where its vlan tci, the low 32 bits of its source address, its ip checksum and its udp checksum go.
+// 0 where the layout doesn't have one. the destination address is address stride bytes after the source
+
+#define PACKET_LAYOUTS( X )                                                                                                                         \
+    X( "eth/ipv4/udp", client_write_udp4, struct layout_udp4_t,                                                                                     \
+       0, offsetof( struct layout_udp4_t, ip.saddr ), 4, offsetof( struct layout_udp4_t, ip.check ), 0 )                                            \
+    X( "eth/ipv4/udp+checksum", client_write_udp4_checksum, struct layout_udp4_t,                                                                   \
+       0, offsetof( struct layout_udp4_t, ip.saddr ), 4, offsetof( struct layout_udp4_t, ip.check ), offsetof( struct layout_udp4_t, udp.check ) )  \
+    X( "eth/vlan/ipv4/udp", client_write_vlan_udp4, struct layout_vlan_udp4_t,                                                                      \
+       offsetof( struct layout_vlan_udp4_t, vlan_tci ), offsetof( struct layout_vlan_udp4_t, ip.saddr ), 4,                                         \
+       offsetof( struct layout_vlan_udp4_t, ip.check ), 0 )                                                                                         \
+    X( "eth/vlan/ipv4/udp+checksum", client_write_vlan_udp4_checksum, struct layout_vlan_udp4_t,                                                    \
+       offsetof( struct layout_vlan_udp4_t, vlan_tci ), offsetof( struct layout_vlan_udp4_t, ip.saddr ), 4,                                         \
+       offsetof( struct layout_vlan_udp4_t, ip.check ), offsetof( struct layout_vlan_udp4_t, udp.check ) )                                          \
+    X( "eth/ipv6/udp", client_write_udp6, struct layout_udp6_t,                                                                                     \
+       0, offsetof( struct layout_udp6_t, ip.saddr ) + 12, 16, 0, offsetof( struct layout_udp6_t, udp.check ) )                                     \
+    X( "eth/vlan/ipv6/udp", client_write_vlan_udp6, struct layout_vlan_udp6_t,                                                                      \
+       offsetof( struct layout_vlan_udp6_t, vlan_tci ), offsetof( struct layout_vlan_udp6_t, ip.saddr ) + 12, 16,                                   \
+       0, offsetof( struct layout_vlan_udp6_t, udp.check ) )
+
+#define LAYOUT_WRITER( name, writer, layout, vlan_offset, address_offset, address_stride, ip_checksum_offset, l4_checksum_offset )                  \
+    static int writer( uint8_t * packet, const struct packet_template_t * template, const struct flow_t * flow )                                     \
+    {                                                                                                                                               \
+        return client_write_layout( packet, template, flow, vlan_offset, address_offset, address_stride, offsetof( layout, udp ),                   \
+                                    ip_checksum_offset, l4_checksum_offset );                                                                       \
+    }
+
+PACKET_LAYOUTS( LAYOUT_WRITER )
+
+struct packet_layout_t
+{
+    const char * name;
+    packet_writer_t write;
+    int vlan_offset;
+    int address_offset;
+    int address_stride;
+    int port_offset;
+    int ip_checksum_offset;
+    int l4_checksum_offset;
+};
+
+#define LAYOUT_ENTRY( name, writer, layout, vlan_offset, address_offset, address_stride, ip_checksum_offset, l4_checksum_offset )                   \
+    { name, writer, vlan_offset, address_offset, address_stride, offsetof( layout, udp ), ip_checksum_offset, l4_checksum_offset },
+
+const struct packet_layout_t packet_layouts[] =
+{
+    PACKET_LAYOUTS( LAYOUT_ENTRY )
+};
+
+#define NUM_PACKET_LAYOUTS ( sizeof(packet_layouts) / sizeof(packet_layouts[0]) )
+
+packet_writer_t template_pick_writer( const struct packet_template_t * template )
+{
+    // a layout writer only patches the tuple, so the template can't have anything else that changes per packet. it must also agree with
+    // every offset client_build_template worked out, which keeps the two honest: a template that doesn't match any layout just takes the generic path
+
+    if ( profile != PROFILE_UDP || template->outer_vlan_offset || template->outer_port_offset || template->random_bytes || template->aead_offset )
+        return NULL;
+
+    if ( template->l4_checksum_offset && template->num_l4_spans != 3 )
+        return NULL;
+
+    for ( int i = 0; i < NUM_PACKET_LAYOUTS; i++ )
+    {
+        const struct packet_layout_t * layout = &packet_layouts[i];
+
+        if ( template->vlan_offset == layout->vlan_offset && template->address_offset == layout->address_offset && template->address_stride == layout->address_stride &&
+             template->port_offset == layout->port_offset && template->ip_checksum_offset == layout->ip_checksum_offset && template->l4_checksum_offset == layout->l4_checksum_offset )
+        {
+            return layout->write;
+        }
+    }
+
+    return NULL;
+}
+
+const char * template_writer_name( packet_writer_t write )
+{
+    for ( int i = 0; i < NUM_PACKET_LAYOUTS; i++ )
+    {
+        if ( packet_layouts[i].write == write )
+            return packet_layouts[i].name;
+    }
+
+    return "generic";
+}
+
+static inline int client_write_packet( void * data, const struct packet_template_t * template, const struct flow_t * flow, uint32_t counter, uint64_t * random_state, struct random_lanes_t * random_lanes )
+{
+    // copy the template, patch in everything that changes per packet, then finish the checksums from their precomputed bases
+
+    uint8_t * packet = data;
+
+    if ( template->write )
+        return template->write( packet, template, flow );
+
+    if ( template->random_bytes > 0 )
+    {
+        memcpy( packet, template->data, template->random_offset );
+        random_fill( random_lanes, packet + template->random_offset, template->random_bytes );
+
+        if ( template->crc_offset )
+        {
+            const uint32_t tag = htole32( ~crc32c_update( template->crc_base, packet + template->random_offset, template->random_bytes ) );
+            memcpy( packet + template->crc_offset, &tag, CRC_TAG_BYTES );
+        }
+    }
+    else
+    {
+        memcpy( packet, template->data, template->bytes );
+    }
+
+    if ( template->outer_vlan_offset )
+        memcpy( packet + template->outer_vlan_offset, &flow->outer_vlan_tci, 2 );
+
+    if ( template->vlan_offset )
+        memcpy( packet + template->vlan_offset, &flow->vlan_tci, 2 );
+
+    if ( template->outer_port_offset )
+        memcpy( packet + template->outer_port_offset, &flow->outer_source_port, 2 );
+
+    memcpy( packet + template->address_offset, &flow->source_address, 4 );
+    memcpy( packet + template->address_offset + template->address_stride, &flow->destination_address, 4 );
+
+    switch ( profile )
+    {
+        case PROFILE_TCP_SYN:
+        {
+            const uint32_t sequence = random_next( random_state );
+            const uint32_t timestamp = htonl( counter );
+            memcpy( packet + template->port_offset, &flow->source_port, 2 );
+            memcpy( packet + template->port_offset + 2, &flow->destination_port, 2 );
+            memcpy( packet + template->sequence_offset, &sequence, 4 );
+            memcpy( packet + template->timestamp_offset, &timestamp, 4 );
+        }
+        break;
+
+        case PROFILE_ICMP:
+        {
+            const uint16_t sequence = htons( counter );
+            memcpy( packet + template->port_offset, &flow->source_port, 2 );
+            memcpy( packet + template->sequence_offset, &sequence, 2 );
+        }
+        break;
+
+        case PROFILE_DNS:
+        {
+            // 16 bits of id, then 6 bits for each character of the label
+
+            static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+            uint64_t random = random_next( random_state );
+            const uint16_t id = random;
+            random >>= 16;
+
+            memcpy( packet + template->port_offset, &flow->source_port, 2 );
+            memcpy( packet + template->port_offset + 2, &flow->destination_port, 2 );
+            memcpy( packet + template->sequence_offset, &id, 2 );
+
+            uint8_t * label = packet + template->name_offset;
+            for ( int i = 0; i < DNS_LABEL_BYTES; i++ )
+            {
+                label[i] = alphabet[( ( random & 63 ) * ( sizeof(alphabet) - 1 ) ) >> 6];
+                random >>= 6;
+            }
+        }
+        break;
+
+        default:
+        {
+            memcpy( packet + template->port_offset, &flow->source_port, 2 );
+            memcpy( packet + template->port_offset + 2, &flow->destination_port, 2 );
+        }
+        break;
+    }
+
+    if ( template->ip_checksum_offset )
+    {
+        const uint16_t checksum = checksum_fold( checksum_add( template->ip_checksum_base, packet + template->address_offset, 8 ) );
+        memcpy( packet + template->ip_checksum_offset, &checksum, 2 );
+    }
+
+    // with encryption, the l4 checksum is finished once the payload has been sealed
+
+    if ( template->l4_checksum_offset && !template->aead_offset )
+        client_finish_l4_checksum( packet, template );
+
+    return template->bytes;
+}
+
+int client_num_templates()
+{
+    // one template per destination and size, destination major
+
+    return ( num_destinations > 0 ? num_destinations : 1 ) * ( num_sizes > 0 ? num_sizes : 1 );
+}
+
+void socket_build_templates( struct socket_t * socket, int payload_bytes )
+{
+    const int sizes = num_sizes > 0 ? num_sizes : 1;
+
+    for ( int i = 0; i < client_num_templates(); i++ )
+    {
+        const struct destination_t * template_destination = ( num_destinations > 0 ) ? &destination[i / sizes] : NULL;
+        const int template_payload_bytes = ( num_sizes > 0 ) ? packet_size[i % sizes].payload_bytes : payload_bytes;
+        client_build_template( &socket->template[i], socket->interface->ethernet_address, template_destination, template_payload_bytes );
+    }
+
+    socket->template_payload_bytes = payload_bytes;
+}
+
+static inline int socket_next_size( struct socket_t * socket )
+{
+    return ( num_sizes > 0 ) ? size_table[socket->size_table_index++ % SIZE_TABLE_SAMPLES] : 0;
+}
+
+static inline void socket_queue_seal( struct socket_t * socket, uint8_t * payload, int payload_bytes, uint8_t * packet, const struct packet_template_t * template )
+{
+    const int i = socket->num_unsealed++;
+    assert( i < MAX_SEND_BATCH_SIZE );
+    socket->unsealed_payload[i] = payload;
+    socket->unsealed_payload_bytes[i] = payload_bytes;
+    socket->unsealed_packet[i] = packet;
+    socket->unsealed_template[i] = template;
+}
+
+static void socket_time_l4_checksum( struct socket_t * socket, void * data, const struct packet_template_t * template )
+{
+    // timing every packet would cost more than most checksums, so a sample of packets have theirs worked out again, while the packet is still
+    // in cache. it comes out the same, since the checksum field isn't in any span. the gap between two back to back tsc reads is taken off
+
+    const uint64_t tsc_start = get_tsc();
+    const uint64_t checksum_start = get_tsc();
+
+    client_finish_l4_checksum( (uint8_t*) data, template );
+
+    const uint64_t checksum_cycles = get_tsc() - checksum_start;
+    const uint64_t tsc_cycles = checksum_start - tsc_start;
+
+    __sync_fetch_and_add( &socket->checksum_packets, 1 );
+    __sync_fetch_and_add( &socket->checksum_cycles, ( checksum_cycles > tsc_cycles ) ? checksum_cycles - tsc_cycles : 0 );
+}
+
+static inline int socket_write_packet( struct socket_t * socket, void * data, uint32_t counter, int size_index )
+{
+    // the flow picks the source. with a destination table, the schedule picks the destination, and its templates have the mac and ipv6 prefix
+
+    const struct flow_t * flow = flow_table_next( socket->flow_table );
+
+    if ( num_sizes > 0 )
+        socket->size_sent_packets[size_index]++;
+
+    const struct packet_template_t * template = &socket->template[size_index];
+
+    struct flow_t destination_flow;
+
+    if ( num_destinations > 0 )
+    {
+        const int index = destination_schedule[socket->destination_index];
+
+        if ( ++socket->destination_index == destination_schedule_length )
+            socket->destination_index = 0;
+
+        destination_flow = *flow;
+        destination_flow.destination_address = destination[index].address;
+        destination_flow.destination_port = destination[index].port;
+        flow = &destination_flow;
+
+        template = &socket->template[index * ( num_sizes > 0 ? num_sizes : 1 ) + size_index];
+
+        socket->destination_sent_packets[index]++;
+    }
+
+    const int bytes = client_write_packet( data, template, flow, counter, &socket->random_state, &socket->random_lanes );
+
+    if ( template->aead_offset )
+        socket_queue_seal( socket, (uint8_t*) data + template->aead_offset, template->aead_bytes, data, template );
+    else if ( template->l4_checksum_offset && ( counter & ( CHECKSUM_TIME_INTERVAL - 1 ) ) == 0 )
+        socket_time_l4_checksum( socket, data, template );
+
+    return bytes;
+}
+
+static inline void socket_seal_packets( struct socket_t * socket )
+{
+    // encrypt every payload written since the last call, back to back, so the cipher code and key schedule stay hot.
+    // only the encryption is timed. the l4 checksums are finished after, over the ciphertext
+
+    const int count = socket->num_unsealed;
+    if ( count == 0 )
+        return;
+
+    const uint64_t start = get_tsc();
+
+    for ( int i = 0; i < count; i++ )
+    {
+        const bool sealed = aead_seal( socket->aead_context, socket->unsealed_payload[i], socket->unsealed_payload_bytes[i], socket->aead_nonce++ );
+        assert( sealed );
+        (void) sealed;
+    }
+
+    const uint64_t cycles = get_tsc() - start;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( socket->unsealed_packet[i] && socket->unsealed_template[i]->l4_checksum_offset )
+            client_finish_l4_checksum( socket->unsealed_packet[i], socket->unsealed_template[i] );
+    }
+
+    socket->num_unsealed = 0;
+
+    __sync_fetch_and_add( &socket->aead_packets, count );
+    __sync_fetch_and_add( &socket->aead_cycles, cycles );
+}
+
+int uring_create( struct uring_t * uring, unsigned entries )
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof(params) );
+    params.flags = IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = uring_sq_idle;
+    if ( uring_sq_cpu >= 0 )
+    {
+        params.flags |= IORING_SETUP_SQ_AFF;
+        params.sq_thread_cpu = uring_sq_cpu;
+    }
+
+    uring->fd = syscall( __NR_io_uring_setup, entries, &params );
+    if ( uring->fd < 0 )
+    {
+        printf( "\nerror: io_uring_setup failed: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    uring->entries = params.sq_entries;
+
+    uring->sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if ( uring->cq_ring_bytes > uring->sq_ring_bytes )
+            uring->sq_ring_bytes = uring->cq_ring_bytes;
+        uring->cq_ring_bytes = uring->sq_ring_bytes;
+    }
+
+    uring->sq_ring = mmap( NULL, uring->sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING );
+    if ( uring->sq_ring == MAP_FAILED )
+    {
+        printf( "\nerror: could not map io_uring submission queue\n\n" );
+        close( uring->fd );
+        uring->fd = 0;
+        return 1;
+    }
+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        uring->cq_ring = uring->sq_ring;
+    }
+    else
+    {
+        uring->cq_ring = mmap( NULL, uring->cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING );
+        if ( uring->cq_ring == MAP_FAILED )
+        {
+            printf( "\nerror: could not map io_uring completion queue\n\n" );
+            close( uring->fd );
+            uring->fd = 0;
+            return 1;
+        }
+    }
+
+    uring->sqes_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    uring->sqes = mmap( NULL, uring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES );
+    if ( uring->sqes == MAP_FAILED )
+    {
+        printf( "\nerror: could not map io_uring submission queue entries\n\n" );
+        close( uring->fd );
+        uring->fd = 0;
+        return 1;
+    }
+
+    uring->sq_head = uring->sq_ring + params.sq_off.head;
+    uring->sq_tail = uring->sq_ring + params.sq_off.tail;
+    uring->sq_mask = uring->sq_ring + params.sq_off.ring_mask;
+    uring->sq_flags = uring->sq_ring + params.sq_off.flags;
+    uring->sq_array = uring->sq_ring + params.sq_off.array;
+
+    uring->cq_head = uring->cq_ring + params.cq_off.head;
+    uring->cq_tail = uring->cq_ring + params.cq_off.tail;
+    uring->cq_mask = uring->cq_ring + params.cq_off.ring_mask;
+    uring->cqes = uring->cq_ring + params.cq_off.cqes;
+
+    // an empty message is all it takes to kick the driver, same as sendto( fd, NULL, 0, ... )
+
+    memset( &uring->msg, 0, sizeof(uring->msg) );
+
+    return 0;
+}
+
+void uring_destroy( struct uring_t * uring )
+{
+    if ( uring->fd <= 0 )
+        return;
+
+    munmap( uring->sqes, uring->sqes_bytes );
+    if ( uring->cq_ring != uring->sq_ring )
+        munmap( uring->cq_ring, uring->cq_ring_bytes );
+    munmap( uring->sq_ring, uring->sq_ring_bytes );
+    close( uring->fd );
+    uring->fd = 0;
+}
+
+bool uring_submit_kick( struct uring_t * uring, struct socket_t * socket )
+{
+    unsigned tail = *uring->sq_tail;
+    unsigned head = __atomic_load_n( uring->sq_head, __ATOMIC_ACQUIRE );
+    if ( tail - head >= uring->entries )
+        return false;
+
+    unsigned index = tail & *uring->sq_mask;
+
+    struct io_uring_sqe * sqe = &uring->sqes[index];
+    memset( sqe, 0, sizeof(struct io_uring_sqe) );
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = xsk_socket__fd( socket->xsk );
+    sqe->addr = (uint64_t) (uintptr_t) &uring->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = (uint64_t) (uintptr_t) socket;
+
+    uring->sq_array[index] = index;
+
+    __atomic_store_n( uring->sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+    // the SQPOLL kernel thread picks up the submission without a syscall, unless it has gone to sleep
+
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    if ( __atomic_load_n( uring->sq_flags, __ATOMIC_RELAXED ) & IORING_SQ_NEED_WAKEUP )
+    {
+        syscall( __NR_io_uring_enter, uring->fd, 0, 0, IORING_ENTER_SQ_WAKEUP, NULL, 0 );
+        __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+    }
+
+    return true;
+}
+
+void uring_reap( struct uring_t * uring )
+{
+    unsigned head = *uring->cq_head;
+    unsigned tail = __atomic_load_n( uring->cq_tail, __ATOMIC_ACQUIRE );
+
+    if ( head == tail )
+        return;
+
+    while ( head != tail )
+    {
+        struct io_uring_cqe * cqe = &uring->cqes[head & *uring->cq_mask];
+        struct socket_t * socket = (struct socket_t*) (uintptr_t) cqe->user_data;
+        socket->uring_pending = false;
+        head++;
+    }
+
+    __atomic_store_n( uring->cq_head, head, __ATOMIC_RELEASE );
+}
+
+void socket_kick( struct socket_t * socket )
+{
+    int fd = xsk_socket__fd( socket->xsk );
+
+    const int mode = drive_mode;
+
+    if ( mode == DRIVE_MODE_IO_URING )
+    {
+        if ( !uring_submit_kick( socket->uring, socket ) )
+            return;
+        socket->uring_pending = true;
+    }
+    else if ( mode == DRIVE_MODE_POLL )
+    {
+        struct pollfd fds;
+        fds.fd = fd;
+        fds.events = POLLOUT;
+        fds.revents = 0;
+        poll( &fds, 1, 0 );
+        __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+    }
+    else
+    {
+        sendto( fd, NULL, 0, MSG_DONTWAIT, NULL, 0 );
+        __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+    }
+
+    __sync_fetch_and_add( &socket->kicks, 1 );
+
+    socket->batches_since_kick = 0;
+}
+
+bool socket_should_kick( struct socket_t * socket, bool submitted )
+{
+    const int mode = drive_mode;
+
+    if ( ( mode == DRIVE_MODE_NEED_WAKEUP || mode == DRIVE_MODE_IO_URING ) && !xsk_ring_prod__needs_wakeup( &socket->send_queue ) )
+        return false;
+
+    // only one io_uring kick in flight per socket. the kernel will see everything we've queued when it runs
+
+    if ( mode == DRIVE_MODE_IO_URING && socket->uring_pending )
+        return false;
+
+    // if we couldn't queue anything this time around, the send queue is full, so it must be kicked or we stall
+
+    if ( !submitted )
+        return true;
+
+    if ( kick_threshold > 0 )
+    {
+        uint32_t outstanding = XSK_RING_PROD__DEFAULT_NUM_DESCS - xsk_prod_nb_free( &socket->send_queue, XSK_RING_PROD__DEFAULT_NUM_DESCS );
+        return outstanding >= kick_threshold;
+    }
+
+    return socket->batches_since_kick >= kick_every;
+}
+
+bool socket_queue_packets( struct socket_t * socket )
+{
+    // don't do anything if we don't have enough free packets to send a batch
+
+    const int batch_size = send_batch_size;
+
+    // pick sizes for the whole batch up front, so we only go ahead if each pool has frames for its share
+
+    const int packet_payload_bytes = payload_bytes;
+
+    int size_index[MAX_SEND_BATCH_SIZE];
+
+    if ( num_sizes > 0 )
+    {
+        uint32_t needed_frames[NUM_SIZE_CLASSES];
+        memset( needed_frames, 0, sizeof(needed_frames) );
+
+        for ( int i = 0; i < batch_size; i++ )
+        {
+            size_index[i] = size_table[( socket->size_table_index + i ) % SIZE_TABLE_SAMPLES];
+            needed_frames[packet_size[size_index[i]].size_class]++;
+        }
+
+        for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+        {
+            if ( socket->pool[c].num_frames < needed_frames[c] + socket->pool[c].min_free_frames )
+                return false;
+        }
+    }
+    else
+    {
+        // unaligned slots are cut to the payload size. if it grows, wait until every frame is back, then cut them again
+
+        if ( unaligned_umem && unaligned_slot_bytes( client_frame_bytes( packet_payload_bytes ) ) > socket->pool[0].slot_bytes )
+        {
+            if ( socket->pool[0].num_frames < socket->pool[0].max_frames )
+                return false;
+
+            socket_init_frame_pools( socket );
+
+            if ( unaligned_slot_bytes( client_frame_bytes( packet_payload_bytes ) ) > socket->pool[0].slot_bytes )
+                return false;
+        }
+
+        if ( socket->pool[0].num_frames < batch_size + socket->pool[0].min_free_frames )
+            return false;
+
+        memset( size_index, 0, sizeof(int) * batch_size );
+    }
+
+    // queue packets to send
+
+    int send_index;
+    int result = xsk_ring_prod__reserve( &socket->send_queue, batch_size, &send_index );
+    if ( result == 0 ) 
+    {
+        return false;
+    }
+
+    if ( num_sizes > 0 )
+        socket->size_table_index += batch_size;
+
+    if ( socket->template_payload_bytes != packet_payload_bytes )
+    {
+        socket_build_templates( socket, packet_payload_bytes );
+    }
+
+    int num_packets = 0;
+    uint64_t packet_address[MAX_SEND_BATCH_SIZE];
+    int packet_length[MAX_SEND_BATCH_SIZE];
+
+    while ( true )
+    {
+        uint64_t frame = socket_alloc_frame( socket, ( num_sizes > 0 ) ? packet_size[size_index[num_packets]].size_class : 0 );
+
+        assert( frame != INVALID_FRAME );   // this should never happen
+
+        uint8_t * packet = socket->buffer + frame;
+
+        packet_address[num_packets] = frame;
+        packet_length[num_packets] = socket_write_packet( socket, packet, socket->counter + num_packets, size_index[num_packets] );
+
+        assert( packet_length[num_packets] <= socket->pool[( num_sizes > 0 ) ? packet_size[size_index[num_packets]].size_class : 0].slot_bytes );
+
+        num_packets++;
+
+        if ( num_packets == batch_size )
+            break;
+    }
+
+    socket_seal_packets( socket );
+
+    for ( int i = 0; i < num_packets; i++ )
+    {
+        struct xdp_desc * desc = xsk_ring_prod__tx_desc( &socket->send_queue, send_index + i );
+        desc->addr = packet_address[i];
+        desc->len = packet_length[i];
+    }
+
+    xsk_ring_prod__submit( &socket->send_queue, num_packets );
+
+    socket->batches_since_kick++;
+
+    socket->queued_packets += num_packets;
+
+    if ( socket->measuring_working_set && socket->working_set_packets_per_tsc > 0.0 && socket->timed_batch_tsc == 0 )
+    {
+        socket->timed_batch_tsc = get_tsc();
+        socket->timed_batch_end = socket->queued_packets;
+    }
+
+    return true;
+}
+
+static void socket_measure_working_set( struct socket_t * socket )
+{
+    // unbounded, the send and completion rings already cap the frames in flight, so a completion there waits behind all of them, and
+    // rate times latency just gives back the ring sizes. so first take the send rate unbounded, then apply a small provisional cap and
+    // time one batch at a time from queued to completed. once there are enough, the frames we need in flight are that rate times the
+    // slowest completion, doubled for bursts, plus a couple of batches. never more than the send and completion rings can hold between them
+
+    const uint64_t now = get_tsc();
+
+    if ( socket->working_set_start_tsc == 0 )
+    {
+        socket->working_set_start_tsc = now;
+        socket->working_set_start_packets = socket->sent_packets;
+    }
+
+    if ( socket->working_set_packets_per_tsc == 0.0 )
+    {
+        const uint64_t packets = socket->sent_packets - socket->working_set_start_packets;
+
+        if ( packets < (uint64_t) WORKING_SET_SAMPLES * send_batch_size || now == socket->working_set_start_tsc )
+            return;
+
+        socket->working_set_packets_per_tsc = (double) packets / ( now - socket->working_set_start_tsc );
+
+        socket->working_set_frames = WORKING_SET_PROVISIONAL_FRAMES;
+
+        socket_apply_working_set( socket );
+
+        return;
+    }
+
+    if ( socket->timed_batch_tsc == 0 || socket->sent_packets < socket->timed_batch_end )
+        return;
+
+    if ( now - socket->timed_batch_tsc > socket->max_completion_tsc )
+        socket->max_completion_tsc = now - socket->timed_batch_tsc;
+
+    socket->timed_batch_tsc = 0;
+
+    if ( ++socket->completion_samples < WORKING_SET_SAMPLES )
+        return;
+
+    const double packets_per_tsc = socket->working_set_packets_per_tsc;
+
+    uint64_t frames = (uint64_t) ( packets_per_tsc * socket->max_completion_tsc * 2.0 ) + 2 * send_batch_size;
+
+    if ( frames < WORKING_SET_MIN_FRAMES )
+        frames = WORKING_SET_MIN_FRAMES;
+
+    if ( frames > XSK_RING_PROD__DEFAULT_NUM_DESCS + XSK_RING_CONS__DEFAULT_NUM_DESCS )
+        frames = XSK_RING_PROD__DEFAULT_NUM_DESCS + XSK_RING_CONS__DEFAULT_NUM_DESCS;
+
+    socket->working_set_frames = frames;
+
+    socket->measuring_working_set = false;
+
+    socket_apply_working_set( socket );
+
+    printf( "%s queue %d working set %d frames, from %.2f mpps and a %.1fus slowest completion\n", socket->interface->name, socket->queue_id, (int) frames,
+        packets_per_tsc * client.tsc_per_millisecond / 1000.0, socket->max_completion_tsc * 1000.0 / client.tsc_per_millisecond );
+}
+
+bool socket_update_xdp( struct socket_t * socket )
+{
+    bool submitted = socket_queue_packets( socket );
+
+    // send queued packets
+
+    if ( socket_should_kick( socket, submitted ) )
+    {
+        socket_kick( socket );
+    }
+
+    // mark completed sent packet frames as free to be reused
+
+    uint32_t complete_index;
+
+    unsigned int completed = xsk_ring_cons__peek( &socket->complete_queue, XSK_RING_CONS__DEFAULT_NUM_DESCS, &complete_index );
+
+    if ( completed > 0 ) 
+    {
+        for ( int i = 0; i < completed; i++ )
+        {
+            socket_free_frame( socket, *xsk_ring_cons__comp_addr( &socket->complete_queue, complete_index++ ) );
+        }
+
+        xsk_ring_cons__release( &socket->complete_queue, completed );
+
+        __sync_fetch_and_add( &socket->sent_packets, completed );
+
+        socket->counter += completed;
+
+        if ( socket->measuring_working_set )
+            socket_measure_working_set( socket );
+    }
+
+    return submitted || completed > 0;
+}
+
+static int create_socket( int domain, int type, int protocol )
+{
+    // socket_t parameters are all called socket, which hides socket()
+    return socket( domain, type, protocol );
+}
+
+int socket_init_udp( struct socket_t * socket )
+{
+    // one connected udp socket per queue, each with its own source port so the flows spread across server queues
+
+    socket->fd = create_socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    if ( socket->fd < 0 )
+    {
+        printf( "\nerror: could not create udp socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    if ( setsockopt( socket->fd, SOL_SOCKET, SO_BINDTODEVICE, socket->interface->name, strlen( socket->interface->name ) + 1 ) )
+    {
+        printf( "\nerror: could not bind udp socket to device '%s': %s\n\n", socket->interface->name, strerror(errno) );
+        return 1;
+    }
+
+    int value = 1;
+    setsockopt( socket->fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value) );
+
+    struct sockaddr_in address;
+    memset( &address, 0, sizeof(address) );
+    address.sin_family = AF_INET;
+    address.sin_port = htons( CLIENT_PORT + socket->queue_id );
+
+    if ( bind( socket->fd, (struct sockaddr*) &address, sizeof(address) ) )
+    {
+        printf( "\nerror: could not bind udp socket to port %d: %s\n\n", CLIENT_PORT + socket->queue_id, strerror(errno) );
+        return 1;
+    }
+
+    address.sin_addr.s_addr = htonl( SERVER_IPV4_ADDRESS );
+    address.sin_port = htons( SERVER_PORT );
+
+    if ( connect( socket->fd, (struct sockaddr*) &address, sizeof(address) ) )
+    {
+        printf( "\nerror: could not connect udp socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    if ( backend == BACKEND_GSO )
+    {
+        value = payload_bytes;
+        if ( setsockopt( socket->fd, IPPROTO_UDP, UDP_SEGMENT, &value, sizeof(value) ) )
+        {
+            printf( "\nerror: could not set UDP_SEGMENT: %s\n\n", strerror(errno) );
+            return 1;
+        }
+        socket->segment_bytes = value;
+    }
+
+    // payloads for one batch, back to back so gso can send them as one buffer
+
+    const int buffer_size = MAX_SEND_BATCH_SIZE * FRAME_SIZE;
+
+    if ( posix_memalign( &socket->buffer, getpagesize(), buffer_size ) ) 
+    {
+        printf( "\nerror: could not allocate buffer\n\n" );
+        return 1;
+    }
+
+    prefault_memory( socket->buffer, buffer_size );
+
+    return 0;
+}
+
+void socket_shutdown_udp( struct socket_t * socket )
+{
+    if ( socket->fd > 0 )
+    {
+        close( socket->fd );
+    }
+}
+
+bool socket_update_sendmmsg( struct socket_t * socket )
+{
+    const int batch_size = send_batch_size;
+    const int message_bytes = payload_bytes;
+
+    struct mmsghdr messages[MAX_SEND_BATCH_SIZE];
+    struct iovec iov[MAX_SEND_BATCH_SIZE];
+
+    memset( messages, 0, sizeof(messages) );
+
+    for ( int i = 0; i < batch_size; i++ )
+    {
+        uint8_t * payload = socket->buffer + i * FRAME_SIZE;
+        client_generate_payload( payload, message_bytes, socket->counter + i );
+        client_finish_payload( &socket->random_lanes, payload, message_bytes );
+        if ( aead != AEAD_NONE )
+            socket_queue_seal( socket, payload, message_bytes, NULL, NULL );
+        iov[i].iov_base = payload;
+        iov[i].iov_len = message_bytes;
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    socket_seal_packets( socket );
+
+    int sent = sendmmsg( socket->fd, messages, batch_size, MSG_DONTWAIT );
+
+    __sync_fetch_and_add( &socket->kicks, 1 );
+    __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+
+    if ( sent <= 0 )
+        return false;
+
+    __sync_fetch_and_add( &socket->sent_packets, sent );
+
+    socket->counter += sent;
+
+    return true;
+}
+
+bool socket_update_gso( struct socket_t * socket )
+{
+    // each message is up to 64 payloads back to back, and the kernel splits it into packets of segment_bytes
+
+    const int batch_size = send_batch_size;
+
+    if ( socket->segment_bytes != payload_bytes )
+    {
+        // payload size changed on reconfigure
+
+        int value = payload_bytes;
+        if ( setsockopt( socket->fd, IPPROTO_UDP, UDP_SEGMENT, &value, sizeof(value) ) )
+            return false;
+        socket->segment_bytes = value;
+    }
+
+    const int segment_bytes = socket->segment_bytes;
+
+    int segments_per_message = 65000 / segment_bytes;
+    if ( segments_per_message > GSO_MAX_SEGMENTS )
+        segments_per_message = GSO_MAX_SEGMENTS;
+
+    struct mmsghdr messages[MAX_SEND_BATCH_SIZE];
+    struct iovec iov[MAX_SEND_BATCH_SIZE];
+    int message_segments[MAX_SEND_BATCH_SIZE];
+
+    memset( messages, 0, sizeof(messages) );
+
+    int num_messages = 0;
+
+    for ( int i = 0; i < batch_size; i += segments_per_message )
+    {
+        int segments = batch_size - i;
+        if ( segments > segments_per_message )
+            segments = segments_per_message;
+
+        uint8_t * payload = socket->buffer + i * segment_bytes;
+        for ( int j = 0; j < segments; j++ )
+        {
+            client_generate_payload( payload + j * segment_bytes, segment_bytes, socket->counter + i + j );
+            client_finish_payload( &socket->random_lanes, payload + j * segment_bytes, segment_bytes );
+            if ( aead != AEAD_NONE )
+                socket_queue_seal( socket, payload + j * segment_bytes, segment_bytes, NULL, NULL );
+        }
+
+        iov[num_messages].iov_base = payload;
+        iov[num_messages].iov_len = segments * segment_bytes;
+        messages[num_messages].msg_hdr.msg_iov = &iov[num_messages];
+        messages[num_messages].msg_hdr.msg_iovlen = 1;
+        message_segments[num_messages] = segments;
+        num_messages++;
+    }
+
+    socket_seal_packets( socket );
+
+    int sent = sendmmsg( socket->fd, messages, num_messages, MSG_DONTWAIT );
+
+    __sync_fetch_and_add( &socket->kicks, 1 );
+    __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+
+    if ( sent <= 0 )
+        return false;
+
+    int sent_packets = 0;
+    for ( int i = 0; i < sent; i++ )
+    {
+        sent_packets += message_segments[i];
+    }
+
+    __sync_fetch_and_add( &socket->sent_packets, sent_packets );
+
+    socket->counter += sent_packets;
+
+    return true;
+}
+
+int socket_init_packet( struct socket_t * socket )
+{
+    // protocol 0 means this socket never receives anything, we only use it to send
+
+    socket->fd = create_socket( AF_PACKET, SOCK_RAW, 0 );
+    if ( socket->fd < 0 )
+    {
+        printf( "\nerror: could not create packet socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    int value = TPACKET_V3;
+    if ( setsockopt( socket->fd, SOL_PACKET, PACKET_VERSION, &value, sizeof(value) ) )
+    {
+        printf( "\nerror: could not set TPACKET_V3: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    // send straight to the driver, like AF_XDP does
+
+    value = 1;
+    if ( setsockopt( socket->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &value, sizeof(value) ) )
+    {
+        printf( "\nerror: could not set PACKET_QDISC_BYPASS: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct tpacket_req3 request;
+    memset( &request, 0, sizeof(request) );
+    request.tp_block_size = PACKET_BLOCK_SIZE;
+    request.tp_frame_size = PACKET_FRAME_SIZE;
+    request.tp_block_nr = ( PACKET_NUM_FRAMES * PACKET_FRAME_SIZE ) / PACKET_BLOCK_SIZE;
+    request.tp_frame_nr = PACKET_NUM_FRAMES;
+
+    if ( setsockopt( socket->fd, SOL_PACKET, PACKET_TX_RING, &request, sizeof(request) ) )
+    {
+        printf( "\nerror: could not create packet tx ring: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    socket->packet_ring_bytes = request.tp_block_size * request.tp_block_nr;
+
+    socket->packet_ring = mmap( NULL, socket->packet_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, socket->fd, 0 );
+    if ( socket->packet_ring == MAP_FAILED )
+    {
+        socket->packet_ring = NULL;
+        printf( "\nerror: could not map packet tx ring: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct sockaddr_ll address;
+    memset( &address, 0, sizeof(address) );
+    address.sll_family = AF_PACKET;
+    address.sll_ifindex = socket->interface->interface_index;
+
+    if ( bind( socket->fd, (struct sockaddr*) &address, sizeof(address) ) )
+    {
+        printf( "\nerror: could not bind packet socket to '%s': %s\n\n", socket->interface->name, strerror(errno) );
+        return 1;
+    }
+
+    return 0;
+}
+
+void socket_shutdown_packet( struct socket_t * socket )
+{
+    if ( socket->packet_ring )
+    {
+        munmap( socket->packet_ring, socket->packet_ring_bytes );
+    }
+
+    if ( socket->fd > 0 )
+    {
+        close( socket->fd );
+    }
+}
+
+bool socket_update_packet( struct socket_t * socket )
+{
+    // reclaim frames the kernel has finished sending. frames complete in order
+
+    int completed = 0;
+
+    while ( socket->packet_in_flight > 0 )
+    {
+        struct tpacket3_hdr * header = socket->packet_ring + socket->packet_complete_index * PACKET_FRAME_SIZE;
+
+        uint32_t status = __atomic_load_n( &header->tp_status, __ATOMIC_ACQUIRE );
+        if ( status & ( TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING ) )
+            break;
+
+        if ( status == TP_STATUS_AVAILABLE )
+            completed++;
+
+        header->tp_status = TP_STATUS_AVAILABLE;
+
+        socket->packet_complete_index = ( socket->packet_complete_index + 1 ) % PACKET_NUM_FRAMES;
+        socket->packet_in_flight--;
+    }
+
+    if ( completed > 0 )
+    {
+        __sync_fetch_and_add( &socket->sent_packets, completed );
+    }
+
+    // queue a batch of packets in the tx ring
+
+    const int batch_size = send_batch_size;
+    const int packet_payload_bytes = payload_bytes;
+
+    if ( socket->template_payload_bytes != packet_payload_bytes )
+    {
+        socket_build_templates( socket, packet_payload_bytes );
+    }
+
+    int queued = 0;
+
+    struct tpacket3_hdr * queued_header[MAX_SEND_BATCH_SIZE];
+
+    while ( queued < batch_size && socket->packet_in_flight < PACKET_NUM_FRAMES )
+    {
+        struct tpacket3_hdr * header = socket->packet_ring + socket->packet_send_index * PACKET_FRAME_SIZE;
+
+        uint8_t * packet = (uint8_t*) header + TPACKET_ALIGN( sizeof(struct tpacket3_hdr) );
+
+        header->tp_next_offset = 0;
+        header->tp_len = socket_write_packet( socket, packet, socket->counter + queued, socket_next_size( socket ) );
+
+        queued_header[queued] = header;
+
+        socket->packet_send_index = ( socket->packet_send_index + 1 ) % PACKET_NUM_FRAMES;
+        socket->packet_in_flight++;
+        queued++;
+    }
+
+    // the kernel can have a frame as soon as its status says so, so encrypt the whole batch first
+
+    socket_seal_packets( socket );
+
+    for ( int i = 0; i < queued; i++ )
+    {
+        __atomic_store_n( &queued_header[i]->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE );
+    }
+
+    if ( queued > 0 )
+    {
+        send( socket->fd, NULL, 0, MSG_DONTWAIT );
+
+        __sync_fetch_and_add( &socket->kicks, 1 );
+        __sync_fetch_and_add( &socket->kick_syscalls, 1 );
+
+        socket->counter += queued;
+    }
+
+    return queued > 0 || completed > 0;
+}
+
+const struct backend_t backends[BACKEND_NUM_BACKENDS] =
+{
+    { "xdp",        socket_init_xdp,        socket_update_xdp,          socket_shutdown_xdp },
+    { "sendmmsg",   socket_init_udp,        socket_update_sendmmsg,     socket_shutdown_udp },
+    { "gso",        socket_init_udp,        socket_update_gso,          socket_shutdown_udp },
+    { "packet",     socket_init_packet,     socket_update_packet,       socket_shutdown_packet },
+};
+
+static inline void cpu_pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile( "yield" );
+#endif
+}
+
+static inline uint64_t get_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t get_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return get_nanoseconds();
+#endif
+}
+
+static void thread_sleep_until( struct thread_t * thread, uint64_t nanoseconds )
+{
+    // sleep until a CLOCK_MONOTONIC time, counted as idle like time blocked in poll
+
+    const uint64_t start = get_nanoseconds();
+
+    if ( nanoseconds <= start )
+        return;
+
+    struct timespec deadline;
+    deadline.tv_sec = nanoseconds / 1000000000ULL;
+    deadline.tv_nsec = nanoseconds % 1000000000ULL;
+
+    while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL ) == EINTR && !quit ) {}
+
+    __sync_fetch_and_add( &thread->idle_nanoseconds, get_nanoseconds() - start );
+}
+
+void thread_idle( struct thread_t * thread, int idle_iterations )
+{
+    if ( idle_strategy == IDLE_STRATEGY_SPIN || idle_iterations < idle_spin_iterations )
+        return;
+
+    if ( idle_iterations < idle_spin_iterations + idle_pause_iterations )
+    {
+        cpu_pause();
+        return;
+    }
+
+    // nothing to do for a while. block until the kernel frees up room in any of our send queues. on an xsk fd, POLLOUT only means
+    // there's room in the send ring, and nothing wakes poll when completions come back. so if any socket has room and is only waiting
+    // for completions, eg. because its frames or working set are used up, poll would return straight away. sleep a little instead,
+    // so the completions can land while we're off the cpu
+
+    if ( backend == BACKEND_XDP )
+    {
+        for ( int i = 0; i < thread->num_sockets; i++ )
+        {
+            if ( xsk_prod_nb_free( &thread->socket[i]->send_queue, 1 ) > 0 )
+            {
+                thread_sleep_until( thread, get_nanoseconds() + IDLE_SLEEP_NANOSECONDS );
+                return;
+            }
+        }
+    }
+
+    uint64_t start = get_nanoseconds();
+
+    struct pollfd fds[MAX_SOCKETS];
+    for ( int i = 0; i < thread->num_sockets; i++ )
+    {
+        fds[i].fd = thread->socket[i]->fd;
+        fds[i].events = POLLOUT;
+        fds[i].revents = 0;
+    }
+    poll( fds, thread->num_sockets, idle_poll_timeout );
+
+    __sync_fetch_and_add( &thread->idle_nanoseconds, get_nanoseconds() - start );
+}
+
+static void * socket_thread( void * arg )
+{
+    struct thread_t * thread = (struct thread_t*) arg;
+
+    struct client_t * client = thread->client;
+
+    printf( "started socket thread #%d on cpu %d driving %d queues\n", thread->thread_index, thread->cpu, thread->num_sockets );
+
+    pin_thread_to_cpu( thread->cpu );
+
+    // set up our sockets here, so their memory is first touched on the cpu that drives them
+
+    thread->init_result = 0;
+
+    for ( int i = 0; i < thread->num_sockets; i++ )
+    {
+        struct socket_t * socket = thread->socket[i];
+
+        if ( socket->initialized )
+            continue;
+
+        if ( backends[backend].init( socket ) != 0 )
+        {
+            thread->init_result = 1;
+            break;
+        }
+
+        socket->initialized = true;
+    }
+
+    // with the xdp backend each socket thread gets its own io_uring for kicks, shared by all of its sockets
+
+    const bool use_uring = backend == BACKEND_XDP && ( drive_mode == DRIVE_MODE_IO_URING || compare_seconds > 0 );
+
+    if ( use_uring && thread->init_result == 0 )
+    {
+        unsigned entries = 8;
+        while ( entries < thread->num_sockets )
+            entries *= 2;
+
+        if ( uring_create( &thread->uring, entries ) != 0 )
+        {
+            thread->init_result = 1;
+        }
+        else
+        {
+            for ( int i = 0; i < thread->num_sockets; i++ )
+            {
+                thread->socket[i]->uring = &thread->uring;
+            }
+        }
+    }
+
+    // build this thread's flow table here too, so it lives on our numa node
+
+    if ( thread->init_result == 0 )
+    {
+        if ( flow_table_create( &thread->flow_table, thread->flow_partition, thread->num_flow_partitions ) != 0 )
+        {
+            thread->init_result = 1;
+        }
+        else
+        {
+            for ( int i = 0; i < thread->num_sockets; i++ )
+            {
+                thread->socket[i]->flow_table = &thread->flow_table;
+            }
+        }
+    }
+
+    // wait until every socket thread is set up, then start sending at the same instant
+
+    pthread_barrier_wait( &client->ready_barrier );
+    pthread_barrier_wait( &client->go_barrier );
+
+    while ( !quit && !client->stop_socket_threads && get_tsc() < client->start_tsc )
+    {
+        cpu_pause();
+    }
+
+    bool ( *update )( struct socket_t * socket ) = backends[backend].update;
+
+    int idle_iterations = 0;
+
+    while ( !quit && !client->stop_socket_threads )
+    {
+        if ( paused )
+        {
+            usleep( 1000 );
+            continue;
+        }
+
+        // pace to the send rate. each round sends up to a batch per socket, and this thread's share of the rate is proportional to its sockets
+
+        const uint64_t rate = send_rate;
+
+        if ( rate > 0 )
+        {
+            const uint64_t now = get_nanoseconds();
+
+            if ( now < thread->next_send_nanoseconds )
+            {
+                if ( idle_strategy != IDLE_STRATEGY_SPIN && thread->next_send_nanoseconds - now > RATE_SPIN_NANOSECONDS )
+                    thread_sleep_until( thread, thread->next_send_nanoseconds - RATE_SPIN_NANOSECONDS );
+                else
+                    cpu_pause();
+                continue;
+            }
+
+            const uint64_t round_nanoseconds = 1000000000ULL * send_batch_size * client->num_sockets / rate;
+
+            // don't burst to catch up after a stall, or after being paused
+
+            if ( thread->next_send_nanoseconds + round_nanoseconds < now )
+                thread->next_send_nanoseconds = now;
+            else
+                thread->next_send_nanoseconds += round_nanoseconds;
+        }
+
+        // round robin one batch per socket
+
+        bool did_work = false;
+
+        for ( int i = 0; i < thread->num_sockets; i++ )
+        {
+            did_work |= update( thread->socket[i] );
+        }
+
+        if ( use_uring )
+        {
+            uring_reap( &thread->uring );
+        }
+
+        if ( did_work )
+        {
+            idle_iterations = 0;
+        }
+        else
+        {
+            thread_idle( thread, idle_iterations++ );
+        }
+    }
+
+    uring_destroy( &thread->uring );
+
+    flow_table_destroy( &thread->flow_table );
+
+    return NULL;
+}
+
+static bool parse_address_range( const char * string, struct flow_range_t * range, uint8_t * prefix )
+{
+    // a.b.c.d or a.b.c.d-e.f.g.h. with ipv6, both ends must share the upper 96 bits, which go in prefix
+
+    char first[64], last[64];
+
+    int count = sscanf( string, "%63[^-]-%63s", first, last );
+    if ( count < 1 )
+        return false;
+
+    if ( count == 1 )
+        strcpy( last, first );
+
+    if ( ipv6 )
+    {
+        struct in6_addr first_address, last_address;
+        if ( inet_pton( AF_INET6, first, &first_address ) != 1 || inet_pton( AF_INET6, last, &last_address ) != 1 )
+            return false;
+        if ( memcmp( &first_address, &last_address, 12 ) != 0 )
+            return false;
+        memcpy( prefix, &first_address, 12 );
+        uint32_t low;
+        memcpy( &low, (uint8_t*) &first_address + 12, 4 );
+        range->first = ntohl( low );
+        memcpy( &low, (uint8_t*) &last_address + 12, 4 );
+        range->last = ntohl( low );
+    }
+    else
+    {
+        struct in_addr first_address, last_address;
+        if ( inet_pton( AF_INET, first, &first_address ) != 1 || inet_pton( AF_INET, last, &last_address ) != 1 )
+            return false;
+        range->first = ntohl( first_address.s_addr );
+        range->last = ntohl( last_address.s_addr );
+    }
+
+    return range->first <= range->last;
+}
+
+static bool parse_dns_domain( const char * domain )
+{
+    // the question is a random label, then each label of the domain with a length byte in front, a zero length root label, then type A and class IN
+
+    int bytes = 0;
+
+    dns_question[bytes++] = DNS_LABEL_BYTES;
+    memset( dns_question + bytes, 0, DNS_LABEL_BYTES );
+    bytes += DNS_LABEL_BYTES;
+
+    const char * label = domain;
+
+    while ( *label )
+    {
+        const char * end = strchr( label, '.' );
+        int label_bytes = end ? end - label : strlen( label );
+
+        if ( label_bytes < 1 || label_bytes > 63 || bytes + 1 + label_bytes + 1 > MAX_DNS_NAME_BYTES )
+            return false;
+
+        dns_question[bytes++] = label_bytes;
+        memcpy( dns_question + bytes, label, label_bytes );
+        bytes += label_bytes;
+
+        label += label_bytes;
+        if ( *label == '.' )
+            label++;
+    }
+
+    dns_question[bytes++] = 0;
+
+    const uint8_t type_and_class[4] = { 0, 1, 0, 1 };
+    memcpy( dns_question + bytes, type_and_class, 4 );
+    bytes += 4;
+
+    dns_question_bytes = bytes;
+
+    return true;
+}
+
+static int read_destinations( const char * filename )
+{
+    // one "mac address port [weight]" per line. addresses are ipv4, or ipv6 with --ipv6
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+    {
+        printf( "\nerror: could not open destinations file '%s'\n\n", filename );
+        return 1;
+    }
+
+    bool error = false;
+    int line_number = 0;
+    char line[256];
+
+    num_destinations = 0;
+
+    while ( !error && fgets( line, sizeof(line), file ) )
+    {
+        line_number++;
+
+        char * comment = strchr( line, '#' );
+        if ( comment )
+            *comment = '\0';
+
+        char mac[32], address[INET6_ADDRSTRLEN];
+        int port, weight = 1;
+
+        int count = sscanf( line, "%31s %45s %d %d", mac, address, &port, &weight );
+        if ( count <= 0 )
+            continue;
+
+        if ( num_destinations == MAX_DESTINATIONS )
+        {
+            printf( "\nerror: %s:%d: too many destinations. max is %d\n\n", filename, line_number, MAX_DESTINATIONS );
+            error = true;
+            break;
+        }
+
+        struct destination_t * entry = &destination[num_destinations];
+        memset( entry, 0, sizeof(struct destination_t) );
+
+        uint8_t * e = entry->ethernet_address;
+
+        if ( count < 3 || sscanf( mac, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &e[0], &e[1], &e[2], &e[3], &e[4], &e[5] ) != ETH_ALEN || port < 1 || port > 65535 || weight < 1 )
+        {
+            printf( "\nerror: %s:%d: expected a mac address, an address, a port and an optional weight\n\n", filename, line_number );
+            error = true;
+            break;
+        }
+
+        if ( ipv6 )
+        {
+            struct in6_addr ipv6_address;
+            if ( inet_pton( AF_INET6, address, &ipv6_address ) != 1 )
+                error = true;
+            memcpy( entry->prefix, &ipv6_address, 12 );
+            memcpy( &entry->address, (uint8_t*) &ipv6_address + 12, 4 );
+            snprintf( entry->name, sizeof(entry->name), "[%s]:%d", address, port );
+        }
+        else
+        {
+            struct in_addr ipv4_address;
+            if ( inet_pton( AF_INET, address, &ipv4_address ) != 1 )
+                error = true;
+            entry->address = ipv4_address.s_addr;
+            snprintf( entry->name, sizeof(entry->name), "%s:%d", address, port );
+        }
+
+        if ( error )
+        {
+            printf( "\nerror: %s:%d: invalid %s address '%s'\n\n", filename, line_number, ipv6 ? "ipv6" : "ipv4", address );
+            break;
+        }
+
+        entry->port = htons( port );
+        entry->weight = weight;
+
+        num_destinations++;
+    }
+
+    fclose( file );
+
+    if ( error )
+        return 1;
+
+    if ( num_destinations == 0 )
+    {
+        printf( "\nerror: %s has no destinations\n\n", filename );
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool build_destination_schedule()
+{
+    // smooth weighted round robin: each step, every destination earns its weight, and the richest one pays the total weight to send a packet. over the whole schedule each destination gets exactly its weight in packets, spread out rather than in bursts
+
+    if ( destination_schedule_type == DESTINATION_SCHEDULE_ROUND_ROBIN )
+    {
+        for ( int i = 0; i < num_destinations; i++ )
+        {
+            destination_schedule[i] = i;
+        }
+        destination_schedule_length = num_destinations;
+        return true;
+    }
+
+    int total_weight = 0;
+    for ( int i = 0; i < num_destinations; i++ )
+    {
+        total_weight += destination[i].weight;
+        if ( total_weight > MAX_DESTINATION_SCHEDULE )
+            return false;
+    }
+
+    int current[MAX_DESTINATIONS];
+    memset( current, 0, sizeof(current) );
+
+    for ( int step = 0; step < total_weight; step++ )
+    {
+        int best = 0;
+        for ( int i = 0; i < num_destinations; i++ )
+        {
+            current[i] += destination[i].weight;
+            if ( current[i] > current[best] )
+                best = i;
+        }
+        current[best] -= total_weight;
+        destination_schedule[step] = best;
+    }
+
+    destination_schedule_length = total_weight;
+
+    return true;
+}
+
+static bool add_size( int first_bytes, int last_bytes, uint64_t weight )
+{
+    // a range of sizes, like the rx_65_127_bytes counters nics keep, is sent as its middle size
+
+    if ( num_sizes == MAX_SIZES || first_bytes < 1 || last_bytes < first_bytes || weight == 0 )
+        return false;
+
+    packet_size[num_sizes].frame_bytes = ( first_bytes + last_bytes ) / 2;
+    packet_size[num_sizes].weight = weight;
+    num_sizes++;
+
+    return true;
+}
+
+static bool parse_sizes( const char * string )
+{
+    // imix, or frame sizes with the fcs and optional weights: 64:7,594:4,1518:1
+
+    num_sizes = 0;
+
+    if ( strcmp( string, "imix" ) == 0 )
+    {
+        // simple imix: 7 parts 64 byte frames, 4 parts 594 and 1 part 1518
+
+        return add_size( 64, 64, 7 ) && add_size( 594, 594, 4 ) && add_size( 1518, 1518, 1 );
+    }
+
+    char buffer[1024];
+    snprintf( buffer, sizeof(buffer), "%s", string );
+
+    char * save = NULL;
+    for ( char * token = strtok_r( buffer, ",", &save ); token; token = strtok_r( NULL, ",", &save ) )
+    {
+        int bytes;
+        unsigned long long weight = 1;
+        if ( sscanf( token, "%d:%llu", &bytes, &weight ) < 1 || !add_size( bytes, bytes, weight ) )
+            return false;
+    }
+
+    return num_sizes > 0;
+}
+
+static int read_sizes( const char * filename )
+{
+    // a histogram: one "size count" or "first-last count" per line, with frame sizes including the fcs
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+    {
+        printf( "\nerror: could not open sizes file '%s'\n\n", filename );
+        return 1;
+    }
+
+    bool error = false;
+    int line_number = 0;
+    char line[256];
+
+    num_sizes = 0;
+
+    while ( !error && fgets( line, sizeof(line), file ) )
+    {
+        line_number++;
+
+        char * comment = strchr( line, '#' );
+        if ( comment )
+            *comment = '\0';
+
+        char range[64];
+        unsigned long long count;
+
+        int fields = sscanf( line, "%63s %llu", range, &count );
+        if ( fields <= 0 )
+            continue;
+
+        int first_bytes, last_bytes;
+        int range_fields = ( fields == 2 ) ? sscanf( range, "%d-%d", &first_bytes, &last_bytes ) : 0;
+        if ( range_fields == 1 )
+            last_bytes = first_bytes;
+
+        // sizes that never happened are fine, they just don't get sent
+
+        if ( range_fields < 1 || ( count > 0 && !add_size( first_bytes, last_bytes, count ) ) )
+        {
+            printf( "\nerror: %s:%d: expected a size or range and a count, and at most %d sizes with nonzero counts\n\n", filename, line_number, MAX_SIZES );
+            error = true;
+        }
+    }
+
+    fclose( file );
+
+    if ( error )
+        return 1;
+
+    if ( num_sizes == 0 )
+    {
+        printf( "\nerror: %s has no sizes\n\n", filename );
+        return 1;
+    }
+
+    return 0;
+}
+
+static void build_size_table()
+{
+    // clamp each size to what fits our headers and the mtu, then give it slots in the table in proportion to its weight, by largest remainder
+    // with at least one each. the table is shuffled, so sizes are mixed like real traffic, but every pass through it is exact
+
+    const int header_bytes = client_frame_bytes( 0 ) + 4;
+
+    uint64_t total_weight = 0;
+
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        struct packet_size_t * size = &packet_size[i];
+
+        size->payload_bytes = size->frame_bytes - header_bytes;
+        if ( size->payload_bytes < min_payload_bytes() )
+            size->payload_bytes = min_payload_bytes();
+        if ( size->payload_bytes > max_payload_bytes() )
+            size->payload_bytes = max_payload_bytes();
+
+        size->frame_bytes = client_frame_bytes( size->payload_bytes ) + 4;
+
+        size->size_class = NUM_SIZE_CLASSES - 1;
+        for ( int c = 0; c < NUM_SIZE_CLASSES; c++ )
+        {
+            if ( client_frame_bytes( size->payload_bytes ) <= size_class_slot_bytes[c] )
+            {
+                size->size_class = c;
+                break;
+            }
+        }
+
+        total_weight += size->weight;
+    }
+
+    int slots[MAX_SIZES];
+    double remainder[MAX_SIZES];
+    int used_slots = 0;
+
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        const double share = (double) packet_size[i].weight * ( SIZE_TABLE_SAMPLES - num_sizes ) / total_weight;
+        slots[i] = 1 + (int) share;
+        remainder[i] = share - (int) share;
+        used_slots += slots[i];
+    }
+
+    while ( used_slots < SIZE_TABLE_SAMPLES )
+    {
+        int best = 0;
+        for ( int i = 1; i < num_sizes; i++ )
+        {
+            if ( remainder[i] > remainder[best] )
+                best = i;
+        }
+        slots[best]++;
+        remainder[best] = -1.0;
+        used_slots++;
+    }
+
+    int index = 0;
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        for ( int j = 0; j < slots[i]; j++ )
+        {
+            size_table[index++] = i;
+        }
+    }
+
+    uint64_t state = flow_seed;
+    for ( int i = SIZE_TABLE_SAMPLES - 1; i > 0; i-- )
+    {
+        const int j = random_next( &state ) % ( i + 1 );
+        const uint8_t temp = size_table[i];
+        size_table[i] = size_table[j];
+        size_table[j] = temp;
+    }
+}
+
+double size_average_frame_bytes()
+{
+    double total_bytes = 0.0;
+    uint64_t total_weight = 0;
+    for ( int i = 0; i < num_sizes; i++ )
+    {
+        total_bytes += (double) packet_size[i].frame_bytes * packet_size[i].weight;
+        total_weight += packet_size[i].weight;
+    }
+    return total_bytes / total_weight;
+}
+
+static bool parse_port_range( const char * string, struct flow_range_t * range )
+{
+    // n or n-m
+
+    int first, last;
+
+    int count = sscanf( string, "%d-%d", &first, &last );
+    if ( count < 1 )
+        return false;
+
+    if ( count == 1 )
+        last = first;
+
+    if ( first < 0 || last > 65535 || first > last )
+        return false;
+
+    range->first = first;
+    range->last = last;
+
+    return true;
+}
+
+static bool parse_hex_key( const char * string, uint8_t * key, int max_bytes, int * key_bytes )
+{
+    // hex bytes, with or without colons, like 'ethtool -x' prints them
+
+    int bytes = 0;
+
+    while ( *string )
+    {
+        if ( *string == ':' || isspace( *string ) )
+        {
+            string++;
+            continue;
+        }
+
+        unsigned int value;
+        if ( bytes == max_bytes || !isxdigit( string[0] ) || sscanf( string, "%2x", &value ) != 1 )
+            return false;
+
+        key[bytes++] = value;
+        string += isxdigit( string[1] ) ? 2 : 1;
+    }
+
+    *key_bytes = bytes;
+
+    return true;
+}
+
+static bool parse_rss_key( const char * string, uint8_t * key, int * key_bytes )
+{
+    return parse_hex_key( string, key, RSS_MAX_KEY_BYTES, key_bytes ) && *key_bytes >= 4;
+}
+
+static bool parse_rss_ethtool( const char * filename )
+{
+    // the output of 'ethtool -x <interface>' on the server. indirection table rows look like "  8:  0  1  2 ...", then the key follows "RSS hash key:"
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+    {
+        printf( "\nerror: could not open '%s'\n", filename );
+        return false;
+    }
+
+    bool key_next = false;
+    bool key_done = false;
+    char line[1024];
+
+    while ( fgets( line, sizeof(line), file ) )
+    {
+        if ( key_next )
+        {
+            key_next = false;
+            key_done = parse_rss_key( line, rss_key, &rss_key_bytes );
+            continue;
+        }
+
+        if ( strstr( line, "RSS hash key" ) )
+        {
+            key_next = true;
+            continue;
+        }
+
+        int row, offset;
+        if ( key_done || sscanf( line, " %d:%n", &row, &offset ) != 1 || row != rss_indirection_size )
+            continue;
+
+        char * p = line + offset;
+        int queue, consumed;
+        while ( rss_indirection_size < RSS_MAX_INDIRECTION && sscanf( p, "%d%n", &queue, &consumed ) == 1 )
+        {
+            rss_indirection[rss_indirection_size++] = queue;
+            p += consumed;
+        }
+    }
+
+    fclose( file );
+
+    if ( !key_done || rss_indirection_size == 0 )
+    {
+        printf( "\nerror: could not find the rss key and indirection table in '%s'\n", filename );
+        return false;
+    }
+
+    return true;
+}
+
+static int threads_for_queues( int queues )
+{
+    if ( !thread_per_socket )
+        return num_threads;
+
+    int threads = num_interfaces * queues;
+    if ( threads > MAX_THREADS )
+        threads = MAX_THREADS;
+    return threads;
+}
+
+static int read_config( const char * filename, int * queues, int * threads )
+{
+    // one "name value" per line, with the same names as the command line options. only settings that can change while we're running are allowed
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+    {
+        printf( "\nerror: could not open config file '%s'\n\n", filename );
+        return 1;
+    }
+
+    int new_queues = *queues;
+    int new_threads = thread_per_socket ? 0 : *threads;
+    int new_send_batch_size = send_batch_size;
+    int new_payload_bytes = payload_bytes;
+    int new_kick_every = kick_every;
+    int new_kick_threshold = kick_threshold;
+    int new_idle_spin_iterations = idle_spin_iterations;
+    int new_idle_pause_iterations = idle_pause_iterations;
+    int new_idle_poll_timeout = idle_poll_timeout;
+
+    bool error = false;
+    int line_number = 0;
+    char line[256];
+
+    while ( !error && fgets( line, sizeof(line), file ) )
+    {
+        line_number++;
+
+        char * comment = strchr( line, '#' );
+        if ( comment )
+            *comment = '\0';
+
+        char name[64];
+        int value;
+
+        if ( sscanf( line, "%63s", name ) != 1 )
+            continue;
+
+        if ( sscanf( line, "%63s %d", name, &value ) != 2 )
+        {
+            printf( "\nerror: %s:%d: expected a name and a number\n\n", filename, line_number );
+            error = true;
+        }
+        else if ( strcmp( name, "queues" ) == 0 )               new_queues = value;
+        else if ( strcmp( name, "threads" ) == 0 )              new_threads = value;
+        else if ( strcmp( name, "batch-size" ) == 0 )           new_send_batch_size = value;
+        else if ( strcmp( name, "payload-bytes" ) == 0 )        new_payload_bytes = value;
+        else if ( strcmp( name, "kick-every" ) == 0 )           new_kick_every = value;
+        else if ( strcmp( name, "kick-threshold" ) == 0 )       new_kick_threshold = value;
+        else if ( strcmp( name, "idle-spin" ) == 0 )            new_idle_spin_iterations = value;
+        else if ( strcmp( name, "idle-pause" ) == 0 )           new_idle_pause_iterations = value;
+        else if ( strcmp( name, "idle-poll-timeout" ) == 0 )    new_idle_poll_timeout = value;
+        else
+        {
+            printf( "\nerror: %s:%d: unknown setting '%s'\n\n", filename, line_number, name );
+            error = true;
+        }
+    }
+
+    fclose( file );
+
+    if ( error )
+        return 1;
+
+    // check everything before changing anything, so a bad file leaves the old settings in place
+
+    if ( new_queues < 1 || new_queues > MAX_QUEUES || new_threads < 0 || new_threads > MAX_THREADS ||
+         new_send_batch_size < 1 || new_send_batch_size > MAX_SEND_BATCH_SIZE || new_payload_bytes < min_payload_bytes() || new_payload_bytes > max_payload_bytes() ||
+         new_kick_every < 1 || new_kick_threshold < 0 || new_kick_threshold > XSK_RING_PROD__DEFAULT_NUM_DESCS ||
+         new_idle_spin_iterations < 0 || new_idle_pause_iterations < 0 || new_idle_poll_timeout < 0 )
+    {
+        printf( "\nerror: %s has invalid settings, keeping the old ones\n\n", filename );
+        return 1;
+    }
+
+    send_batch_size = new_send_batch_size;
+    payload_bytes = new_payload_bytes;
+    kick_every = new_kick_every;
+    kick_threshold = new_kick_threshold;
+    idle_spin_iterations = new_idle_spin_iterations;
+    idle_pause_iterations = new_idle_pause_iterations;
+    idle_poll_timeout = new_idle_poll_timeout;
+
+    thread_per_socket = new_threads == 0;
+
+    *queues = new_queues;
+    *threads = new_threads ? new_threads : threads_for_queues( new_queues );
+
+    return 0;
+}
+
+static int client_get_channels()
+{
+    // the smallest channel count across our interfaces, or 0 if we can't tell
+
+    int channels = 0;
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        int interface_channels = get_interface_channels( interface_names[i] );
+        if ( interface_channels <= 0 )
+            return 0;
+        if ( channels == 0 || interface_channels < channels )
+            channels = interface_channels;
+    }
+
+    return channels;
+}
+
+static void print_usage()
+{
+    printf( "\nusage: client [options]\n\n" );
+    printf( "    --backend <xdp|sendmmsg|gso|packet|all>            how packets are sent. all runs each one in turn (default: xdp)\n" );
+    printf( "    --duration <seconds>                               how long to run each backend for (default: until CTRL-C, or 10 with --backend all)\n" );
+    printf( "    --mode <always-kick|need-wakeup|poll|busy-poll|io-uring>\n" );
+    printf( "                                                       how the driver is kicked to send packets (default: need-wakeup)\n" );
+    printf( "    --kick-every <n>                                   kick at most once every n batches (default: 1)\n" );
+    printf( "    --kick-threshold <n>                               kick once n descriptors are outstanding in the send queue (default: off)\n" );
+    printf( "    --busy-poll-usecs <n>                              SO_BUSY_POLL value in busy-poll mode (default: 20)\n" );
+    printf( "    --busy-poll-budget <n>                             SO_BUSY_POLL_BUDGET value in busy-poll mode (default: 64)\n" );
+    printf( "    --uring-sq-idle <ms>                               how long the io_uring SQPOLL thread spins before sleeping (default: 1000)\n" );
+    printf( "    --uring-sq-cpu <cpu>                               pin io_uring SQPOLL threads to this cpu (default: not pinned)\n" );
+    printf( "    --compare <seconds>                                alternate between need-wakeup and io-uring every n seconds, then print a summary\n" );
+    printf( "    --interfaces <name,...>                            network interfaces to send on (default: %s)\n", INTERFACE_NAME );
+    printf( "    --queues <n>                                       number of nic queues to send on per interface, starting at queue 0 (default: 4)\n" );
+    printf( "    --threads <n>                                      number of socket threads driving those queues (default: one per socket)\n" );
+    printf( "    --assign <socket:thread,...>                       which thread drives each socket. socket n is queue n %% queues on interface n / queues (default: socket %% threads)\n" );
+    printf( "    --cpus <cpu,...>                                   which cpu each thread is pinned to (default: next free cpu on the numa node of its first interface)\n" );
+    printf( "    --idle <spin|adaptive>                             what socket threads do when there is nothing to send (default: adaptive)\n" );
+    printf( "    --idle-spin <n>                                    empty iterations to spin before pausing (default: 1024)\n" );
+    printf( "    --idle-pause <n>                                   empty iterations to pause before blocking in poll (default: 1024)\n" );
+    printf( "    --idle-poll-timeout <ms>                           longest time to block in poll (default: 1)\n" );
+    printf( "    --batch-size <n>                                   packets per batch, up to %d (default: 256)\n", MAX_SEND_BATCH_SIZE );
+    printf( "    --payload-bytes <n>                                udp payload bytes per packet, up to %d, or %d with ipv6 (default: 32)\n", MAX_PAYLOAD_BYTES, MAX_PAYLOAD_BYTES - 20 );
+    printf( "    --config <file>                                    read settings from this file at startup, and again on SIGHUP\n" );
+    printf( "    --follow-channels                                  add or remove sockets when the channel count on the nic changes\n" );
+    printf( "    --rate <packets/sec>                               total send rate across all sockets (default: as fast as possible)\n" );
+    printf( "    --flows <n>                                        number of distinct flows to send, up to %d (default: 256)\n", MAX_FLOWS );
+    printf( "    --flow-distribution <sequential|random|zipf|fixed> how packets pick a flow (default: sequential)\n" );
+    printf( "    --zipf-s <s>                                       zipf exponent (default: 1.0)\n" );
+    printf( "    --packets-per-flow <n>                             packets in a row per flow with the fixed distribution (default: 64)\n" );
+    printf( "    --seed <n>                                         seed for the random and zipf distributions (default: 1)\n" );
+    printf( "    --ipv6                                             send ipv6/udp. only the xdp and packet backends support it\n" );
+    printf( "    --src-ips <a.b.c.d[-e.f.g.h]>                      source address range, ipv6 ranges can only vary the low 32 bits (default: 192.168.0.0-192.168.255.255, fd00::c0a8:0-fd00::c0a8:ffff)\n" );
+    printf( "    --dst-ips <a.b.c.d[-e.f.g.h]>                      destination address range (default: the server address, fd00::c0a8:b77c with ipv6)\n" );
+    printf( "    --vlan-ids <n[-m]>                                 add an 802.1Q tag, with flows spread over these vlan ids (default: untagged)\n" );
+    printf( "    --outer-vlan-ids <n[-m]>                           qinq: add an 802.1ad service tag outside the 802.1Q tag, with these vlan ids\n" );
+    printf( "    --profile <udp|tcp-syn|icmp|dns>                   what kind of packet to send (default: udp)\n" );
+    printf( "    --dns-domain <name>                                dns queries are for a random label under this domain (default: example.com)\n" );
+    printf( "    --encap <none|vxlan|gre|gue>                       wrap each packet in a tunnel (default: none)\n" );
+    printf( "    --outer-src-ip <a.b.c.d>                           outer source address with a tunnel (default: 192.168.0.1)\n" );
+    printf( "    --outer-dst-ip <a.b.c.d>                           outer destination address with a tunnel (default: the server address)\n" );
+    printf( "    --outer-src-ports <n[-m]>                          outer source ports for vxlan and gue, picked by a hash of the inner tuple (default: 49152-65535)\n" );
+    printf( "    --outer-dst-port <n>                               outer destination port for vxlan and gue (default: %d for vxlan, %d for gue)\n", VXLAN_PORT, GUE_PORT );
+    printf( "    --tunnel-id <n>                                    vxlan network identifier or gre key (default: 1)\n" );
+    printf( "    --src-ports <n[-m]>                                source port range (default: %d)\n", CLIENT_PORT );
+    printf( "    --dst-ports <n[-m]>                                destination port range (default: %d, or 53 with the dns profile)\n", SERVER_PORT );
+    printf( "    --rss-key <xx:xx:...>                              the server nic's rss key, so we can predict which queue each flow lands on\n" );
+    printf( "    --rss-ethtool <file>                               read the rss key and indirection table from saved 'ethtool -x' output\n" );
+    printf( "    --rss-indirection <q,q,...>                        the server nic's indirection table (default: hash %% rss queues)\n" );
+    printf( "    --rss-queues <n>                                   server queues to spread flows over (default: all queues in the indirection table)\n" );
+    printf( "    --rss-fields <addresses|addresses-ports>           what the server nic hashes for udp (default: addresses-ports)\n" );
+    printf( "    --rss-weights <w,w,...>                            share of flows for each server queue (default: equal)\n" );
+    printf( "    --payload-mode <ramp|random|random-tail>           payload contents. random is different for every packet (default: ramp)\n" );
+    printf( "    --random-tail-bytes <n>                            random bytes at the end of the payload with random-tail (default: 16)\n" );
+    printf( "    --crc                                              end each udp payload with a crc32c of the rest of it, for server --verify-crc\n" );
+    printf( "    --benchmark-crc                                    print how fast each crc32c implementation this cpu has runs, then exit\n" );
+    printf( "    --udp-checksum                                     fill in udp checksums over ipv4 too, instead of sending zero. ipv6 always has them\n" );
+    printf( "    --unaligned-umem                                   pack frames back to back in cache line slots of an unaligned umem. xdp backend only\n" );
+    printf( "    --working-set <unbounded|auto|n>                   cap the frames each socket has in flight, and print umem touched and llc misses (default: unbounded)\n" );
+    printf( "    --aead <none|aes-128-gcm|aes-256-gcm|chacha20-poly1305>\n" );
+    printf( "                                                       encrypt each udp payload, for server --aead (default: none)\n" );
+    printf( "    --aead-key <hex>                                   key for --aead, 16 bytes for aes-128-gcm, otherwise 32 (default: 00 01 02 ...)\n" );
+    printf( "    --sizes <imix|size:weight,...>                     frame sizes with the fcs, and how often to send each, instead of --payload-bytes\n" );
+    printf( "    --sizes-file <file>                                frame size histogram, one 'size count' or 'first-last count' per line\n" );
+    printf( "    --destinations <file>                              send to the destinations in this file, one 'mac address port [weight]' per line, instead of the server\n" );
+    printf( "    --destination-schedule <weighted|round-robin>      how packets are spread over the destinations (default: weighted)\n" );
+    printf( "    --daemon <path>                                    set up, then wait for commands on this unix socket instead of sending right away\n" );
+    printf( "\n" );
+}
+
+static int parse_options( int argc, char * argv[] )
+{
+    static struct option long_options[] =
+    {
+        { "backend",            required_argument, NULL, 'B' },
+        { "duration",           required_argument, NULL, 'D' },
+        { "mode",               required_argument, NULL, 'm' },
+        { "kick-every",         required_argument, NULL, 'k' },
+        { "kick-threshold",     required_argument, NULL, 't' },
+        { "busy-poll-usecs",    required_argument, NULL, 'u' },
+        { "busy-poll-budget",   required_argument, NULL, 'b' },
+        { "uring-sq-idle",      required_argument, NULL, 'S' },
+        { "uring-sq-cpu",       required_argument, NULL, 'U' },
+        { "compare",            required_argument, NULL, 'C' },
+        { "interfaces",         required_argument, NULL, 'I' },
+        { "queues",             required_argument, NULL, 'q' },
+        { "threads",            required_argument, NULL, 'n' },
+        { "assign",             required_argument, NULL, 'a' },
+        { "cpus",               required_argument, NULL, 'c' },
+        { "idle",               required_argument, NULL, 'i' },
+        { "idle-spin",          required_argument, NULL, 's' },
+        { "idle-pause",         required_argument, NULL, 'p' },
+        { "idle-poll-timeout",  required_argument, NULL, 'o' },
+        { "batch-size",         required_argument, NULL, 'z' },
+        { "payload-bytes",      required_argument, NULL, 'P' },
+        { "config",             required_argument, NULL, 'F' },
+        { "follow-channels",    no_argument,       NULL, 'f' },
+        { "rate",               required_argument, NULL, 'r' },
+        { "flows",              required_argument, NULL, 'w' },
+        { "flow-distribution",  required_argument, NULL, 'W' },
+        { "zipf-s",             required_argument, NULL, 'Z' },
+        { "packets-per-flow",   required_argument, NULL, 'K' },
+        { "seed",               required_argument, NULL, 'E' },
+        { "ipv6",               no_argument,       NULL, OPTION_IPV6 },
+        { "src-ips",            required_argument, NULL, 'x' },
+        { "dst-ips",            required_argument, NULL, 'X' },
+        { "vlan-ids",           required_argument, NULL, 'v' },
+        { "outer-vlan-ids",     required_argument, NULL, 'V' },
+        { "profile",            required_argument, NULL, 'g' },
+        { "dns-domain",         required_argument, NULL, 'O' },
+        { "encap",              required_argument, NULL, 'e' },
+        { "outer-src-ip",       required_argument, NULL, 'j' },
+        { "outer-dst-ip",       required_argument, NULL, 'J' },
+        { "outer-src-ports",    required_argument, NULL, 'l' },
+        { "outer-dst-port",     required_argument, NULL, 'L' },
+        { "tunnel-id",          required_argument, NULL, 'M' },
+        { "src-ports",          required_argument, NULL, 'y' },
+        { "dst-ports",          required_argument, NULL, 'Y' },
+        { "rss-key",            required_argument, NULL, 'R' },
+        { "rss-ethtool",        required_argument, NULL, 'T' },
+        { "rss-indirection",    required_argument, NULL, 'N' },
+        { "rss-queues",         required_argument, NULL, 'Q' },
+        { "rss-fields",         required_argument, NULL, 'H' },
+        { "rss-weights",        required_argument, NULL, 'G' },
+        { "destinations",       required_argument, NULL, 'A' },
+        { "payload-mode",       required_argument, NULL, OPTION_PAYLOAD_MODE },
+        { "random-tail-bytes",  required_argument, NULL, OPTION_RANDOM_TAIL_BYTES },
+        { "crc",                no_argument,       NULL, OPTION_CRC },
+        { "benchmark-crc",      no_argument,       NULL, OPTION_BENCHMARK_CRC },
+        { "aead",               required_argument, NULL, OPTION_AEAD },
+        { "aead-key",           required_argument, NULL, OPTION_AEAD_KEY },
+        { "udp-checksum",       no_argument,       NULL, OPTION_UDP_CHECKSUM },
+        { "unaligned-umem",     no_argument,       NULL, OPTION_UNALIGNED_UMEM },
+        { "working-set",        required_argument, NULL, OPTION_WORKING_SET },
+        { "sizes",              required_argument, NULL, OPTION_SIZES },
+        { "sizes-file",         required_argument, NULL, OPTION_SIZES_FILE },
+        { "destination-schedule", required_argument, NULL, OPTION_DESTINATION_SCHEDULE },
+        { "daemon",             required_argument, NULL, 'd' },
+        { "help",               no_argument,       NULL, 'h' },
+        { NULL,                 0,                 NULL, 0   }
+    };
+
+    interface_names[0] = INTERFACE_NAME;
+
+    flow_source_addresses.first = 0xc0a80000;           // 192.168.0.0
+    flow_source_addresses.last = 0xc0a8ffff;            // 192.168.255.255
+    flow_destination_addresses.first = SERVER_IPV4_ADDRESS;
+    flow_destination_addresses.last = SERVER_IPV4_ADDRESS;
+    memcpy( flow_source_prefix, SERVER_IPV6_PREFIX, 12 );
+    memcpy( flow_destination_prefix, SERVER_IPV6_PREFIX, 12 );
+    flow_source_ports.first = CLIENT_PORT;
+    flow_source_ports.last = CLIENT_PORT;
+    flow_destination_ports.first = SERVER_PORT;
+    flow_destination_ports.last = SERVER_PORT;
+    flow_vlan_ids.first = 1;
+    flow_vlan_ids.last = 1;
+    flow_outer_vlan_ids.first = 1;
+    flow_outer_vlan_ids.last = 1;
+
+    for ( int i = 0; i < MAX_SOCKETS; i++ )
+    {
+        socket_thread_index[i] = -1;
+    }
+
+    for ( int i = 0; i < MAX_THREADS; i++ )
+    {
+        thread_cpu[i] = -1;
+    }
+
+    const char * source_addresses = NULL;     // parsed after the loop, once we know if it's ipv6
+    const char * destination_addresses = NULL;
+
+    bool destination_ports = false;
+    bool inner_vlan_ids = false;
+    bool outer_vlan_ids = false;
+
+    int c;
+    while ( ( c = getopt_long( argc, argv, "h", long_options, NULL ) ) != -1 )
+    {
+        switch ( c )
+        {
+            case 'I':
+            {
+                num_interfaces = 0;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token; token = strtok_r( NULL, ",", &save ) )
+                {
+                    if ( num_interfaces == MAX_INTERFACES )
+                    {
+                        printf( "\nerror: too many interfaces. max is %d\n", MAX_INTERFACES );
+                        return 1;
+                    }
+                    interface_names[num_interfaces++] = token;
+                }
+            }
+            break;
+
+            case 'B':
+            {
+                backend = -1;
+                run_all_backends = strcmp( optarg, "all" ) == 0;
+                for ( int i = 0; i < BACKEND_NUM_BACKENDS; i++ )
+                {
+                    if ( run_all_backends || strcmp( optarg, backends[i].name ) == 0 )
+                    {
+                        backend = i;
+                        break;
+                    }
+                }
+                if ( backend < 0 )
+                {
+                    printf( "\nerror: unknown backend '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'D': duration_seconds = atoi( optarg ); break;
+            case 'S': uring_sq_idle = atoi( optarg ); break;
+            case 'U': uring_sq_cpu = atoi( optarg ); break;
+            case 'C': compare_seconds = atoi( optarg ); break;
+            case 'q': num_queues = atoi( optarg ); break;
+            case 'n': num_threads = atoi( optarg ); break;
+
+            case 'a':
+            {
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token; token = strtok_r( NULL, ",", &save ) )
+                {
+                    int socket, thread;
+                    if ( sscanf( token, "%d:%d", &socket, &thread ) != 2 || socket < 0 || socket >= MAX_SOCKETS || thread < 0 || thread >= MAX_THREADS )
+                    {
+                        printf( "\nerror: invalid socket assignment '%s'\n", token );
+                        print_usage();
+                        return 1;
+                    }
+                    socket_thread_index[socket] = thread;
+                }
+            }
+            break;
+
+            case 'c':
+            {
+                int thread = 0;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token && thread < MAX_THREADS; token = strtok_r( NULL, ",", &save ) )
+                {
+                    thread_cpu[thread++] = atoi( token );
+                }
+            }
+            break;
+
+            case 'm':
+            {
+                drive_mode = -1;
+                for ( int i = 0; i < DRIVE_MODE_NUM_MODES; i++ )
+                {
+                    if ( strcmp( optarg, drive_mode_names[i] ) == 0 )
+                    {
+                        drive_mode = i;
+                        break;
+                    }
+                }
+                if ( drive_mode < 0 )
+                {
+                    printf( "\nerror: unknown drive mode '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'i':
+            {
+                idle_strategy = -1;
+                for ( int i = 0; i < IDLE_STRATEGY_NUM_STRATEGIES; i++ )
+                {
+                    if ( strcmp( optarg, idle_strategy_names[i] ) == 0 )
+                    {
+                        idle_strategy = i;
+                        break;
+                    }
+                }
+                if ( idle_strategy < 0 )
+                {
+                    printf( "\nerror: unknown idle strategy '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 's': idle_spin_iterations = atoi( optarg ); break;
+            case 'p': idle_pause_iterations = atoi( optarg ); break;
+            case 'o': idle_poll_timeout = atoi( optarg ); break;
+            case 'k': kick_every = atoi( optarg ); break;
+            case 't': kick_threshold = atoi( optarg ); break;
+            case 'u': busy_poll_usecs = atoi( optarg ); break;
+            case 'b': busy_poll_budget = atoi( optarg ); break;
+            case 'z': send_batch_size = atoi( optarg ); break;
+            case 'P': payload_bytes = atoi( optarg ); break;
+            case 'F': config_filename = optarg; break;
+            case 'f': follow_channels = true; break;
+            case 'r': send_rate = strtoull( optarg, NULL, 10 ); break;
+            case 'w': num_flows = atoi( optarg ); break;
+            case 'Z': flow_zipf_s = atof( optarg ); break;
+            case 'K': flow_packets_per_flow = atoi( optarg ); break;
+            case 'E': flow_seed = strtoull( optarg, NULL, 0 ); break;
+
+            case 'W':
+            {
+                flow_distribution = -1;
+                for ( int i = 0; i < FLOW_DISTRIBUTION_NUM_DISTRIBUTIONS; i++ )
+                {
+                    if ( strcmp( optarg, flow_distribution_names[i] ) == 0 )
+                    {
+                        flow_distribution = i;
+                        break;
+                    }
+                }
+                if ( flow_distribution < 0 )
+                {
+                    printf( "\nerror: unknown flow distribution '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'R':
+            {
+                if ( !parse_rss_key( optarg, rss_key, &rss_key_bytes ) )
+                {
+                    printf( "\nerror: invalid rss key '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'T':
+            {
+                if ( !parse_rss_ethtool( optarg ) )
+                {
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'N':
+            {
+                rss_indirection_size = 0;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token && rss_indirection_size < RSS_MAX_INDIRECTION; token = strtok_r( NULL, ",", &save ) )
+                {
+                    rss_indirection[rss_indirection_size++] = atoi( token );
+                }
+            }
+            break;
+
+            case 'G':
+            {
+                num_rss_weights = 0;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token && num_rss_weights < RSS_MAX_QUEUES; token = strtok_r( NULL, ",", &save ) )
+                {
+                    rss_weight[num_rss_weights++] = atof( token );
+                }
+            }
+            break;
+
+            case 'Q': rss_queues = atoi( optarg ); break;
+
+            case 'H':
+            {
+                if ( strcmp( optarg, "addresses" ) == 0 )
+                    rss_hash_ports = false;
+                else if ( strcmp( optarg, "addresses-ports" ) == 0 )
+                    rss_hash_ports = true;
+                else
+                {
+                    printf( "\nerror: unknown rss fields '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case OPTION_IPV6: ipv6 = true; break;
+
+            case 'g':
+            {
+                int i;
+                for ( i = 0; i < PROFILE_NUM_PROFILES; i++ )
+                {
+                    if ( strcmp( optarg, profile_names[i] ) == 0 )
+                        break;
+                }
+                if ( i == PROFILE_NUM_PROFILES )
+                {
+                    printf( "\nerror: unknown profile '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+                profile = i;
+            }
+            break;
+
+            case 'O': dns_domain = optarg; break;
+
+            case 'e':
+            {
+                int i;
+                for ( i = 0; i < ENCAP_NUM_TYPES; i++ )
+                {
+                    if ( strcmp( optarg, encap_names[i] ) == 0 )
+                        break;
+                }
+                if ( i == ENCAP_NUM_TYPES )
+                {
+                    printf( "\nerror: unknown encapsulation '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+                encap = i;
+            }
+            break;
+
+            case 'j':
+            case 'J':
+            {
+                struct in_addr address;
+                if ( inet_pton( AF_INET, optarg, &address ) != 1 )
+                {
+                    printf( "\nerror: invalid outer address '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+                if ( c == 'j' )
+                    outer_source_address = ntohl( address.s_addr );
+                else
+                    outer_destination_address = ntohl( address.s_addr );
+            }
+            break;
+
+            case 'L': outer_destination_port = atoi( optarg ); break;
+            case 'M': tunnel_id = strtoul( optarg, NULL, 0 ); break;
+
+            case 'x': source_addresses = optarg; break;
+            case 'X': destination_addresses = optarg; break;
+
+            case 'v':
+            case 'V':
+            case 'l':
+            case 'y':
+            case 'Y':
+            {
+                struct flow_range_t * range = ( c == 'v' ) ? &flow_vlan_ids : ( c == 'V' ) ? &flow_outer_vlan_ids : ( c == 'l' ) ? &outer_source_ports : ( c == 'y' ) ? &flow_source_ports : &flow_destination_ports;
+                if ( !parse_port_range( optarg, range ) )
+                {
+                    printf( "\nerror: invalid range '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+                if ( c == 'Y' )
+                    destination_ports = true;
+                if ( c == 'v' )
+                    inner_vlan_ids = true;
+                if ( c == 'V' )
+                    outer_vlan_ids = true;
+            }
+            break;
+            case 'A': destinations_filename = optarg; break;
+            case OPTION_PAYLOAD_MODE:
+            {
+                payload_mode = -1;
+                for ( int i = 0; i < PAYLOAD_MODE_NUM_MODES; i++ )
+                {
+                    if ( strcmp( optarg, payload_mode_names[i] ) == 0 )
+                        payload_mode = i;
+                }
+                if ( payload_mode < 0 )
+                {
+                    printf( "\nerror: unknown payload mode '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case OPTION_RANDOM_TAIL_BYTES: random_tail_bytes = atoi( optarg ); break;
+            case OPTION_CRC: crc_tag = true; break;
+            case OPTION_BENCHMARK_CRC: benchmark_crc = true; break;
+            case OPTION_UDP_CHECKSUM: udp_checksum = true; break;
+            case OPTION_UNALIGNED_UMEM: unaligned_umem = true; break;
+
+            case OPTION_WORKING_SET:
+            {
+                report_working_set = true;
+                if ( strcmp( optarg, "unbounded" ) == 0 )
+                    working_set_frames = WORKING_SET_UNBOUNDED;
+                else if ( strcmp( optarg, "auto" ) == 0 )
+                    working_set_frames = WORKING_SET_AUTO;
+                else
+                {
+                    working_set_frames = atoi( optarg );
+                    if ( working_set_frames < WORKING_SET_MIN_FRAMES || working_set_frames > NUM_FRAMES )
+                    {
+                        printf( "\nerror: working set must be unbounded, auto, or %d to %d frames\n", WORKING_SET_MIN_FRAMES, NUM_FRAMES );
+                        print_usage();
+                        return 1;
+                    }
+                }
+            }
+            break;
+
+            case OPTION_AEAD:
+            {
+                aead = -1;
+                for ( int i = 0; i < AEAD_NUM_TYPES; i++ )
+                {
+                    if ( strcmp( optarg, aead_names[i] ) == 0 )
+                        aead = i;
+                }
+                if ( aead < 0 )
+                {
+                    printf( "\nerror: unknown aead '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case OPTION_AEAD_KEY:
+            {
+                if ( !parse_hex_key( optarg, aead_key, AEAD_MAX_KEY_BYTES, &aead_key_bytes_given ) )
+                {
+                    printf( "\nerror: invalid aead key '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+            case OPTION_SIZES: sizes_spec = optarg; break;
+            case OPTION_SIZES_FILE: sizes_filename = optarg; break;
+
+            case OPTION_DESTINATION_SCHEDULE:
+            {
+                destination_schedule_type = -1;
+                for ( int i = 0; i < DESTINATION_SCHEDULE_NUM_SCHEDULES; i++ )
+                {
+                    if ( strcmp( optarg, destination_schedule_names[i] ) == 0 )
+                        destination_schedule_type = i;
+                }
+                if ( destination_schedule_type < 0 )
+                {
+                    printf( "\nerror: unknown destination schedule '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'd': daemon_socket_path = optarg; paused = true; break;
+
+            default:
+                print_usage();
+                return 1;
+        }
+    }
+
+    if ( ( source_addresses && !parse_address_range( source_addresses, &flow_source_addresses, flow_source_prefix ) ) ||
+         ( destination_addresses && !parse_address_range( destination_addresses, &flow_destination_addresses, flow_destination_prefix ) ) )
+    {
+        printf( "\nerror: invalid %s address range\n", ipv6 ? "ipv6" : "ipv4" );
+        print_usage();
+        return 1;
+    }
+
+    vlan_tags = outer_vlan_ids ? 2 : inner_vlan_ids ? 1 : 0;
+
+    if ( ( outer_vlan_ids && !inner_vlan_ids ) || flow_vlan_ids.first < 1 || flow_vlan_ids.last > 4094 || flow_outer_vlan_ids.first < 1 || flow_outer_vlan_ids.last > 4094 )
+    {
+        printf( "\nerror: invalid vlan ids. they go from 1 to 4094, and --outer-vlan-ids needs --vlan-ids\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( !parse_dns_domain( dns_domain ) )
+    {
+        printf( "\nerror: invalid dns domain '%s'\n", dns_domain );
+        print_usage();
+        return 1;
+    }
+
+    if ( profile == PROFILE_DNS && !destination_ports )
+    {
+        flow_destination_ports.first = 53;
+        flow_destination_ports.last = 53;
+    }
+
+    if ( ( ipv6 || vlan_tags > 0 || encap != ENCAP_NONE || profile != PROFILE_UDP ) && ( run_all_backends || backend == BACKEND_SENDMMSG || backend == BACKEND_GSO ) )
+    {
+        printf( "\nerror: ipv6, vlan tags, tunnels and profiles other than udp need the xdp or packet backend\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( destinations_filename )
+    {
+        if ( read_destinations( destinations_filename ) != 0 )
+            return 1;
+
+        if ( destination_addresses || destination_ports || rss_key_bytes > 0 || run_all_backends || backend == BACKEND_SENDMMSG || backend == BACKEND_GSO )
+        {
+            printf( "\nerror: --destinations needs the xdp or packet backend, and replaces --dst-ips, --dst-ports and rss prediction\n" );
+            print_usage();
+            return 1;
+        }
+
+        if ( !build_destination_schedule() )
+        {
+            printf( "\nerror: destination weights add up to more than %d\n", MAX_DESTINATION_SCHEDULE );
+            print_usage();
+            return 1;
+        }
+    }
+
+    if ( random_tail_bytes < 1 || ( payload_mode != PAYLOAD_MODE_RAMP && ( profile == PROFILE_TCP_SYN || profile == PROFILE_DNS ) ) )
+    {
+        printf( "\nerror: invalid payload mode. random payloads need a profile with a payload, and at least one random byte\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( aead != AEAD_NONE && ( profile != PROFILE_UDP || crc_tag || ( aead_key_bytes_given > 0 && aead_key_bytes_given != aead_key_bytes[aead] ) ) )
+    {
+        printf( "\nerror: --aead encrypts udp payloads, so it needs the udp profile, and a %d byte key. its tag already does what --crc does\n", aead_key_bytes[aead] );
+        print_usage();
+        return 1;
+    }
+
+    if ( crc_tag && profile != PROFILE_UDP )
+    {
+        printf( "\nerror: crc tags go in udp payloads, so they need the udp profile\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( sizes_spec && !parse_sizes( sizes_spec ) )
+    {
+        printf( "\nerror: invalid sizes '%s'. expected imix, or up to %d size:weight pairs\n", sizes_spec, MAX_SIZES );
+        print_usage();
+        return 1;
+    }
+
+    if ( sizes_filename && read_sizes( sizes_filename ) != 0 )
+        return 1;
+
+    if ( num_sizes > 0 && ( ( sizes_spec && sizes_filename ) || profile == PROFILE_TCP_SYN || profile == PROFILE_DNS || run_all_backends || backend == BACKEND_SENDMMSG || backend == BACKEND_GSO ) )
+    {
+        printf( "\nerror: sizes need the xdp or packet backend, and a profile with a payload: udp or icmp\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( ( unaligned_umem || report_working_set ) && ( run_all_backends || backend != BACKEND_XDP ) )
+    {
+        printf( "\nerror: --unaligned-umem and --working-set are for the umem of the xdp backend\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( client_num_templates() > MAX_TEMPLATES )
+    {
+        printf( "\nerror: too many destinations times sizes. max is %d\n", MAX_TEMPLATES );
+        print_usage();
+        return 1;
+    }
+
+    if ( num_sizes > 0 )
+    {
+        build_size_table();
+    }
+
+    if ( outer_destination_port == 0 )
+    {
+        outer_destination_port = ( encap == ENCAP_GUE ) ? GUE_PORT : VXLAN_PORT;
+    }
+
+    if ( outer_destination_port < 1 || outer_destination_port > 65535 || ( encap == ENCAP_VXLAN && tunnel_id > 0xFFFFFF ) )
+    {
+        printf( "\nerror: invalid tunnel options. the outer port goes up to 65535, and a vxlan network identifier is 24 bits\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( kick_every < 1 || kick_threshold < 0 || kick_threshold > XSK_RING_PROD__DEFAULT_NUM_DESCS )
+    {
+        printf( "\nerror: invalid kick policy\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( run_all_backends && duration_seconds == 0 )
+    {
+        duration_seconds = 10;
+    }
+
+    if ( duration_seconds < 0 || ( run_all_backends && compare_seconds > 0 ) )
+    {
+        printf( "\nerror: invalid duration\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( compare_seconds < 0 || uring_sq_idle < 0 )
+    {
+        printf( "\nerror: invalid io_uring options\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( compare_seconds > 0 )
+    {
+        drive_mode = DRIVE_MODE_NEED_WAKEUP;
+    }
+
+    if ( send_batch_size < 1 || send_batch_size > MAX_SEND_BATCH_SIZE || payload_bytes < min_payload_bytes() || payload_bytes > max_payload_bytes() )
+    {
+        printf( "\nerror: invalid batch size or payload bytes\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( num_flows < 1 || num_flows > MAX_FLOWS || num_flows > flow_space_size() )
+    {
+        printf( "\nerror: invalid number of flows. the address and port ranges have %" PRIu64 " distinct tuples\n", flow_space_size() );
+        print_usage();
+        return 1;
+    }
+
+    if ( flow_zipf_s <= 0.0 || flow_packets_per_flow < 1 )
+    {
+        printf( "\nerror: invalid flow distribution parameters\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( rss_key_bytes > 0 )
+    {
+        int max_queue = -1;
+        for ( int i = 0; i < rss_indirection_size; i++ )
+        {
+            if ( rss_indirection[i] > max_queue )
+                max_queue = rss_indirection[i];
+        }
+
+        if ( rss_queues == 0 )
+            rss_queues = max_queue + 1;
+
+        double total_weight = 0.0;
+        bool negative_weight = false;
+        for ( int i = 0; i < num_rss_weights; i++ )
+        {
+            total_weight += rss_weight[i];
+            negative_weight |= rss_weight[i] < 0.0;
+        }
+
+        if ( rss_queues < 1 || rss_queues > RSS_MAX_QUEUES || max_queue >= RSS_MAX_QUEUES || num_rss_weights > rss_queues || negative_weight || ( num_rss_weights == rss_queues && total_weight <= 0.0 ) )
+        {
+            printf( "\nerror: invalid rss options. give --rss-queues or an indirection table, with up to %d queues and a weight per queue\n", RSS_MAX_QUEUES );
+            print_usage();
+            return 1;
+        }
+    }
+
+    if ( daemon_socket_path && ( run_all_backends || compare_seconds > 0 || duration_seconds > 0 ) )
+    {
+        printf( "\nerror: --daemon runs until told to quit, so it can't be combined with --backend all, --compare or --duration\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( num_threads == 0 )
+    {
+        thread_per_socket = true;
+        num_threads = threads_for_queues( num_queues );
+    }
+
+    if ( num_interfaces < 1 || num_queues < 1 || num_queues > MAX_QUEUES || num_threads < 1 || num_threads > MAX_THREADS )
+    {
+        printf( "\nerror: invalid number of queues or threads\n" );
+        print_usage();
+        return 1;
+    }
+
+    for ( int i = 0; i < num_interfaces * num_queues; i++ )
+    {
+        if ( socket_thread_index[i] >= num_threads )
+        {
+            printf( "\nerror: socket %d assigned to thread %d, but there are only %d threads\n", i, socket_thread_index[i], num_threads );
+            print_usage();
+            return 1;
+        }
+    }
+
+    if ( idle_spin_iterations < 0 || idle_pause_iterations < 0 || idle_poll_timeout < 0 )
+    {
+        printf( "\nerror: invalid idle thresholds\n" );
+        print_usage();
+        return 1;
+    }
+
+    return 0;
+}
+
+struct control_t
+{
+    int listen_fd;
+    int fd;                             // the current connection. we only talk to one controller at a time
+    char buffer[1024];
+    int buffer_bytes;
+};
+
+static int control_init( struct control_t * control, const char * path )
+{
+    memset( control, 0, sizeof(struct control_t) );
+    control->fd = -1;
+
+    control->listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+    if ( control->listen_fd < 0 )
+    {
+        printf( "\nerror: could not create control socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof(address) );
+    address.sun_family = AF_UNIX;
+    strncpy( address.sun_path, path, sizeof(address.sun_path) - 1 );
+
+    unlink( path );
+
+    if ( bind( control->listen_fd, (struct sockaddr*) &address, sizeof(address) ) || listen( control->listen_fd, 4 ) )
+    {
+        printf( "\nerror: could not listen on control socket '%s': %s\n\n", path, strerror(errno) );
+        return 1;
+    }
+
+    return 0;
+}
+
+static void control_shutdown( struct control_t * control, const char * path )
+{
+    if ( control->fd >= 0 )
+        close( control->fd );
+
+    if ( control->listen_fd > 0 )
+    {
+        close( control->listen_fd );
+        unlink( path );
+    }
+}
+
+static void control_update( struct control_t * control, int timeout, void ( *command )( char * line, char * reply, int reply_bytes ) )
+{
+    // wait up to timeout milliseconds for a connection or a command. commands are one per line, and every command gets a one line reply
+
+    struct pollfd fds[2];
+    fds[0].fd = control->listen_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = control->fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if ( poll( fds, control->fd >= 0 ? 2 : 1, timeout ) <= 0 )
+        return;
+
+    if ( fds[0].revents & POLLIN )
+    {
+        int fd = accept( control->listen_fd, NULL, NULL );
+        if ( fd >= 0 )
+        {
+            if ( control->fd >= 0 )
+                close( control->fd );
+            control->fd = fd;
+            control->buffer_bytes = 0;
+            return;
+        }
+    }
+
+    if ( control->fd < 0 || ( fds[1].revents & ( POLLIN | POLLHUP | POLLERR ) ) == 0 )
+        return;
+
+    int bytes = read( control->fd, control->buffer + control->buffer_bytes, sizeof(control->buffer) - 1 - control->buffer_bytes );
+    if ( bytes <= 0 )
+    {
+        close( control->fd );
+        control->fd = -1;
+        return;
+    }
+
+    control->buffer_bytes += bytes;
+    control->buffer[control->buffer_bytes] = '\0';
+
+    char * line = control->buffer;
+    char * end;
+
+    while ( ( end = strchr( line, '\n' ) ) != NULL )
+    {
+        *end = '\0';
+
+        char reply[1024];
+        command( line, reply, sizeof(reply) - 1 );
+        strcat( reply, "\n" );
+
+        if ( write( control->fd, reply, strlen( reply ) ) < 0 )
+        {
+            close( control->fd );
+            control->fd = -1;
+            return;
+        }
+
+        line = end + 1;
+    }
+
+    // keep any partial line for next time. a line that fills the whole buffer is dropped
+
+    control->buffer_bytes = strlen( line );
+    if ( control->buffer_bytes == sizeof(control->buffer) - 1 )
+        control->buffer_bytes = 0;
+    memmove( control->buffer, line, control->buffer_bytes );
+}
+
+static void client_control_command( char * line, char * reply, int reply_bytes )
+{
+    char name[64];
+    long long value = 0;
+
+    int count = sscanf( line, "%63s %lld", name, &value );
+
+    if ( count < 1 )
+    {
+        snprintf( reply, reply_bytes, "error: empty command" );
+        return;
+    }
+
+    if ( strcmp( name, "start" ) == 0 )
+    {
+        paused = false;
+    }
+    else if ( strcmp( name, "stop" ) == 0 )
+    {
+        paused = true;
+    }
+    else if ( strcmp( name, "stats" ) == 0 )
+    {
+        snprintf( reply, reply_bytes, "running %d queues %d threads %d batch-size %d payload-bytes %d rate %" PRIu64 " flows %d sent %" PRIu64 " sent-delta %" PRIu64 " cpu %.1f ksoftirqd-cpu %.1f",
+            !paused, num_queues, num_threads, send_batch_size, payload_bytes, send_rate, num_flows, client.previous_sent_packets, client.last_sent_delta, client.last_cpu, client.last_ksoftirqd_cpu );
+        return;
+    }
+    else if ( strcmp( name, "reload" ) == 0 && config_filename )
+    {
+        reload_config = true;
+    }
+    else if ( strcmp( name, "quit" ) == 0 )
+    {
+        quit = true;
+    }
+    else if ( count < 2 )
+    {
+        snprintf( reply, reply_bytes, "error: unknown command '%s'", name );
+        return;
+    }
+    else if ( strcmp( name, "rate" ) == 0 && value >= 0 )
+    {
+        send_rate = value;
+    }
+    else if ( strcmp( name, "flows" ) == 0 && value >= 1 && value <= MAX_FLOWS && value <= flow_space_size() )
+    {
+        const int result = client_set_flows( &client, value );
+        if ( result < 0 )
+            quit = true;
+        if ( result > 0 )
+        {
+            snprintf( reply, reply_bytes, "error: could not set up %d flows, still sending %d", (int) value, num_flows );
+            return;
+        }
+    }
+    else if ( strcmp( name, "payload-bytes" ) == 0 && value >= min_payload_bytes() && value <= max_payload_bytes() )
+    {
+        payload_bytes = value;
+    }
+    else if ( strcmp( name, "batch-size" ) == 0 && value >= 1 && value <= MAX_SEND_BATCH_SIZE )
+    {
+        send_batch_size = value;
+    }
+    else if ( strcmp( name, "queues" ) == 0 && value >= 1 && value <= MAX_QUEUES )
+    {
+        if ( client_reconfigure( &client, value, threads_for_queues( value ) ) != 0 )
+            quit = true;
+    }
+    else if ( strcmp( name, "threads" ) == 0 && value >= 1 && value <= MAX_THREADS )
+    {
+        thread_per_socket = false;
+        if ( client_reconfigure( &client, num_queues, value ) != 0 )
+            quit = true;
+    }
+    else
+    {
+        snprintf( reply, reply_bytes, "error: bad command '%s'", line );
+        return;
+    }
+
+    snprintf( reply, reply_bytes, "ok" );
+}
+
+struct backend_result_t
+{
+    bool valid;
+    double packets_per_second;
+    double cpu;
+    double ksoftirqd_cpu;
+};
+
+void crc32c_benchmark()
+{
+    // bytes per tsc cycle for each implementation this cpu has, over payload sized buffers that stay in l1
+
+    struct crc32c_implementation_t
+    {
+        const char * name;
+        uint32_t ( *update )( uint32_t crc, const void * data, int bytes );
+        bool supported;
+    };
+
+    const struct crc32c_implementation_t implementations[] =
+    {
+        { "scalar",          crc32c_update_scalar, true },
+        { "sse4.2",          crc32c_update_sse42,  __builtin_cpu_supports( "sse4.2" ) },
+        { "sse4.2 + pclmul", crc32c_update_pclmul, __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "pclmul" ) },
+    };
+
+    const int sizes[] = { 64, 256, 512, 1472, 4096 };
+
+    const int num_implementations = sizeof(implementations) / sizeof(implementations[0]);
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    uint8_t buffer[4096];
+    for ( int i = 0; i < (int) sizeof(buffer); i++ )
+    {
+        buffer[i] = i * 7;
+    }
+
+    printf( "crc32c bytes per cycle:\n" );
+
+    printf( "%16s", "" );
+    for ( int j = 0; j < num_sizes; j++ )
+    {
+        printf( "%10d", sizes[j] );
+    }
+    printf( "\n" );
+
+    for ( int i = 0; i < num_implementations; i++ )
+    {
+        if ( !implementations[i].supported )
+            continue;
+
+        printf( "%16s", implementations[i].name );
+
+        for ( int j = 0; j < num_sizes; j++ )
+        {
+            const int iterations = ( 64 * 1024 * 1024 ) / sizes[j];
+
+            // feed each crc into the next, so the calls can't overlap or be optimized away
+
+            uint32_t crc = ~0U;
+            const uint64_t start = __rdtsc();
+            for ( int k = 0; k < iterations; k++ )
+            {
+                crc = implementations[i].update( crc, buffer, sizes[j] );
+            }
+            const uint64_t cycles = __rdtsc() - start;
+
+            buffer[0] ^= crc;
+
+            printf( "%10.2f", (double) iterations * sizes[j] / cycles );
+        }
+
+        printf( "\n" );
+    }
+}
+
+int main( int argc, char * argv[] )
+{
+    printf( "\n[client]\n" );
+
+    if ( parse_options( argc, argv ) != 0 )
+    {
+        return 1;
+    }
+
+    const char * crc32c_name = crc32c_init();
+
+    if ( benchmark_crc )
+    {
+        crc32c_benchmark();
+        return 0;
+    }
+
+    if ( config_filename && read_config( config_filename, &num_queues, &num_threads ) != 0 )
+    {
+        return 1;
+    }
+
+    printf( "backend: %s\n", run_all_backends ? "all" : backends[backend].name );
+
+    if ( compare_seconds > 0 )
+        printf( "comparing need-wakeup and io-uring drive modes, switching every %d seconds\n", compare_seconds );
+    else if ( kick_threshold > 0 )
+        printf( "drive mode: %s, kick when %d descriptors outstanding\n", drive_mode_names[drive_mode], kick_threshold );
+    else
+        printf( "drive mode: %s, kick every %d batches\n", drive_mode_names[drive_mode], kick_every );
+
+    printf( "idle strategy: %s\n", idle_strategy_names[idle_strategy] );
+
+    printf( "%d %s %s flows, %s distribution, out of %" PRIu64 " possible tuples\n", num_flows, ipv6 ? "ipv6" : "ipv4", profile_names[profile], flow_distribution_names[flow_distribution], flow_space_size() );
+
+    if ( encap == ENCAP_GRE )
+        printf( "gre encapsulated, key %u, outer %d.%d.%d.%d -> %d.%d.%d.%d\n", tunnel_id,
+            outer_source_address >> 24, ( outer_source_address >> 16 ) & 0xFF, ( outer_source_address >> 8 ) & 0xFF, outer_source_address & 0xFF,
+            outer_destination_address >> 24, ( outer_destination_address >> 16 ) & 0xFF, ( outer_destination_address >> 8 ) & 0xFF, outer_destination_address & 0xFF );
+    else if ( encap != ENCAP_NONE )
+        printf( "%s encapsulated, outer %d.%d.%d.%d:%d-%d -> %d.%d.%d.%d:%d\n", encap_names[encap],
+            outer_source_address >> 24, ( outer_source_address >> 16 ) & 0xFF, ( outer_source_address >> 8 ) & 0xFF, outer_source_address & 0xFF, outer_source_ports.first, outer_source_ports.last,
+            outer_destination_address >> 24, ( outer_destination_address >> 16 ) & 0xFF, ( outer_destination_address >> 8 ) & 0xFF, outer_destination_address & 0xFF, outer_destination_port );
+
+    if ( vlan_tags == 2 )
+        printf( "qinq tagged, vlan ids %d-%d inside outer vlan ids %d-%d\n", flow_vlan_ids.first, flow_vlan_ids.last, flow_outer_vlan_ids.first, flow_outer_vlan_ids.last );
+    else if ( vlan_tags == 1 )
+        printf( "802.1q tagged, vlan ids %d-%d\n", flow_vlan_ids.first, flow_vlan_ids.last );
+
+    // pick the fastest payload generator and checksum this cpu has. they all produce the same bytes
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        random_fill = random_fill_avx2;
+        checksum_add_wide = checksum_add_wide_avx2;
+    }
+
+    if ( payload_mode != PAYLOAD_MODE_RAMP )
+        printf( "%s payload, generated with %s\n", payload_mode_names[payload_mode], ( random_fill == random_fill_avx2 ) ? "avx2" : "scalar" );
+
+    if ( crc_tag )
+        printf( "crc32c tagged payloads, computed with %s\n", crc32c_name );
+
+    if ( udp_checksum && !ipv6 )
+        printf( "udp checksums over ipv4, long spans summed with %s\n", ( checksum_add_wide == checksum_add_wide_avx2 ) ? "avx2" : "scalar" );
+
+    if ( working_set_frames == WORKING_SET_AUTO )
+        printf( "working set per socket sized from its unbounded send rate and its completion latency under a %d frame provisional cap\n", WORKING_SET_PROVISIONAL_FRAMES );
+    else if ( working_set_frames > 0 )
+        printf( "working set capped at %d frames per socket\n", working_set_frames );
+
+    if ( unaligned_umem )
+    {
+        if ( num_sizes > 0 )
+            printf( "unaligned umem, frames packed into cache line slots cut to the largest frame in each size class\n" );
+        else
+            printf( "unaligned umem, frames packed into %d byte slots\n", unaligned_slot_bytes( client_frame_bytes( payload_bytes ) ) );
+    }
+
+    if ( aead != AEAD_NONE )
+        printf( "%s encrypted payloads, with a %d byte nonce and a %d byte tag in each\n", aead_names[aead], AEAD_NONCE_BYTES, AEAD_TAG_BYTES );
+
+    if ( num_sizes > 0 )
+    {
+        printf( "%d packet sizes from %s, average frame %.1f bytes:", num_sizes, sizes_spec ? sizes_spec : sizes_filename, size_average_frame_bytes() );
+        for ( int i = 0; i < num_sizes && i < 8; i++ )
+        {
+            printf( " %d", packet_size[i].frame_bytes );
+        }
+        printf( "%s\n", ( num_sizes > 8 ) ? " ..." : "" );
+    }
+
+    if ( num_destinations > 0 )
+        printf( "%d destinations from %s, %s schedule over %d packets\n", num_destinations, destinations_filename, destination_schedule_names[destination_schedule_type], destination_schedule_length );
+
+    if ( !run_all_backends && ( backend == BACKEND_XDP || backend == BACKEND_PACKET ) )
+    {
+        // sockets build their own templates, but they all come out with the same header stack as this one
+
+        static struct packet_template_t template;
+        const uint8_t ethernet_address[ETH_ALEN] = { 0 };
+        client_build_template( &template, ethernet_address, ( num_destinations > 0 ) ? &destination[0] : NULL, ( num_sizes > 0 ) ? packet_size[0].payload_bytes : payload_bytes );
+        printf( "packets written by the %s writer\n", template_writer_name( template.write ) );
+    }
+
+    printf( "%d interfaces with %d queues each, driven by %d threads\n", num_interfaces, num_queues, num_threads );
+
+    signal( SIGINT,  interrupt_handler );
+    signal( SIGTERM, clean_shutdown_handler );
+    signal( SIGHUP,  config_filename ? reload_config_handler : clean_shutdown_handler );
+
+    struct backend_result_t results[BACKEND_NUM_BACKENDS];
+    memset( results, 0, sizeof(results) );
+
+    const int first_backend = run_all_backends ? 0 : backend;
+    const int last_backend = run_all_backends ? BACKEND_NUM_BACKENDS - 1 : backend;
+
+    for ( int i = first_backend; i <= last_backend && !interrupted; i++ )
+    {
+        backend = i;
+
+        printf( "\n[%s]\n\n", backends[backend].name );
+
+        memset( &client, 0, sizeof(client) );
+
+        quit = false;
+
+        if ( client_init( &client ) != 0 )
+        {
+            cleanup();
+            return 1;
+        }
+
+        uint64_t start = get_nanoseconds();
+
+        uint64_t last_channel_check = start;
+
+        struct control_t control;
+
+        if ( daemon_socket_path )
+        {
+            if ( control_init( &control, daemon_socket_path ) != 0 )
+            {
+                cleanup();
+                return 1;
+            }
+
+            printf( "waiting for commands on %s\n", daemon_socket_path );
+        }
+
+        while ( !quit )
+        {
+            if ( daemon_socket_path )
+                control_update( &control, 1, client_control_command );
+            else
+                usleep( 1000 );
+
+            if ( duration_seconds > 0 && get_nanoseconds() - start >= duration_seconds * 1000000000ULL )
+                quit = true;
+
+            // SIGHUP re-reads the config file. batch size, payload bytes etc. are picked up by the socket threads on their next batch
+
+            int new_num_queues = num_queues;
+            int new_num_threads = num_threads;
+
+            if ( reload_config )
+            {
+                reload_config = false;
+
+                if ( read_config( config_filename, &new_num_queues, &new_num_threads ) == 0 )
+                {
+                    printf( "reloaded %s: batch size %d, payload bytes %d\n", config_filename, send_batch_size, payload_bytes );
+                }
+            }
+
+            // follow 'ethtool -L' changes to the channel count
+
+            if ( follow_channels && get_nanoseconds() - last_channel_check >= 1000000000ULL )
+            {
+                last_channel_check = get_nanoseconds();
+
+                int channels = client_get_channels();
+                if ( channels > 0 && channels <= MAX_QUEUES && channels != num_queues )
+                {
+                    printf( "channel count changed to %d\n", channels );
+                    new_num_queues = channels;
+                    new_num_threads = threads_for_queues( channels );
+                }
+            }
+
+            if ( !quit && client_reconfigure( &client, new_num_queues, new_num_threads ) != 0 )
+            {
+                cleanup();
+                return 1;
+            }
+        }
+
+        if ( daemon_socket_path )
+        {
+            control_shutdown( &control, daemon_socket_path );
+        }
+
+        cleanup();
+
+        results[i].valid = client.total_seconds > 0;
+        results[i].packets_per_second = results[i].valid ? (double) client.total_sent_packets / client.total_seconds : 0.0;
+        results[i].cpu = results[i].valid ? client.total_cpu / client.total_seconds : 0.0;
+        results[i].ksoftirqd_cpu = results[i].valid ? client.total_ksoftirqd_cpu / client.total_seconds : 0.0;
+    }
+
+    // print a comparison table. packets/sec per core counts both our cpu and ksoftirqd
+
+    printf( "\n%-12s%16s%12s%16s%20s\n", "backend", "packets/sec", "cpu", "ksoftirqd cpu", "packets/sec/core" );
+
+    for ( int i = first_backend; i <= last_backend; i++ )
+    {
+        if ( !results[i].valid )
+            continue;
+
+        double cores = ( results[i].cpu + results[i].ksoftirqd_cpu ) / 100.0;
+
+        printf( "%-12s%16.0f%11.1f%%%15.1f%%%20.0f\n", backends[i].name, results[i].packets_per_second, results[i].cpu, results[i].ksoftirqd_cpu, cores > 0.0 ? results[i].packets_per_second / cores : 0.0 );
+    }
+
+    printf( "\n" );
+
+    return 0;
+}
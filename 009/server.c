@@ -0,0 +1,2640 @@
+/*
+    UDP server (userspace)
+
+    Runs on Ubuntu 22.04 LTS 64bit with Linux Kernel 6.5+ *ONLY*
+*/
+
+#define _GNU_SOURCE
+
+#include <memory.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <xdp/libxdp.h>
+#include <xdp/xsk.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <x86intrin.h>
+#include <openssl/evp.h>
+
+#define MAX_INTERFACES 8
+
+#define MAX_QUEUES 64
+
+#define MAX_RECEIVE_BATCH_SIZE 64
+
+#define RECVMMSG_BUFFER_SIZE 2048
+
+#define PACKET_FRAME_SIZE 2048
+
+#define PACKET_BLOCK_SIZE ( 1 << 20 )
+
+#define PACKET_NUM_BLOCKS 64
+
+#define XSK_NUM_FRAMES 4096
+
+#define XSK_FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
+
+#define XSK_UNALIGNED_FRAME_SIZE 2048   // the smallest chunk the kernel takes. it receives into a whole chunk, before it knows the length
+
+#define MAX_IPV6_EXTENSION_HEADERS 4
+
+#define FAMILY_IPV4 0                   // keys for family_received_packets_map in server_xdp
+
+#define FAMILY_IPV6 1
+
+#define NUM_FAMILIES 2
+
+#define MAX_VLAN_TAGS 2
+
+#define MAX_VLANS 4096                  // entries in vlan_received_packets_map in server_xdp, keyed by vlan id
+
+#define MAX_PRINTED_VLANS 16
+
+#define NUM_TUNNELS 4                   // keys for tunnel_received_packets_map in server_xdp. 0 is not tunneled
+
+const char * tunnel_names[NUM_TUNNELS] = { "untunneled", "vxlan", "gre", "gue" };
+
+#define NUM_KINDS 4                     // keys for kind_received_packets_map in server_xdp. 0 is plain udp to port 40000
+
+const char * kind_names[NUM_KINDS] = { "udp", "tcp-syn", "icmp", "dns" };
+
+#define SETTING_VERIFY_UDP_CHECKSUM 0   // keys in settings_map in server_xdp
+#define SETTING_KINDS 1
+
+#define UDP_CHECKSUM_VALID 0            // keys for udp_checksum_packets_map in server_xdp
+#define UDP_CHECKSUM_FAILED 1
+#define UDP_CHECKSUM_NONE 2             // zero over ipv4, or too long to check
+
+#define NUM_UDP_CHECKSUM_RESULTS 3
+
+#define CHECKSUM_TIME_PACKETS 0         // keys for udp_checksum_time_map in server_xdp. a sample of the checked packets, and the ns spent checking them
+#define CHECKSUM_TIME_NS 1
+
+#define CRC_TAG_BYTES 4                 // crc32c of the rest of the udp payload, little endian, at the end of it. see client --crc
+
+#define CRC32C_POLYNOMIAL 0x82F63B78    // reflected
+
+#define CRC32C_STREAM_BYTES 128         // each of the three interleaved streams in crc32c_update_pclmul
+
+#define AEAD_NONCE_BYTES 8              // an encrypted payload is the nonce, the ciphertext, then the tag. see client --aead
+#define AEAD_TAG_BYTES 16
+#define AEAD_OVERHEAD_BYTES ( AEAD_NONCE_BYTES + AEAD_TAG_BYTES )
+#define AEAD_IV_BYTES 12                // four zero bytes, then the nonce
+#define AEAD_MAX_KEY_BYTES 32
+
+enum aead_type_t
+{
+    AEAD_NONE,
+    AEAD_AES_128_GCM,
+    AEAD_AES_256_GCM,
+    AEAD_CHACHA20_POLY1305,
+    AEAD_NUM_TYPES
+};
+
+const char * aead_names[] = { "none", "aes-128-gcm", "aes-256-gcm", "chacha20-poly1305" };
+
+const int aead_key_bytes[] = { 0, 16, 32, 32 };
+
+const char * INTERFACE_NAME = "enp8s0f0";
+
+const uint16_t SERVER_PORT = 40000;
+
+enum engine_type_t
+{
+    ENGINE_XDP,                     // count and drop in server_xdp, the default
+    ENGINE_RECVMMSG,                // SO_REUSEPORT udp sockets, steered to the socket for the current cpu by a reuseport bpf program
+    ENGINE_PACKET,                  // AF_PACKET TPACKET_V3 rx rings in a PACKET_FANOUT_CPU group
+    ENGINE_XSK_COPY,                // server_xdp redirects to AF_XDP sockets bound in copy mode
+    ENGINE_XSK_ZEROCOPY,            // server_xdp redirects to AF_XDP sockets bound in zero copy mode
+    ENGINE_NUM_ENGINES
+};
+
+// these can be overridden on the command line, see print_usage
+
+int engine = ENGINE_XDP;
+
+int num_interfaces = 1;
+
+const char * interface_names[MAX_INTERFACES];
+
+int num_queues = 4;                 // receive threads per interface, one per nic queue starting at queue 0. thread for queue n is pinned to cpu n
+
+volatile int receive_batch_size = 64;   // packets per recvmmsg or xsk ring peek, up to MAX_RECEIVE_BATCH_SIZE
+
+const char * config_filename = NULL;    // re-read on SIGHUP, so the queue count and batch size can change without a restart
+
+bool follow_channels = false;       // add or remove receivers when the channel count on the nic changes
+
+const char * daemon_socket_path = NULL; // in daemon mode we also take commands on this unix socket
+
+bool verify_crc = false;            // check the crc tag at the end of each udp payload, and count the ones that don't match
+
+uint32_t crc32c_table[8][256];
+
+uint64_t crc32c_shift_constant[2];  // x^(8n-33) mod p, for shifting a crc over n = 1 and 2 streams of bytes
+
+bool unaligned_umem = false;        // register the xsk umem with XDP_UMEM_UNALIGNED_CHUNK_FLAG, with chunks packed back to back
+
+uint32_t kinds = 1;                 // bit per kind_names entry that server_xdp takes from the kernel. udp to port 40000 always is
+
+bool verify_udp_checksum = false;   // have server_xdp check the udp checksum on every udp and dns packet, and count valid, failed and none
+
+int aead = AEAD_NONE;               // decrypt and authenticate each payload with the xsk engines
+
+uint8_t aead_key[AEAD_MAX_KEY_BYTES] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+                                         0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+
+int aead_key_bytes_given = 0;       // from --aead-key. 0 means the default key, same as the client's
+
+double tsc_per_millisecond;         // to turn cycles per packet into cores per million packets per second
+
+struct interface_t
+{
+    const char * name;
+    int interface_index;
+    struct xdp_program * program;
+    bool attached_native;
+    bool attached_skb;
+    int xsks_map_fd;
+    uint64_t previous_received_packets;
+    uint64_t retired_received_packets;  // received by receivers that were removed on reconfigure
+    uint64_t retired_received_ipv6_packets;
+    uint64_t retired_verified_packets;
+};
+
+struct receiver_t
+{
+    struct interface_t * interface;
+    int queue_id;
+    int fd;
+    pthread_t thread;
+    bool thread_created;
+    volatile bool stop;
+    uint64_t received_packets;
+    uint64_t received_ipv6_packets;
+    uint64_t verified_packets;              // with --verify-crc: packets whose crc tag matched, and packets that were short, truncated or didn't match
+    uint64_t corrupt_packets;
+    EVP_CIPHER_CTX * aead_context;          // keyed once. each packet only sets the iv and tag
+    uint64_t aead_opened_packets;           // with --aead: packets that decrypted and authenticated, and packets that didn't
+    uint64_t aead_failed_packets;
+    uint64_t aead_cycles;                   // tsc cycles spent decrypting, not counting anything else in the batch
+    void * buffer;
+    struct xsk_umem * umem;
+    struct xsk_ring_prod fill_queue;
+    struct xsk_ring_cons complete_queue;    // not used
+    struct xsk_ring_cons receive_queue;
+    struct xsk_socket * xsk;
+    void * packet_ring;                     // AF_PACKET rx ring
+    size_t packet_ring_bytes;
+    int packet_block_index;
+};
+
+struct server_t
+{
+    struct interface_t interface[MAX_INTERFACES];
+    int num_receivers;
+    struct receiver_t * receiver[MAX_INTERFACES * MAX_QUEUES];  // receiver for queue q on interface i is receiver[i*MAX_QUEUES+q]
+    int received_packets_fd;
+    int interface_received_packets_fd;
+    int family_received_packets_fd;
+    int vlan_received_packets_fd;
+    __u32 * vlan_keys;                  // buffers for reading all of vlan_received_packets_map with one bpf_map_lookup_batch
+    __u64 * vlan_values;                // num_cpus values per vlan
+    int tunnel_received_packets_fd;
+    int kind_received_packets_fd;
+    int udp_checksum_packets_fd;
+    int udp_checksum_time_fd;
+    int num_cpus;
+    uint64_t current_received_packets;
+    uint64_t previous_received_packets;
+    uint64_t previous_family_received_packets[NUM_FAMILIES];
+    uint64_t previous_vlan_received_packets[MAX_VLANS];
+    uint64_t previous_tunnel_received_packets[NUM_TUNNELS];
+    uint64_t previous_kind_received_packets[NUM_KINDS];
+    uint64_t previous_udp_checksum_packets[NUM_UDP_CHECKSUM_RESULTS];
+    uint64_t previous_udp_checksum_time_packets;
+    uint64_t previous_udp_checksum_time_ns;
+    uint64_t previous_verified_packets;
+    uint64_t retired_corrupt_packets[MAX_INTERFACES * MAX_QUEUES];  // per queue, indexed like receiver
+    uint64_t previous_corrupt_packets[MAX_INTERFACES * MAX_QUEUES];
+    uint64_t total_corrupt_packets;
+    uint64_t retired_aead_opened_packets;
+    uint64_t retired_aead_failed_packets;
+    uint64_t retired_aead_cycles;
+    uint64_t previous_aead_opened_packets;
+    uint64_t previous_aead_failed_packets;
+    uint64_t previous_aead_cycles;
+    uint64_t previous_cpu_microseconds;
+    uint64_t previous_softirq_ticks;
+    uint64_t total_seconds;
+    uint64_t total_received_packets;
+    double total_cpu;
+    double total_softirq_cpu;
+    uint64_t last_received_delta;       // last second, for the stats control command
+    double last_cpu;
+    double last_softirq_cpu;
+};
+
+struct engine_t
+{
+    const char * name;
+    bool attach_xdp;
+    int ( *init )( struct receiver_t * receiver );
+    void * ( *thread )( void * arg );
+    void ( *shutdown )( struct receiver_t * receiver );
+};
+
+extern const struct engine_t engines[ENGINE_NUM_ENGINES];
+
+volatile bool quit;
+
+uint64_t server_get_received_packets( struct server_t * server );
+uint64_t server_get_interface_received_packets( struct server_t * server, struct interface_t * interface );
+uint64_t server_get_family_received_packets( struct server_t * server, int family );
+void server_update_vlans( struct server_t * server, bool print );
+void server_update_tunnels( struct server_t * server, bool print );
+void server_update_kinds( struct server_t * server, bool print );
+void server_update_crc( struct server_t * server, bool print );
+void server_update_udp_checksums( struct server_t * server, bool print );
+void server_update_aead( struct server_t * server, bool print );
+int server_init_xdp_stats( struct server_t * server );
+static uint64_t get_cpu_microseconds();
+static uint64_t get_softirq_ticks();
+
+int server_init_interface( struct interface_t * interface, const char * interface_name )
+{
+    interface->name = interface_name;
+
+    // find the network interface that matches the interface name
+    {
+        bool found = false;
+
+        struct ifaddrs * addrs;
+        if ( getifaddrs( &addrs ) != 0 )
+        {
+            printf( "\nerror: getifaddrs failed\n\n" );
+            return 1;
+        }
+
+        for ( struct ifaddrs * iap = addrs; iap != NULL; iap = iap->ifa_next ) 
+        {
+            if ( iap->ifa_addr && ( iap->ifa_flags & IFF_UP ) && iap->ifa_addr->sa_family == AF_INET )
+            {
+                struct sockaddr_in * sa = (struct sockaddr_in*) iap->ifa_addr;
+                if ( strcmp( interface_name, iap->ifa_name ) == 0 )
+                {
+                    printf( "found network interface: '%s'\n", iap->ifa_name );
+                    interface->interface_index = if_nametoindex( iap->ifa_name );
+                    if ( !interface->interface_index ) 
+                    {
+                        printf( "\nerror: if_nametoindex failed\n\n" );
+                        return 1;
+                    }
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        freeifaddrs( addrs );
+
+        if ( !found )
+        {
+            printf( "\nerror: could not find any network interface matching '%s'\n\n", interface_name );
+            return 1;
+        }
+    }
+
+    // load the server_xdp program and attach it to the network interface
+
+    // the recvmmsg and packet engines see packets through the regular network stack, so they don't attach server_xdp
+
+    if ( !engines[engine].attach_xdp )
+        return 0;
+
+    printf( "loading server_xdp...\n" );
+
+    interface->program = xdp_program__open_file( "server_xdp.o", "server_xdp", NULL );
+    if ( libxdp_get_error( interface->program ) ) 
+    {
+        interface->program = NULL;
+        printf( "\nerror: could not load server_xdp program\n\n");
+        return 1;
+    }
+
+    printf( "server_xdp loaded successfully.\n" );
+
+    printf( "attaching server_xdp to network interface '%s'\n", interface_name );
+
+    int ret = xdp_program__attach( interface->program, interface->interface_index, XDP_MODE_NATIVE, 0 );
+    if ( ret == 0 )
+    {
+        interface->attached_native = true;
+    } 
+    else
+    {
+        printf( "falling back to skb mode...\n" );
+        ret = xdp_program__attach( interface->program, interface->interface_index, XDP_MODE_SKB, 0 );
+        if ( ret == 0 )
+        {
+            interface->attached_skb = true;
+        }
+        else
+        {
+            printf( "\nerror: failed to attach server_xdp program to interface\n\n" );
+            return 1;
+        }
+    }
+
+    // each interface has its own xsks map, so we can only get it from the program we loaded
+
+    struct bpf_map * xsks_map = bpf_object__find_map_by_name( xdp_program__bpf_obj( interface->program ), "xsks_map" );
+    if ( !xsks_map )
+    {
+        printf( "\nerror: could not find xsks map\n\n" );
+        return 1;
+    }
+
+    interface->xsks_map_fd = bpf_map__fd( xsks_map );
+
+    return 0;
+}
+
+int server_add_receiver( struct server_t * server, int interface_index, int queue_id )
+{
+    struct receiver_t * receiver = calloc( 1, sizeof(struct receiver_t) );
+    if ( !receiver )
+    {
+        printf( "\nerror: could not allocate receiver\n\n" );
+        return 1;
+    }
+
+    receiver->interface = &server->interface[interface_index];
+    receiver->queue_id = queue_id;
+
+    server->receiver[interface_index * MAX_QUEUES + queue_id] = receiver;
+    server->num_receivers++;
+
+    if ( engines[engine].init( receiver ) != 0 )
+        return 1;
+
+    if ( pthread_create( &receiver->thread, NULL, engines[engine].thread, receiver ) )
+    {
+        printf( "\nerror: could not create receive thread for %s queue %d\n\n", receiver->interface->name, queue_id );
+        return 1;
+    }
+
+    receiver->thread_created = true;
+
+    return 0;
+}
+
+void server_remove_receiver( struct server_t * server, int interface_index, int queue_id )
+{
+    struct receiver_t * receiver = server->receiver[interface_index * MAX_QUEUES + queue_id];
+    if ( !receiver )
+        return;
+
+    receiver->stop = true;
+
+    if ( receiver->thread_created )
+    {
+        pthread_join( receiver->thread, NULL );
+    }
+
+    engines[engine].shutdown( receiver );
+
+    // keep its count, so the stats don't go backwards
+
+    receiver->interface->retired_received_packets += receiver->received_packets;
+    receiver->interface->retired_received_ipv6_packets += receiver->received_ipv6_packets;
+    receiver->interface->retired_verified_packets += receiver->verified_packets;
+    server->retired_corrupt_packets[interface_index * MAX_QUEUES + queue_id] += receiver->corrupt_packets;
+    server->retired_aead_opened_packets += receiver->aead_opened_packets;
+    server->retired_aead_failed_packets += receiver->aead_failed_packets;
+    server->retired_aead_cycles += receiver->aead_cycles;
+
+    server->receiver[interface_index * MAX_QUEUES + queue_id] = NULL;
+    server->num_receivers--;
+
+    free( receiver->buffer );
+    free( receiver );
+}
+
+int server_reconfigure( struct server_t * server, int new_num_queues )
+{
+    if ( new_num_queues == num_queues )
+        return 0;
+
+    printf( "reconfiguring from %d queues to %d queues\n", num_queues, new_num_queues );
+
+    // xdp stays attached, and receivers for queues we keep aren't touched. the xdp engine has no receivers, so there's nothing to do
+
+    if ( engines[engine].init )
+    {
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            // remove from the top down, so the remaining sockets keep their place in reuseport and fanout groups
+
+            for ( int j = num_queues - 1; j >= new_num_queues; j-- )
+            {
+                server_remove_receiver( server, i, j );
+            }
+
+            for ( int j = num_queues; j < new_num_queues; j++ )
+            {
+                if ( server_add_receiver( server, i, j ) != 0 )
+                    return 1;
+            }
+        }
+    }
+
+    num_queues = new_num_queues;
+
+    return 0;
+}
+
+int server_init( struct server_t * server )
+{
+    // we can only run xdp programs as root
+
+    if ( geteuid() != 0 ) 
+    {
+        printf( "\nerror: this program must be run as root\n\n" );
+        return 1;
+    }
+
+    // find each network interface, and load and attach the server_xdp program to it. the maps are pinned by name, so all interfaces share them
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        if ( server_init_interface( &server->interface[i], interface_names[i] ) != 0 )
+            return 1;
+    }
+
+    if ( engines[engine].attach_xdp )
+    {
+        if ( server_init_xdp_stats( server ) != 0 )
+            return 1;
+    }
+
+    // allow unlimited locking of memory, so all memory needed for packet buffers can be locked
+
+    struct rlimit rlim = { RLIM_INFINITY, RLIM_INFINITY };
+
+    if ( setrlimit( RLIMIT_MEMLOCK, &rlim ) ) 
+    {
+        printf( "\nerror: could not setrlimit\n\n");
+        return 1;
+    }
+
+    // create a receiver per queue per interface, and a thread for each. the xdp engine counts everything in server_xdp, so it doesn't have any
+
+    if ( engines[engine].init )
+    {
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            for ( int j = 0; j < num_queues; j++ )
+            {
+                if ( server_add_receiver( server, i, j ) != 0 )
+                    return 1;
+            }
+        }
+    }
+
+    // get number of possible cpus and store the current received packets value in previous, so we don't get large numbers on first update when we run the program repeatedly
+
+    server->num_cpus = libbpf_num_possible_cpus();
+
+    server->previous_received_packets = server_get_received_packets( server );
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        server->interface[i].previous_received_packets = server_get_interface_received_packets( server, &server->interface[i] );
+    }
+
+    for ( int i = 0; i < NUM_FAMILIES; i++ )
+    {
+        server->previous_family_received_packets[i] = server_get_family_received_packets( server, i );
+    }
+
+    server_update_vlans( server, false );
+
+    server_update_tunnels( server, false );
+
+    server_update_kinds( server, false );
+
+    server_update_crc( server, false );
+
+    server_update_udp_checksums( server, false );
+
+    server_update_aead( server, false );
+
+    server->previous_cpu_microseconds = get_cpu_microseconds();
+
+    server->previous_softirq_ticks = get_softirq_ticks();
+
+    return 0;
+}
+
+int server_init_xdp_stats( struct server_t * server )
+{
+    // look up receive packets map
+
+    server->received_packets_fd = bpf_obj_get( "/sys/fs/bpf/received_packets_map" );
+    if ( server->received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->interface_received_packets_fd = bpf_obj_get( "/sys/fs/bpf/interface_received_packets_map" );
+    if ( server->interface_received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get interface received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->family_received_packets_fd = bpf_obj_get( "/sys/fs/bpf/family_received_packets_map" );
+    if ( server->family_received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get family received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->vlan_received_packets_fd = bpf_obj_get( "/sys/fs/bpf/vlan_received_packets_map" );
+    if ( server->vlan_received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get vlan received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->vlan_keys = (__u32*) malloc( MAX_VLANS * sizeof(__u32) );
+    server->vlan_values = (__u64*) malloc( (size_t) MAX_VLANS * server->num_cpus * sizeof(__u64) );
+    if ( !server->vlan_keys || !server->vlan_values )
+    {
+        printf( "\nerror: could not allocate vlan counter buffers\n\n" );
+        return 1;
+    }
+
+    server->tunnel_received_packets_fd = bpf_obj_get( "/sys/fs/bpf/tunnel_received_packets_map" );
+    if ( server->tunnel_received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get tunnel received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->kind_received_packets_fd = bpf_obj_get( "/sys/fs/bpf/kind_received_packets_map" );
+    if ( server->kind_received_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get kind received packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->udp_checksum_packets_fd = bpf_obj_get( "/sys/fs/bpf/udp_checksum_packets_map" );
+    if ( server->udp_checksum_packets_fd <= 0 )
+    {
+        printf( "\nerror: could not get udp checksum packets map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    server->udp_checksum_time_fd = bpf_obj_get( "/sys/fs/bpf/udp_checksum_time_map" );
+    if ( server->udp_checksum_time_fd <= 0 )
+    {
+        printf( "\nerror: could not get udp checksum time map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    // settings persist in the pinned map between runs, so always write them, not only when they are on
+
+    int settings_fd = bpf_obj_get( "/sys/fs/bpf/settings_map" );
+    if ( settings_fd <= 0 )
+    {
+        printf( "\nerror: could not get settings map: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    __u32 settings[][2] =
+    {
+        { SETTING_VERIFY_UDP_CHECKSUM, verify_udp_checksum ? 1 : 0 },
+        { SETTING_KINDS, kinds },
+    };
+
+    for ( int i = 0; i < (int) ( sizeof(settings) / sizeof(settings[0]) ); i++ )
+    {
+        if ( bpf_map_update_elem( settings_fd, &settings[i][0], &settings[i][1], BPF_ANY ) != 0 )
+        {
+            printf( "\nerror: could not write settings map: %s\n\n", strerror(errno) );
+            close( settings_fd );
+            return 1;
+        }
+    }
+
+    close( settings_fd );
+
+    return 0;
+}
+
+uint64_t server_get_received_packets( struct server_t * server )
+{
+    // engines with receive threads count in userspace
+
+    if ( engines[engine].init )
+    {
+        uint64_t received_packets = 0;
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            received_packets += server_get_interface_received_packets( server, &server->interface[i] );
+        }
+        return received_packets;
+    }
+
+    __u64 thread_received_packets[server->num_cpus];
+    int key = 0;
+    if ( bpf_map_lookup_elem( server->received_packets_fd, &key, thread_received_packets ) != 0 ) 
+    {
+        printf( "\nerror: could not look up received packets map: %s\n\n", strerror( errno ) );
+        exit( 1 );
+    }
+
+    uint64_t received_packets = 0;
+    for ( int i = 0; i < server->num_cpus; i++ )
+    {
+        received_packets += thread_received_packets[i];
+    }
+
+    return received_packets;
+}
+
+uint64_t server_get_interface_received_packets( struct server_t * server, struct interface_t * interface )
+{
+    if ( engines[engine].init )
+    {
+        uint64_t received_packets = interface->retired_received_packets;
+        for ( int i = 0; i < MAX_INTERFACES * MAX_QUEUES; i++ )
+        {
+            if ( server->receiver[i] && server->receiver[i]->interface == interface )
+                received_packets += server->receiver[i]->received_packets;
+        }
+        return received_packets;
+    }
+
+    // the entry for an interface doesn't exist until it receives its first packet
+
+    __u64 thread_received_packets[server->num_cpus];
+    __u32 key = interface->interface_index;
+    if ( bpf_map_lookup_elem( server->interface_received_packets_fd, &key, thread_received_packets ) != 0 ) 
+    {
+        return 0;
+    }
+
+    uint64_t received_packets = 0;
+    for ( int i = 0; i < server->num_cpus; i++ )
+    {
+        received_packets += thread_received_packets[i];
+    }
+
+    return received_packets;
+}
+
+uint64_t server_get_family_received_packets( struct server_t * server, int family )
+{
+    // engines that see packets before server_xdp count families themselves. everything else reads them from server_xdp
+
+    if ( !engines[engine].attach_xdp )
+    {
+        uint64_t received_ipv6_packets = 0;
+        for ( int i = 0; i < num_interfaces; i++ )
+        {
+            received_ipv6_packets += server->interface[i].retired_received_ipv6_packets;
+        }
+        for ( int i = 0; i < MAX_INTERFACES * MAX_QUEUES; i++ )
+        {
+            if ( server->receiver[i] )
+                received_ipv6_packets += server->receiver[i]->received_ipv6_packets;
+        }
+        return ( family == FAMILY_IPV6 ) ? received_ipv6_packets : server_get_received_packets( server ) - received_ipv6_packets;
+    }
+
+    __u64 thread_received_packets[server->num_cpus];
+    int key = family;
+    if ( bpf_map_lookup_elem( server->family_received_packets_fd, &key, thread_received_packets ) != 0 ) 
+    {
+        return 0;
+    }
+
+    uint64_t received_packets = 0;
+    for ( int i = 0; i < server->num_cpus; i++ )
+    {
+        received_packets += thread_received_packets[i];
+    }
+
+    return received_packets;
+}
+
+static uint64_t server_get_percpu_packets( struct server_t * server, int map_fd, __u32 key )
+{
+    // sum one entry of a per-cpu array map from server_xdp
+
+    __u64 thread_received_packets[server->num_cpus];
+
+    if ( bpf_map_lookup_elem( map_fd, &key, thread_received_packets ) != 0 ) 
+        return 0;
+
+    uint64_t received_packets = 0;
+    for ( int i = 0; i < server->num_cpus; i++ )
+    {
+        received_packets += thread_received_packets[i];
+    }
+
+    return received_packets;
+}
+
+static void server_update_counters( struct server_t * server, int map_fd, const char ** names, int num_keys, uint64_t * previous_received_packets, bool print )
+{
+    // deltas for each key of a small per-cpu array map from server_xdp, printed on one line once anything other than key 0 has turned up
+
+    if ( !engines[engine].attach_xdp )
+        return;
+
+    uint64_t delta[num_keys];
+
+    bool seen = false;
+
+    for ( int key = 0; key < num_keys; key++ )
+    {
+        uint64_t received_packets = server_get_percpu_packets( server, map_fd, key );
+
+        delta[key] = received_packets - previous_received_packets[key];
+
+        previous_received_packets[key] = received_packets;
+
+        if ( key > 0 && received_packets > 0 )
+            seen = true;
+    }
+
+    if ( !print || !seen )
+        return;
+
+    printf( "   " );
+    for ( int key = 0; key < num_keys; key++ )
+    {
+        printf( "%s %s received delta %" PRId64, ( key > 0 ) ? "," : "", names[key], delta[key] );
+    }
+    printf( "\n" );
+}
+
+void server_update_tunnels( struct server_t * server, bool print )
+{
+    // per tunnel deltas. packets are counted after decap, by their inner headers
+
+    server_update_counters( server, server->tunnel_received_packets_fd, tunnel_names, NUM_TUNNELS, server->previous_tunnel_received_packets, print );
+}
+
+void server_update_kinds( struct server_t * server, bool print )
+{
+    // per kind deltas: udp and tcp syns to port 40000, icmp echo requests and dns queries
+
+    server_update_counters( server, server->kind_received_packets_fd, kind_names, NUM_KINDS, server->previous_kind_received_packets, print );
+}
+
+void server_update_vlans( struct server_t * server, bool print )
+{
+    // per vlan deltas, from server_xdp. nothing is printed until some tagged traffic turns up, and then only vlans that received something
+
+    if ( !engines[engine].attach_xdp )
+        return;
+
+    // one batch lookup for the whole map, not a syscall per vlan. the server's cpu would otherwise mostly be these lookups
+
+    __u32 count = 0;
+    __u32 out_batch = 0;
+    bool first = true;
+
+    while ( count < MAX_VLANS )
+    {
+        __u32 batch_count = MAX_VLANS - count;
+        const int result = bpf_map_lookup_batch( server->vlan_received_packets_fd, first ? NULL : &out_batch, &out_batch,
+                                                 server->vlan_keys + count, server->vlan_values + (size_t) count * server->num_cpus, &batch_count, NULL );
+        first = false;
+        count += batch_count;
+        if ( result != 0 )
+        {
+            if ( errno != ENOENT )
+                return;
+            break;
+        }
+    }
+
+    uint64_t delta[MAX_VLANS];
+    memset( delta, 0, sizeof(delta) );
+
+    bool tagged = false;
+
+    for ( __u32 i = 0; i < count; i++ )
+    {
+        const __u32 vlan = server->vlan_keys[i];
+        if ( vlan >= MAX_VLANS )
+            continue;
+
+        uint64_t received_packets = 0;
+        for ( int cpu = 0; cpu < server->num_cpus; cpu++ )
+        {
+            received_packets += server->vlan_values[(size_t) i * server->num_cpus + cpu];
+        }
+
+        delta[vlan] = received_packets - server->previous_vlan_received_packets[vlan];
+
+        server->previous_vlan_received_packets[vlan] = received_packets;
+
+        if ( vlan > 0 && delta[vlan] > 0 )
+            tagged = true;
+    }
+
+    if ( !print || !tagged )
+        return;
+
+    int printed = 0;
+    int not_printed = 0;
+
+    for ( int vlan = 0; vlan < MAX_VLANS; vlan++ )
+    {
+        if ( delta[vlan] == 0 )
+            continue;
+
+        if ( printed == MAX_PRINTED_VLANS )
+        {
+            not_printed++;
+            continue;
+        }
+
+        if ( vlan == 0 )
+            printf( "    untagged received delta %" PRId64 "\n", delta[vlan] );
+        else
+            printf( "    vlan %d received delta %" PRId64 "\n", vlan, delta[vlan] );
+
+        printed++;
+    }
+
+    if ( not_printed > 0 )
+    {
+        printf( "    ... and %d more vlans\n", not_printed );
+    }
+}
+
+void server_update_crc( struct server_t * server, bool print )
+{
+    // verified and corrupt deltas with --verify-crc. corrupt packets are broken out per queue, since corruption usually comes from one place
+
+    if ( !verify_crc )
+        return;
+
+    uint64_t verified_packets = 0;
+    uint64_t corrupt_delta = 0;
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        verified_packets += server->interface[i].retired_verified_packets;
+    }
+
+    for ( int i = 0; i < MAX_INTERFACES * MAX_QUEUES; i++ )
+    {
+        uint64_t corrupt_packets = server->retired_corrupt_packets[i];
+
+        if ( server->receiver[i] )
+        {
+            verified_packets += server->receiver[i]->verified_packets;
+            corrupt_packets += server->receiver[i]->corrupt_packets;
+        }
+
+        const uint64_t delta = corrupt_packets - server->previous_corrupt_packets[i];
+
+        server->previous_corrupt_packets[i] = corrupt_packets;
+
+        if ( print && delta > 0 )
+            printf( "    %s queue %d corrupt delta %" PRId64 "\n", server->interface[i / MAX_QUEUES].name, i % MAX_QUEUES, delta );
+
+        corrupt_delta += delta;
+    }
+
+    if ( print )
+        printf( "    crc verified delta %" PRId64 ", corrupt delta %" PRId64 "\n", verified_packets - server->previous_verified_packets, corrupt_delta );
+
+    server->previous_verified_packets = verified_packets;
+
+    server->total_corrupt_packets += corrupt_delta;
+}
+
+void server_update_udp_checksums( struct server_t * server, bool print )
+{
+    // valid, failed and none deltas with --verify-udp-checksum. these are counted in server_xdp, before any engine sees the packet
+
+    if ( !verify_udp_checksum || !engines[engine].attach_xdp )
+        return;
+
+    uint64_t delta[NUM_UDP_CHECKSUM_RESULTS];
+
+    for ( int result = 0; result < NUM_UDP_CHECKSUM_RESULTS; result++ )
+    {
+        uint64_t packets = server_get_percpu_packets( server, server->udp_checksum_packets_fd, result );
+
+        delta[result] = packets - server->previous_udp_checksum_packets[result];
+
+        server->previous_udp_checksum_packets[result] = packets;
+    }
+
+    // checking cost on its own, from the sample server_xdp times, so we can work out how many cores a given packet rate of checked traffic needs
+
+    const uint64_t time_packets = server_get_percpu_packets( server, server->udp_checksum_time_fd, CHECKSUM_TIME_PACKETS );
+    const uint64_t time_ns = server_get_percpu_packets( server, server->udp_checksum_time_fd, CHECKSUM_TIME_NS );
+
+    if ( print )
+    {
+        printf( "    udp checksum valid delta %" PRId64 ", failed delta %" PRId64 ", none delta %" PRId64, delta[UDP_CHECKSUM_VALID], delta[UDP_CHECKSUM_FAILED], delta[UDP_CHECKSUM_NONE] );
+
+        if ( time_packets > server->previous_udp_checksum_time_packets )
+        {
+            const double ns_per_packet = (double) ( time_ns - server->previous_udp_checksum_time_ns ) / ( time_packets - server->previous_udp_checksum_time_packets );
+            printf( ", %.0f ns per packet, %.2f cores per mpps", ns_per_packet, ns_per_packet / 1000.0 );
+        }
+
+        printf( "\n" );
+    }
+
+    server->previous_udp_checksum_time_packets = time_packets;
+    server->previous_udp_checksum_time_ns = time_ns;
+}
+
+void server_update_aead( struct server_t * server, bool print )
+{
+    // decrypt cost on its own, so we can work out how many cores a given packet rate of encrypted traffic needs
+
+    if ( aead == AEAD_NONE )
+        return;
+
+    uint64_t opened_packets = server->retired_aead_opened_packets;
+    uint64_t failed_packets = server->retired_aead_failed_packets;
+    uint64_t cycles = server->retired_aead_cycles;
+
+    for ( int i = 0; i < MAX_INTERFACES * MAX_QUEUES; i++ )
+    {
+        if ( server->receiver[i] )
+        {
+            opened_packets += server->receiver[i]->aead_opened_packets;
+            failed_packets += server->receiver[i]->aead_failed_packets;
+            cycles += server->receiver[i]->aead_cycles;
+        }
+    }
+
+    const uint64_t opened_delta = opened_packets - server->previous_aead_opened_packets;
+    const uint64_t failed_delta = failed_packets - server->previous_aead_failed_packets;
+
+    if ( print && opened_delta + failed_delta > 0 )
+    {
+        const double cycles_per_packet = (double) ( cycles - server->previous_aead_cycles ) / ( opened_delta + failed_delta );
+        printf( "    %s decrypted delta %" PRId64 ", failed delta %" PRId64 ", %.0f cycles per packet, %.2f cores per mpps\n",
+            aead_names[aead], opened_delta, failed_delta, cycles_per_packet, cycles_per_packet * 1000.0 / tsc_per_millisecond );
+    }
+
+    server->previous_aead_opened_packets = opened_packets;
+    server->previous_aead_failed_packets = failed_packets;
+    server->previous_aead_cycles = cycles;
+}
+
+static uint64_t get_cpu_microseconds()
+{
+    // user + system time for all threads in this process
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint64_t get_softirq_ticks()
+{
+    // server_xdp runs in softirq context, and so does most of the kernel receive path, so sum softirq time across all cpus from /proc/stat
+
+    FILE * file = fopen( "/proc/stat", "r" );
+    if ( !file )
+        return 0;
+
+    unsigned long long user, nice, system, idle, iowait, irq, softirq = 0;
+    if ( fscanf( file, "cpu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq ) != 7 )
+        softirq = 0;
+
+    fclose( file );
+
+    return softirq;
+}
+
+bool pin_thread_to_cpu( int cpu ) 
+{
+    int num_cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    if ( cpu < 0 || cpu >= num_cpus  )
+        return false;
+
+    cpu_set_t cpuset;
+    CPU_ZERO( &cpuset );
+    CPU_SET( cpu, &cpuset );
+
+    pthread_t current_thread = pthread_self();    
+
+    return pthread_setaffinity_np( current_thread, sizeof(cpu_set_t), &cpuset ) == 0;
+}
+
+static int create_socket( int domain, int type, int protocol )
+{
+    // receiver_t parameters would hide socket() if they were called socket, so keep the call in one place
+    return socket( domain, type, protocol );
+}
+
+static uint32_t crc32c_power( int n )
+{
+    // x^n mod p, in reflected order. bit 31 is x^0
+
+    uint32_t value = 0x80000000;
+    for ( int i = 0; i < n; i++ )
+    {
+        value = ( value & 1 ) ? ( value >> 1 ) ^ CRC32C_POLYNOMIAL : value >> 1;
+    }
+    return value;
+}
+
+uint32_t crc32c_update_scalar( uint32_t crc, const void * data, int bytes )
+{
+    // slicing by 8: eight table lookups per 8 bytes
+
+    const uint8_t * p = data;
+
+    for ( ; bytes >= 8; bytes -= 8, p += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, p, 8 );
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xFF] ^ crc32c_table[6][( word >> 8 ) & 0xFF] ^ crc32c_table[5][( word >> 16 ) & 0xFF] ^ crc32c_table[4][( word >> 24 ) & 0xFF] ^
+              crc32c_table[3][( word >> 32 ) & 0xFF] ^ crc32c_table[2][( word >> 40 ) & 0xFF] ^ crc32c_table[1][( word >> 48 ) & 0xFF] ^ crc32c_table[0][word >> 56];
+    }
+
+    for ( ; bytes > 0; bytes--, p++ )
+    {
+        crc = crc32c_table[0][( crc ^ *p ) & 0xFF] ^ ( crc >> 8 );
+    }
+
+    return crc;
+}
+
+__attribute__ ((target ("sse4.2"))) uint32_t crc32c_update_sse42( uint32_t crc, const void * data, int bytes )
+{
+    // one crc32 instruction per 8 bytes. each depends on the last, so this runs at the instruction's latency, not its throughput
+
+    const uint8_t * p = data;
+
+    uint64_t crc64 = crc;
+
+    for ( ; bytes >= 8; bytes -= 8, p += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, p, 8 );
+        crc64 = _mm_crc32_u64( crc64, word );
+    }
+
+    crc = crc64;
+
+    for ( ; bytes > 0; bytes--, p++ )
+    {
+        crc = _mm_crc32_u8( crc, *p );
+    }
+
+    return crc;
+}
+
+__attribute__ ((target ("sse4.2,pclmul"))) uint32_t crc32c_update_pclmul( uint32_t crc, const void * data, int bytes )
+{
+    // three independent streams keep the crc32 unit busy. then shift the first two streams' crcs past the bytes that followed them with a
+    // carry-less multiply by x^(8n-33), and fold them into the third with one more crc32. short tails go one stream at a time
+
+    const uint8_t * p = data;
+
+    uint64_t crc0 = crc;
+
+    while ( bytes >= 3 * CRC32C_STREAM_BYTES )
+    {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+
+        for ( int i = 0; i < CRC32C_STREAM_BYTES; i += 8 )
+        {
+            uint64_t word0, word1, word2;
+            memcpy( &word0, p + i, 8 );
+            memcpy( &word1, p + CRC32C_STREAM_BYTES + i, 8 );
+            memcpy( &word2, p + 2 * CRC32C_STREAM_BYTES + i, 8 );
+            crc0 = _mm_crc32_u64( crc0, word0 );
+            crc1 = _mm_crc32_u64( crc1, word1 );
+            crc2 = _mm_crc32_u64( crc2, word2 );
+        }
+
+        const __m128i shift0 = _mm_clmulepi64_si128( _mm_cvtsi64_si128( crc0 ), _mm_cvtsi64_si128( crc32c_shift_constant[1] ), 0x00 );
+        const __m128i shift1 = _mm_clmulepi64_si128( _mm_cvtsi64_si128( crc1 ), _mm_cvtsi64_si128( crc32c_shift_constant[0] ), 0x00 );
+
+        crc0 = crc2 ^ _mm_crc32_u64( 0, _mm_cvtsi128_si64( _mm_xor_si128( shift0, shift1 ) ) );
+
+        p += 3 * CRC32C_STREAM_BYTES;
+        bytes -= 3 * CRC32C_STREAM_BYTES;
+    }
+
+    return crc32c_update_sse42( crc0, p, bytes );
+}
+
+uint32_t ( *crc32c_update )( uint32_t crc, const void * data, int bytes ) = crc32c_update_scalar;  // the fastest one this cpu has
+
+const char * crc32c_init()
+{
+    // build the tables and shift constants, then pick an implementation. they all give the same crc. returns its name
+
+    for ( int i = 0; i < 256; i++ )
+    {
+        uint32_t value = i;
+        for ( int bit = 0; bit < 8; bit++ )
+        {
+            value = ( value & 1 ) ? ( value >> 1 ) ^ CRC32C_POLYNOMIAL : value >> 1;
+        }
+        crc32c_table[0][i] = value;
+    }
+
+    for ( int i = 0; i < 256; i++ )
+    {
+        for ( int j = 1; j < 8; j++ )
+        {
+            crc32c_table[j][i] = crc32c_table[0][crc32c_table[j - 1][i] & 0xFF] ^ ( crc32c_table[j - 1][i] >> 8 );
+        }
+    }
+
+    crc32c_shift_constant[0] = crc32c_power( 8 * CRC32C_STREAM_BYTES - 33 );
+    crc32c_shift_constant[1] = crc32c_power( 16 * CRC32C_STREAM_BYTES - 33 );
+
+    if ( __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "pclmul" ) )
+    {
+        crc32c_update = crc32c_update_pclmul;
+        return "sse4.2 + pclmul";
+    }
+
+    if ( __builtin_cpu_supports( "sse4.2" ) )
+    {
+        crc32c_update = crc32c_update_sse42;
+        return "sse4.2";
+    }
+
+    crc32c_update = crc32c_update_scalar;
+    return "scalar";
+}
+
+const EVP_CIPHER * aead_cipher()
+{
+    switch ( aead )
+    {
+        case AEAD_AES_128_GCM:          return EVP_aes_128_gcm();
+        case AEAD_AES_256_GCM:          return EVP_aes_256_gcm();
+        case AEAD_CHACHA20_POLY1305:    return EVP_chacha20_poly1305();
+        default:                        return NULL;
+    }
+}
+
+static inline bool aead_open( EVP_CIPHER_CTX * context, uint8_t * payload, int payload_bytes )
+{
+    // decrypt in place after the nonce, and check the tag at the end. payloads too short to have a nonce and tag fail
+
+    if ( payload_bytes < AEAD_OVERHEAD_BYTES )
+        return false;
+
+    uint8_t iv[AEAD_IV_BYTES];
+    memset( iv, 0, AEAD_IV_BYTES - AEAD_NONCE_BYTES );
+    memcpy( iv + AEAD_IV_BYTES - AEAD_NONCE_BYTES, payload, AEAD_NONCE_BYTES );
+
+    uint8_t * text = payload + AEAD_NONCE_BYTES;
+    const int text_bytes = payload_bytes - AEAD_OVERHEAD_BYTES;
+
+    int bytes = 0;
+    int final_bytes = 0;
+
+    return EVP_DecryptInit_ex( context, NULL, NULL, NULL, iv ) &&
+           EVP_DecryptUpdate( context, text, &bytes, text, text_bytes ) &&
+           EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_BYTES, text + text_bytes ) &&
+           EVP_DecryptFinal_ex( context, text + bytes, &final_bytes ) > 0;
+}
+
+static inline bool payload_crc_matches( const uint8_t * payload, int payload_bytes )
+{
+    // the tag is the crc of everything in front of it. payloads too short to have one don't match
+
+    if ( payload_bytes < CRC_TAG_BYTES )
+        return false;
+
+    uint32_t tag;
+    memcpy( &tag, payload + payload_bytes - CRC_TAG_BYTES, CRC_TAG_BYTES );
+
+    return ~crc32c_update( ~0U, payload, payload_bytes - CRC_TAG_BYTES ) == le32toh( tag );
+}
+
+int server_packet_family( const uint8_t * data, int length, const uint8_t ** payload, int * payload_bytes )
+{
+    // ipv4 or ipv6 udp to SERVER_PORT, same as server_xdp. returns FAMILY_IPV4, FAMILY_IPV6 or -1 if it's not for us.
+    // also returns where the udp payload is, and its length from the udp header, or -1 if the packet was cut short
+
+    const uint8_t * end = data + length;
+
+    if ( length < sizeof(struct ethhdr) )
+        return -1;
+
+    const struct ethhdr * eth = (const struct ethhdr*) data;
+
+    const uint8_t * header = data + sizeof(struct ethhdr);
+
+    // the kernel usually strips the vlan tag before we see it, but not always the outer tag with qinq
+
+    uint16_t protocol = eth->h_proto;
+
+    for ( int i = 0; i < MAX_VLAN_TAGS && ( protocol == htons( ETH_P_8021Q ) || protocol == htons( ETH_P_8021AD ) ); i++ )
+    {
+        if ( header + 4 > end )
+            return -1;
+        memcpy( &protocol, header + 2, 2 );
+        header += 4;
+    }
+
+    int family;
+    int next_header;
+
+    if ( protocol == htons( ETH_P_IP ) )
+    {
+        const struct iphdr * ip = (const struct iphdr*) header;
+        if ( header + sizeof(struct iphdr) > end )
+            return -1;
+        family = FAMILY_IPV4;
+        next_header = ip->protocol;
+        header += sizeof(struct iphdr);
+    }
+    else if ( protocol == htons( ETH_P_IPV6 ) )
+    {
+        const struct ipv6hdr * ip6 = (const struct ipv6hdr*) header;
+        if ( header + sizeof(struct ipv6hdr) > end )
+            return -1;
+        family = FAMILY_IPV6;
+        next_header = ip6->nexthdr;
+        header += sizeof(struct ipv6hdr);
+
+        for ( int i = 0; i < MAX_IPV6_EXTENSION_HEADERS && next_header != IPPROTO_UDP; i++ )
+        {
+            if ( header + 8 > end )
+                return -1;
+
+            if ( next_header == IPPROTO_FRAGMENT )
+            {
+                uint16_t fragment_offset;
+                memcpy( &fragment_offset, header + 2, 2 );
+                if ( fragment_offset & htons( 0xFFF8 ) )
+                    return -1;
+                next_header = header[0];
+                header += 8;
+            }
+            else if ( next_header == IPPROTO_HOPOPTS || next_header == IPPROTO_ROUTING || next_header == IPPROTO_DSTOPTS )
+            {
+                next_header = header[0];
+                header += ( header[1] + 1 ) * 8;
+            }
+            else
+            {
+                return -1;
+            }
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    if ( next_header != IPPROTO_UDP || header + sizeof(struct udphdr) > end )
+        return -1;
+
+    const struct udphdr * udp = (const struct udphdr*) header;
+
+    *payload = header + sizeof(struct udphdr);
+    *payload_bytes = ntohs( udp->len ) - (int) sizeof(struct udphdr);
+    if ( *payload + *payload_bytes > end )
+        *payload_bytes = -1;
+
+    return ( udp->dest == htons( SERVER_PORT ) ) ? family : -1;
+}
+
+int receiver_init_recvmmsg( struct receiver_t * receiver )
+{
+    receiver->fd = create_socket( AF_INET6, SOCK_DGRAM, IPPROTO_UDP );
+    if ( receiver->fd < 0 )
+    {
+        printf( "\nerror: could not create udp socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    // dual stack, so ipv4 packets arrive on the same sockets as v4 mapped addresses
+
+    int v6_only = 0;
+    if ( setsockopt( receiver->fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only) ) )
+    {
+        printf( "\nerror: could not clear IPV6_V6ONLY: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    // every receiver for an interface joins the same reuseport group
+
+    int value = 1;
+    if ( setsockopt( receiver->fd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value) ) )
+    {
+        printf( "\nerror: could not set SO_REUSEPORT: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    if ( setsockopt( receiver->fd, SOL_SOCKET, SO_BINDTODEVICE, receiver->interface->name, strlen( receiver->interface->name ) + 1 ) )
+    {
+        printf( "\nerror: could not bind udp socket to device '%s': %s\n\n", receiver->interface->name, strerror(errno) );
+        return 1;
+    }
+
+    // wake up every 100ms so we notice when it's time to quit
+
+    struct timeval timeout = { 0, 100000 };
+    setsockopt( receiver->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+
+    struct sockaddr_in6 address;
+    memset( &address, 0, sizeof(address) );
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons( SERVER_PORT );
+
+    if ( bind( receiver->fd, (struct sockaddr*) &address, sizeof(address) ) )
+    {
+        printf( "\nerror: could not bind udp socket to port %d: %s\n\n", SERVER_PORT, strerror(errno) );
+        return 1;
+    }
+
+    // steer each packet to the socket for the cpu it was received on, which is the thread pinned to that queue's cpu. attaching to one socket applies to the whole group
+
+    if ( receiver->queue_id == 0 )
+    {
+        struct sock_filter code[] =
+        {
+            { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+            { BPF_RET | BPF_A, 0, 0, 0 },
+        };
+
+        struct sock_fprog program = { sizeof(code) / sizeof(code[0]), code };
+
+        if ( setsockopt( receiver->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program) ) )
+        {
+            printf( "\nerror: could not attach reuseport steering program: %s\n\n", strerror(errno) );
+            return 1;
+        }
+    }
+
+    receiver->buffer = malloc( MAX_RECEIVE_BATCH_SIZE * RECVMMSG_BUFFER_SIZE );
+    if ( !receiver->buffer )
+    {
+        printf( "\nerror: could not allocate buffer\n\n" );
+        return 1;
+    }
+
+    return 0;
+}
+
+void * receiver_thread_recvmmsg( void * arg )
+{
+    struct receiver_t * receiver = (struct receiver_t*) arg;
+
+    pin_thread_to_cpu( receiver->queue_id );
+
+    struct mmsghdr messages[MAX_RECEIVE_BATCH_SIZE];
+    struct iovec iov[MAX_RECEIVE_BATCH_SIZE];
+    struct sockaddr_in6 from[MAX_RECEIVE_BATCH_SIZE];
+
+    while ( !quit && !receiver->stop )
+    {
+        const int batch_size = receive_batch_size;
+
+        memset( messages, 0, sizeof(messages) );
+
+        for ( int i = 0; i < batch_size; i++ )
+        {
+            iov[i].iov_base = receiver->buffer + i * RECVMMSG_BUFFER_SIZE;
+            iov[i].iov_len = RECVMMSG_BUFFER_SIZE;
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &from[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+
+        int received = recvmmsg( receiver->fd, messages, batch_size, MSG_WAITFORONE, NULL );
+        if ( received > 0 )
+        {
+            int received_ipv6 = 0;
+            int verified = 0;
+            for ( int i = 0; i < received; i++ )
+            {
+                if ( !IN6_IS_ADDR_V4MAPPED( &from[i].sin6_addr ) )
+                    received_ipv6++;
+
+                if ( verify_crc && !( messages[i].msg_hdr.msg_flags & MSG_TRUNC ) && payload_crc_matches( iov[i].iov_base, messages[i].msg_len ) )
+                    verified++;
+            }
+
+            __sync_fetch_and_add( &receiver->received_packets, received );
+            __sync_fetch_and_add( &receiver->received_ipv6_packets, received_ipv6 );
+
+            if ( verify_crc )
+            {
+                __sync_fetch_and_add( &receiver->verified_packets, verified );
+                __sync_fetch_and_add( &receiver->corrupt_packets, received - verified );
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void receiver_shutdown_socket( struct receiver_t * receiver )
+{
+    if ( receiver->fd > 0 )
+    {
+        close( receiver->fd );
+    }
+}
+
+int receiver_init_packet( struct receiver_t * receiver )
+{
+    receiver->fd = create_socket( AF_PACKET, SOCK_RAW, htons( ETH_P_ALL ) );
+    if ( receiver->fd < 0 )
+    {
+        printf( "\nerror: could not create packet socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    int value = TPACKET_V3;
+    if ( setsockopt( receiver->fd, SOL_PACKET, PACKET_VERSION, &value, sizeof(value) ) )
+    {
+        printf( "\nerror: could not set TPACKET_V3: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct tpacket_req3 request;
+    memset( &request, 0, sizeof(request) );
+    request.tp_block_size = PACKET_BLOCK_SIZE;
+    request.tp_block_nr = PACKET_NUM_BLOCKS;
+    request.tp_frame_size = PACKET_FRAME_SIZE;
+    request.tp_frame_nr = ( PACKET_BLOCK_SIZE / PACKET_FRAME_SIZE ) * PACKET_NUM_BLOCKS;
+    request.tp_retire_blk_tov = 10;     // milliseconds before a partly filled block is handed to us
+
+    if ( setsockopt( receiver->fd, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request) ) )
+    {
+        printf( "\nerror: could not create packet rx ring: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    receiver->packet_ring_bytes = request.tp_block_size * request.tp_block_nr;
+
+    receiver->packet_ring = mmap( NULL, receiver->packet_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, receiver->fd, 0 );
+    if ( receiver->packet_ring == MAP_FAILED )
+    {
+        receiver->packet_ring = NULL;
+        printf( "\nerror: could not map packet rx ring: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct sockaddr_ll address;
+    memset( &address, 0, sizeof(address) );
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons( ETH_P_ALL );
+    address.sll_ifindex = receiver->interface->interface_index;
+
+    if ( bind( receiver->fd, (struct sockaddr*) &address, sizeof(address) ) )
+    {
+        printf( "\nerror: could not bind packet socket to '%s': %s\n\n", receiver->interface->name, strerror(errno) );
+        return 1;
+    }
+
+    // all receivers for an interface share a fanout group, and packets go to the socket for the cpu they were received on
+
+    int fanout_id = ( getpid() + receiver->interface->interface_index ) & 0xFFFF;
+    value = fanout_id | ( PACKET_FANOUT_CPU << 16 );
+    if ( setsockopt( receiver->fd, SOL_PACKET, PACKET_FANOUT, &value, sizeof(value) ) )
+    {
+        printf( "\nerror: could not join packet fanout group: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    return 0;
+}
+
+void * receiver_thread_packet( void * arg )
+{
+    struct receiver_t * receiver = (struct receiver_t*) arg;
+
+    pin_thread_to_cpu( receiver->queue_id );
+
+    while ( !quit && !receiver->stop )
+    {
+        struct tpacket_block_desc * block = receiver->packet_ring + receiver->packet_block_index * PACKET_BLOCK_SIZE;
+
+        if ( ( __atomic_load_n( &block->hdr.bh1.block_status, __ATOMIC_ACQUIRE ) & TP_STATUS_USER ) == 0 )
+        {
+            struct pollfd fds;
+            fds.fd = receiver->fd;
+            fds.events = POLLIN | POLLERR;
+            fds.revents = 0;
+            poll( &fds, 1, 100 );
+            continue;
+        }
+
+        int num_packets = block->hdr.bh1.num_pkts;
+
+        struct tpacket3_hdr * header = (struct tpacket3_hdr*) ( (uint8_t*) block + block->hdr.bh1.offset_to_first_pkt );
+
+        int received = 0;
+        int received_ipv6 = 0;
+        int verified = 0;
+
+        for ( int i = 0; i < num_packets; i++ )
+        {
+            const uint8_t * payload;
+            int payload_bytes;
+            int family = server_packet_family( (uint8_t*) header + header->tp_mac, header->tp_snaplen, &payload, &payload_bytes );
+            if ( family >= 0 )
+                received++;
+            if ( family == FAMILY_IPV6 )
+                received_ipv6++;
+            if ( verify_crc && family >= 0 && payload_crc_matches( payload, payload_bytes ) )
+                verified++;
+
+            header = (struct tpacket3_hdr*) ( (uint8_t*) header + header->tp_next_offset );
+        }
+
+        __sync_fetch_and_add( &receiver->received_packets, received );
+        __sync_fetch_and_add( &receiver->received_ipv6_packets, received_ipv6 );
+
+        if ( verify_crc )
+        {
+            __sync_fetch_and_add( &receiver->verified_packets, verified );
+            __sync_fetch_and_add( &receiver->corrupt_packets, received - verified );
+        }
+
+        __atomic_store_n( &block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE );
+
+        receiver->packet_block_index = ( receiver->packet_block_index + 1 ) % PACKET_NUM_BLOCKS;
+    }
+
+    return NULL;
+}
+
+void receiver_shutdown_packet( struct receiver_t * receiver )
+{
+    if ( receiver->packet_ring )
+    {
+        munmap( receiver->packet_ring, receiver->packet_ring_bytes );
+    }
+
+    receiver_shutdown_socket( receiver );
+}
+
+int receiver_init_xsk( struct receiver_t * receiver )
+{
+    // unaligned, chunks go back to back at the smallest size the kernel allows, so the umem is half as big. they still divide a page,
+    // so none straddles two pages that might not be contiguous for dma
+
+    const int frame_size = unaligned_umem ? XSK_UNALIGNED_FRAME_SIZE : XSK_FRAME_SIZE;
+
+    const int buffer_size = XSK_NUM_FRAMES * frame_size;
+
+    if ( posix_memalign( &receiver->buffer, getpagesize(), buffer_size ) ) 
+    {
+        printf( "\nerror: could not allocate buffer\n\n" );
+        return 1;
+    }
+
+    struct xsk_umem_config umem_config;
+    memset( &umem_config, 0, sizeof(umem_config) );
+    umem_config.fill_size = XSK_NUM_FRAMES;
+    umem_config.comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+    umem_config.frame_size = frame_size;
+    umem_config.frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM;
+    umem_config.flags = unaligned_umem ? XDP_UMEM_UNALIGNED_CHUNK_FLAG : 0;
+
+    if ( xsk_umem__create( &receiver->umem, receiver->buffer, buffer_size, &receiver->fill_queue, &receiver->complete_queue, &umem_config ) )
+    {
+        printf( "\nerror: could not create umem\n\n" );
+        return 1;
+    }
+
+    struct xsk_socket_config xsk_config;
+    memset( &xsk_config, 0, sizeof(xsk_config) );
+    xsk_config.rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+    xsk_config.tx_size = 0;
+    xsk_config.bind_flags = ( ( engine == ENGINE_XSK_ZEROCOPY ) ? XDP_ZEROCOPY : XDP_COPY ) | XDP_USE_NEED_WAKEUP;
+    xsk_config.libbpf_flags = XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD;
+
+    if ( xsk_socket__create( &receiver->xsk, receiver->interface->name, receiver->queue_id, receiver->umem, &receiver->receive_queue, NULL, &xsk_config ) )
+    {
+        printf( "\nerror: could not create xsk socket [%s:%d]\n\n", receiver->interface->name, receiver->queue_id );
+        return 1;
+    }
+
+    receiver->fd = xsk_socket__fd( receiver->xsk );
+
+    if ( aead != AEAD_NONE )
+    {
+        receiver->aead_context = EVP_CIPHER_CTX_new();
+        if ( !receiver->aead_context || !EVP_DecryptInit_ex( receiver->aead_context, aead_cipher(), NULL, aead_key, NULL ) )
+        {
+            printf( "\nerror: could not set up %s\n\n", aead_names[aead] );
+            return 1;
+        }
+    }
+
+    // server_xdp redirects packets for this queue to us once we're in the xsks map
+
+    if ( xsk_socket__update_xskmap( receiver->xsk, receiver->interface->xsks_map_fd ) )
+    {
+        printf( "\nerror: could not add xsk socket to xsks map\n\n" );
+        return 1;
+    }
+
+    // give all frames to the kernel to receive into
+
+    uint32_t fill_index;
+    if ( xsk_ring_prod__reserve( &receiver->fill_queue, XSK_NUM_FRAMES, &fill_index ) != XSK_NUM_FRAMES )
+    {
+        printf( "\nerror: could not fill umem\n\n" );
+        return 1;
+    }
+
+    for ( int i = 0; i < XSK_NUM_FRAMES; i++ )
+    {
+        *xsk_ring_prod__fill_addr( &receiver->fill_queue, fill_index++ ) = i * frame_size;
+    }
+
+    xsk_ring_prod__submit( &receiver->fill_queue, XSK_NUM_FRAMES );
+
+    return 0;
+}
+
+void * receiver_thread_xsk( void * arg )
+{
+    struct receiver_t * receiver = (struct receiver_t*) arg;
+
+    pin_thread_to_cpu( receiver->queue_id );
+
+    while ( !quit && !receiver->stop )
+    {
+        uint32_t receive_index;
+
+        unsigned int received = xsk_ring_cons__peek( &receiver->receive_queue, receive_batch_size, &receive_index );
+
+        if ( received == 0 )
+        {
+            // nothing to do. let the driver know it needs to fill more packets, and wait for some
+
+            struct pollfd fds;
+            fds.fd = receiver->fd;
+            fds.events = POLLIN;
+            fds.revents = 0;
+            poll( &fds, 1, 100 );
+            continue;
+        }
+
+        // recycle frames back to the fill queue
+
+        uint32_t fill_index;
+        while ( xsk_ring_prod__reserve( &receiver->fill_queue, received, &fill_index ) != received )
+        {
+            if ( quit || receiver->stop )
+                return NULL;
+        }
+
+        // the kernel can't reuse a frame until we submit it, so it's safe to check the payload while filling
+
+        int checked = 0;
+        int verified = 0;
+
+        int num_sealed = 0;
+        uint8_t * sealed_payload[MAX_RECEIVE_BATCH_SIZE];
+        int sealed_payload_bytes[MAX_RECEIVE_BATCH_SIZE];
+
+        for ( int i = 0; i < received; i++ )
+        {
+            const struct xdp_desc * desc = xsk_ring_cons__rx_desc( &receiver->receive_queue, receive_index++ );
+
+            if ( verify_crc || aead != AEAD_NONE )
+            {
+                const uint8_t * payload;
+                int payload_bytes;
+                if ( server_packet_family( xsk_umem__get_data( receiver->buffer, xsk_umem__add_offset_to_addr( desc->addr ) ), desc->len, &payload, &payload_bytes ) >= 0 )
+                {
+                    checked++;
+                    if ( verify_crc && payload_crc_matches( payload, payload_bytes ) )
+                        verified++;
+
+                    sealed_payload[num_sealed] = (uint8_t*) payload;
+                    sealed_payload_bytes[num_sealed] = payload_bytes;
+                    num_sealed++;
+                }
+            }
+
+            *xsk_ring_prod__fill_addr( &receiver->fill_queue, fill_index++ ) = xsk_umem__extract_addr( desc->addr );
+        }
+
+        // decrypt the batch back to back, so the cipher code and key schedule stay hot. only this loop is timed
+
+        if ( aead != AEAD_NONE && num_sealed > 0 )
+        {
+            int opened = 0;
+
+            const uint64_t start = __rdtsc();
+
+            for ( int i = 0; i < num_sealed; i++ )
+            {
+                if ( aead_open( receiver->aead_context, sealed_payload[i], sealed_payload_bytes[i] ) )
+                    opened++;
+            }
+
+            const uint64_t cycles = __rdtsc() - start;
+
+            __sync_fetch_and_add( &receiver->aead_opened_packets, opened );
+            __sync_fetch_and_add( &receiver->aead_failed_packets, num_sealed - opened );
+            __sync_fetch_and_add( &receiver->aead_cycles, cycles );
+        }
+
+        xsk_ring_prod__submit( &receiver->fill_queue, received );
+
+        xsk_ring_cons__release( &receiver->receive_queue, received );
+
+        __sync_fetch_and_add( &receiver->received_packets, received );
+
+        if ( verify_crc )
+        {
+            __sync_fetch_and_add( &receiver->verified_packets, verified );
+            __sync_fetch_and_add( &receiver->corrupt_packets, checked - verified );
+        }
+
+        if ( xsk_ring_prod__needs_wakeup( &receiver->fill_queue ) )
+        {
+            recvfrom( receiver->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL );
+        }
+    }
+
+    return NULL;
+}
+
+void receiver_shutdown_xsk( struct receiver_t * receiver )
+{
+    EVP_CIPHER_CTX_free( receiver->aead_context );
+
+    if ( receiver->xsk )
+    {
+        xsk_socket__delete( receiver->xsk );
+    }
+
+    if ( receiver->umem )
+    {
+        xsk_umem__delete( receiver->umem );
+    }
+}
+
+const struct engine_t engines[ENGINE_NUM_ENGINES] =
+{
+    { "xdp",            true,   NULL,                       NULL,                       NULL },
+    { "recvmmsg",       false,  receiver_init_recvmmsg,     receiver_thread_recvmmsg,   receiver_shutdown_socket },
+    { "packet",         false,  receiver_init_packet,       receiver_thread_packet,     receiver_shutdown_packet },
+    { "xsk-copy",       true,   receiver_init_xsk,          receiver_thread_xsk,        receiver_shutdown_xsk },
+    { "xsk-zerocopy",   true,   receiver_init_xsk,          receiver_thread_xsk,        receiver_shutdown_xsk },
+};
+
+void server_shutdown( struct server_t * server )
+{
+    assert( server );
+
+    quit = true;
+
+    for ( int i = 0; i < MAX_INTERFACES * MAX_QUEUES; i++ )
+    {
+        if ( server->receiver[i] )
+        {
+            server_remove_receiver( server, i / MAX_QUEUES, i % MAX_QUEUES );
+        }
+    }
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        struct interface_t * interface = &server->interface[i];
+
+        if ( interface->program != NULL )
+        {
+            if ( interface->attached_native )
+            {
+                xdp_program__detach( interface->program, interface->interface_index, XDP_MODE_NATIVE, 0 );
+            }
+            if ( interface->attached_skb )
+            {
+                xdp_program__detach( interface->program, interface->interface_index, XDP_MODE_SKB, 0 );
+            }
+            xdp_program__close( interface->program );
+        }
+    }
+
+    free( server->vlan_keys );
+    free( server->vlan_values );
+}
+
+static struct server_t server;
+
+volatile bool reload_config;
+
+void reload_config_handler( int signal )
+{
+    (void) signal;
+    reload_config = true;
+}
+
+void interrupt_handler( int signal )
+{
+    (void) signal; quit = true;
+}
+
+void clean_shutdown_handler( int signal )
+{
+    (void) signal;
+    quit = true;
+}
+
+static void cleanup()
+{
+    server_shutdown( &server );
+    fflush( stdout );
+}
+
+static int read_config( const char * filename, int * queues )
+{
+    // one "name value" per line, with the same names as the command line options. only settings that can change while we're running are allowed
+
+    FILE * file = fopen( filename, "r" );
+    if ( !file )
+    {
+        printf( "\nerror: could not open config file '%s'\n\n", filename );
+        return 1;
+    }
+
+    int new_queues = *queues;
+    int new_receive_batch_size = receive_batch_size;
+
+    bool error = false;
+    int line_number = 0;
+    char line[256];
+
+    while ( !error && fgets( line, sizeof(line), file ) )
+    {
+        line_number++;
+
+        char * comment = strchr( line, '#' );
+        if ( comment )
+            *comment = '\0';
+
+        char name[64];
+        int value;
+
+        if ( sscanf( line, "%63s", name ) != 1 )
+            continue;
+
+        if ( sscanf( line, "%63s %d", name, &value ) != 2 )
+        {
+            printf( "\nerror: %s:%d: expected a name and a number\n\n", filename, line_number );
+            error = true;
+        }
+        else if ( strcmp( name, "queues" ) == 0 )       new_queues = value;
+        else if ( strcmp( name, "batch-size" ) == 0 )   new_receive_batch_size = value;
+        else
+        {
+            printf( "\nerror: %s:%d: unknown setting '%s'\n\n", filename, line_number, name );
+            error = true;
+        }
+    }
+
+    fclose( file );
+
+    if ( error )
+        return 1;
+
+    if ( new_queues < 1 || new_queues > MAX_QUEUES || new_receive_batch_size < 1 || new_receive_batch_size > MAX_RECEIVE_BATCH_SIZE )
+    {
+        printf( "\nerror: %s has invalid settings, keeping the old ones\n\n", filename );
+        return 1;
+    }
+
+    receive_batch_size = new_receive_batch_size;
+
+    *queues = new_queues;
+
+    return 0;
+}
+
+int get_interface_channels( const char * interface_name )
+{
+    // combined channels, or rx channels on nics that have separate ones. 0 if we can't tell
+
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( fd < 0 )
+        return 0;
+
+    struct ethtool_channels channels;
+    memset( &channels, 0, sizeof(channels) );
+    channels.cmd = ETHTOOL_GCHANNELS;
+
+    struct ifreq ifr;
+    memset( &ifr, 0, sizeof(ifr) );
+    strncpy( ifr.ifr_name, interface_name, IFNAMSIZ - 1 );
+    ifr.ifr_data = (void*) &channels;
+
+    int result = ioctl( fd, SIOCETHTOOL, &ifr );
+
+    close( fd );
+
+    if ( result )
+        return 0;
+
+    return channels.combined_count > 0 ? channels.combined_count : channels.rx_count;
+}
+
+static int server_get_channels()
+{
+    // the smallest channel count across our interfaces, or 0 if we can't tell
+
+    int channels = 0;
+
+    for ( int i = 0; i < num_interfaces; i++ )
+    {
+        int interface_channels = get_interface_channels( interface_names[i] );
+        if ( interface_channels <= 0 )
+            return 0;
+        if ( channels == 0 || interface_channels < channels )
+            channels = interface_channels;
+    }
+
+    return channels;
+}
+
+struct control_t
+{
+    int listen_fd;
+    int fd;                             // the current connection. we only talk to one controller at a time
+    char buffer[1024];
+    int buffer_bytes;
+};
+
+static int control_init( struct control_t * control, const char * path )
+{
+    memset( control, 0, sizeof(struct control_t) );
+    control->fd = -1;
+
+    control->listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+    if ( control->listen_fd < 0 )
+    {
+        printf( "\nerror: could not create control socket: %s\n\n", strerror(errno) );
+        return 1;
+    }
+
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof(address) );
+    address.sun_family = AF_UNIX;
+    strncpy( address.sun_path, path, sizeof(address.sun_path) - 1 );
+
+    unlink( path );
+
+    if ( bind( control->listen_fd, (struct sockaddr*) &address, sizeof(address) ) || listen( control->listen_fd, 4 ) )
+    {
+        printf( "\nerror: could not listen on control socket '%s': %s\n\n", path, strerror(errno) );
+        return 1;
+    }
+
+    return 0;
+}
+
+static void control_shutdown( struct control_t * control, const char * path )
+{
+    if ( control->fd >= 0 )
+        close( control->fd );
+
+    if ( control->listen_fd > 0 )
+    {
+        close( control->listen_fd );
+        unlink( path );
+    }
+}
+
+static void control_update( struct control_t * control, int timeout, void ( *command )( char * line, char * reply, int reply_bytes ) )
+{
+    // wait up to timeout milliseconds for a connection or a command. commands are one per line, and every command gets a one line reply
+
+    struct pollfd fds[2];
+    fds[0].fd = control->listen_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = control->fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if ( poll( fds, control->fd >= 0 ? 2 : 1, timeout ) <= 0 )
+        return;
+
+    if ( fds[0].revents & POLLIN )
+    {
+        int fd = accept( control->listen_fd, NULL, NULL );
+        if ( fd >= 0 )
+        {
+            if ( control->fd >= 0 )
+                close( control->fd );
+            control->fd = fd;
+            control->buffer_bytes = 0;
+            return;
+        }
+    }
+
+    if ( control->fd < 0 || ( fds[1].revents & ( POLLIN | POLLHUP | POLLERR ) ) == 0 )
+        return;
+
+    int bytes = read( control->fd, control->buffer + control->buffer_bytes, sizeof(control->buffer) - 1 - control->buffer_bytes );
+    if ( bytes <= 0 )
+    {
+        close( control->fd );
+        control->fd = -1;
+        return;
+    }
+
+    control->buffer_bytes += bytes;
+    control->buffer[control->buffer_bytes] = '\0';
+
+    char * line = control->buffer;
+    char * end;
+
+    while ( ( end = strchr( line, '\n' ) ) != NULL )
+    {
+        *end = '\0';
+
+        char reply[1024];
+        command( line, reply, sizeof(reply) - 1 );
+        strcat( reply, "\n" );
+
+        if ( write( control->fd, reply, strlen( reply ) ) < 0 )
+        {
+            close( control->fd );
+            control->fd = -1;
+            return;
+        }
+
+        line = end + 1;
+    }
+
+    // keep any partial line for next time. a line that fills the whole buffer is dropped
+
+    control->buffer_bytes = strlen( line );
+    if ( control->buffer_bytes == sizeof(control->buffer) - 1 )
+        control->buffer_bytes = 0;
+    memmove( control->buffer, line, control->buffer_bytes );
+}
+
+static void server_control_command( char * line, char * reply, int reply_bytes )
+{
+    char name[64];
+    long long value = 0;
+
+    int count = sscanf( line, "%63s %lld", name, &value );
+
+    if ( count < 1 )
+    {
+        snprintf( reply, reply_bytes, "error: empty command" );
+        return;
+    }
+
+    if ( strcmp( name, "start" ) == 0 )
+    {
+        // start a new measurement window
+
+        server.total_seconds = 0;
+        server.total_received_packets = 0;
+        server.total_cpu = 0.0;
+        server.total_softirq_cpu = 0.0;
+    }
+    else if ( strcmp( name, "stop" ) == 0 )
+    {
+        // summary of the measurement window since start
+
+        double seconds = server.total_seconds > 0 ? server.total_seconds : 1;
+        double cpu = server.total_cpu / seconds;
+        double softirq_cpu = server.total_softirq_cpu / seconds;
+        double cores = ( cpu + softirq_cpu ) / 100.0;
+        double packets_per_second = server.total_received_packets / seconds;
+
+        snprintf( reply, reply_bytes, "seconds %" PRIu64 " packets-per-second %.0f cpu %.1f softirq-cpu %.1f packets-per-second-per-core %.0f",
+            server.total_seconds, packets_per_second, cpu, softirq_cpu, cores > 0.0 ? packets_per_second / cores : 0.0 );
+        return;
+    }
+    else if ( strcmp( name, "stats" ) == 0 )
+    {
+        snprintf( reply, reply_bytes, "engine %s queues %d batch-size %d received %" PRIu64 " received-delta %" PRIu64 " cpu %.1f softirq-cpu %.1f corrupt %" PRIu64,
+            engines[engine].name, num_queues, receive_batch_size, server.previous_received_packets, server.last_received_delta, server.last_cpu, server.last_softirq_cpu, server.total_corrupt_packets );
+        return;
+    }
+    else if ( strcmp( name, "reload" ) == 0 && config_filename )
+    {
+        reload_config = true;
+    }
+    else if ( strcmp( name, "quit" ) == 0 )
+    {
+        quit = true;
+    }
+    else if ( count < 2 )
+    {
+        snprintf( reply, reply_bytes, "error: unknown command '%s'", name );
+        return;
+    }
+    else if ( strcmp( name, "batch-size" ) == 0 && value >= 1 && value <= MAX_RECEIVE_BATCH_SIZE )
+    {
+        receive_batch_size = value;
+    }
+    else if ( strcmp( name, "queues" ) == 0 && value >= 1 && value <= MAX_QUEUES )
+    {
+        if ( server_reconfigure( &server, value ) != 0 )
+            quit = true;
+    }
+    else
+    {
+        snprintf( reply, reply_bytes, "error: bad command '%s'", line );
+        return;
+    }
+
+    snprintf( reply, reply_bytes, "ok" );
+}
+
+static bool parse_hex_key( const char * string, uint8_t * key, int max_bytes, int * key_bytes )
+{
+    // hex bytes, with or without colons
+
+    int bytes = 0;
+
+    while ( *string )
+    {
+        if ( *string == ':' || isspace( *string ) )
+        {
+            string++;
+            continue;
+        }
+
+        unsigned int value;
+        if ( bytes == max_bytes || !isxdigit( string[0] ) || sscanf( string, "%2x", &value ) != 1 )
+            return false;
+
+        key[bytes++] = value;
+        string += isxdigit( string[1] ) ? 2 : 1;
+    }
+
+    *key_bytes = bytes;
+
+    return true;
+}
+
+static void print_usage()
+{
+    printf( "\nusage: server [options]\n\n" );
+    printf( "    --engine <xdp|recvmmsg|packet|xsk-copy|xsk-zerocopy>\n" );
+    printf( "                                   how packets are received (default: xdp)\n" );
+    printf( "    --interfaces <name,...>        network interfaces to receive on (default: %s)\n", INTERFACE_NAME );
+    printf( "    --queues <n>                   receive threads per interface, one per nic queue (default: 4)\n" );
+    printf( "    --batch-size <n>               packets per recvmmsg or xsk ring peek, up to %d (default: 64)\n", MAX_RECEIVE_BATCH_SIZE );
+    printf( "    --config <file>                read settings from this file at startup, and again on SIGHUP\n" );
+    printf( "    --follow-channels              add or remove receivers when the channel count on the nic changes\n" );
+    printf( "    --daemon <path>                also take commands on this unix socket\n" );
+    printf( "    --profiles <udp,...>           client profiles server_xdp takes from the kernel: udp, tcp-syn, icmp and dns. udp is always taken,\n" );
+    printf( "                                   the others only when listed, so pings and dns to this box still work otherwise (default: udp)\n" );
+    printf( "    --verify-crc                   check the crc32c tag from client --crc on every packet. not with the xdp engine\n" );
+    printf( "    --unaligned-umem               register the xsk umem unaligned, with %d byte chunks back to back. xsk engines only\n", XSK_UNALIGNED_FRAME_SIZE );
+    printf( "    --verify-udp-checksum          check udp checksums in server_xdp, counting valid, failed and none. not with recvmmsg or packet\n" );
+    printf( "    --aead <none|aes-128-gcm|aes-256-gcm|chacha20-poly1305>\n" );
+    printf( "                                   decrypt and authenticate payloads from client --aead, with the xsk engines (default: none)\n" );
+    printf( "    --aead-key <hex>               key for --aead, 16 bytes for aes-128-gcm, otherwise 32 (default: 00 01 02 ...)\n" );
+    printf( "\n" );
+}
+
+static int parse_options( int argc, char * argv[] )
+{
+    static struct option long_options[] =
+    {
+        { "engine",         required_argument, NULL, 'e' },
+        { "interfaces",     required_argument, NULL, 'I' },
+        { "queues",         required_argument, NULL, 'q' },
+        { "batch-size",     required_argument, NULL, 'z' },
+        { "config",         required_argument, NULL, 'F' },
+        { "follow-channels", no_argument,      NULL, 'f' },
+        { "daemon",         required_argument, NULL, 'd' },
+        { "profiles",       required_argument, NULL, 'p' },
+        { "verify-crc",     no_argument,       NULL, 'V' },
+        { "verify-udp-checksum", no_argument,  NULL, 'u' },
+        { "unaligned-umem", no_argument,       NULL, 'U' },
+        { "aead",           required_argument, NULL, 'a' },
+        { "aead-key",       required_argument, NULL, 'k' },
+        { "help",           no_argument,       NULL, 'h' },
+        { NULL,             0,                 NULL, 0   }
+    };
+
+    interface_names[0] = INTERFACE_NAME;
+
+    int c;
+    while ( ( c = getopt_long( argc, argv, "h", long_options, NULL ) ) != -1 )
+    {
+        switch ( c )
+        {
+            case 'e':
+            {
+                engine = -1;
+                for ( int i = 0; i < ENGINE_NUM_ENGINES; i++ )
+                {
+                    if ( strcmp( optarg, engines[i].name ) == 0 )
+                    {
+                        engine = i;
+                        break;
+                    }
+                }
+                if ( engine < 0 )
+                {
+                    printf( "\nerror: unknown engine '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'q': num_queues = atoi( optarg ); break;
+            case 'z': receive_batch_size = atoi( optarg ); break;
+            case 'F': config_filename = optarg; break;
+            case 'f': follow_channels = true; break;
+            case 'd': daemon_socket_path = optarg; break;
+            case 'V': verify_crc = true; break;
+            case 'u': verify_udp_checksum = true; break;
+            case 'U': unaligned_umem = true; break;
+
+            case 'a':
+            {
+                aead = -1;
+                for ( int i = 0; i < AEAD_NUM_TYPES; i++ )
+                {
+                    if ( strcmp( optarg, aead_names[i] ) == 0 )
+                        aead = i;
+                }
+                if ( aead < 0 )
+                {
+                    printf( "\nerror: unknown aead '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'k':
+            {
+                if ( !parse_hex_key( optarg, aead_key, AEAD_MAX_KEY_BYTES, &aead_key_bytes_given ) )
+                {
+                    printf( "\nerror: invalid aead key '%s'\n", optarg );
+                    print_usage();
+                    return 1;
+                }
+            }
+            break;
+
+            case 'p':
+            {
+                kinds = 1;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token; token = strtok_r( NULL, ",", &save ) )
+                {
+                    int kind = -1;
+                    for ( int i = 0; i < NUM_KINDS; i++ )
+                    {
+                        if ( strcmp( token, kind_names[i] ) == 0 )
+                            kind = i;
+                    }
+                    if ( kind < 0 )
+                    {
+                        printf( "\nerror: unknown profile '%s'\n", token );
+                        print_usage();
+                        return 1;
+                    }
+                    kinds |= 1 << kind;
+                }
+            }
+            break;
+
+            case 'I':
+            {
+                num_interfaces = 0;
+                char * save = NULL;
+                for ( char * token = strtok_r( optarg, ",", &save ); token; token = strtok_r( NULL, ",", &save ) )
+                {
+                    if ( num_interfaces == MAX_INTERFACES )
+                    {
+                        printf( "\nerror: too many interfaces. max is %d\n", MAX_INTERFACES );
+                        return 1;
+                    }
+                    interface_names[num_interfaces++] = token;
+                }
+            }
+            break;
+
+            default:
+                print_usage();
+                return 1;
+        }
+    }
+
+    if ( num_interfaces < 1 || num_queues < 1 || num_queues > MAX_QUEUES || receive_batch_size < 1 || receive_batch_size > MAX_RECEIVE_BATCH_SIZE )
+    {
+        print_usage();
+        return 1;
+    }
+
+    if ( verify_crc && !engines[engine].init )
+    {
+        printf( "\nerror: the xdp engine drops packets in server_xdp, so there are no payloads to verify. use an engine with receive threads\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( unaligned_umem && engine != ENGINE_XSK_COPY && engine != ENGINE_XSK_ZEROCOPY )
+    {
+        printf( "\nerror: --unaligned-umem needs an xsk engine, since the others don't have a umem\n" );
+        print_usage();
+        return 1;
+    }
+
+    if ( verify_udp_checksum && !engines[engine].attach_xdp )
+    {
+        printf( "\nerror: udp checksums are checked in server_xdp, which the %s engine doesn't attach\n", engines[engine].name );
+        print_usage();
+        return 1;
+    }
+
+    if ( aead != AEAD_NONE && ( ( engine != ENGINE_XSK_COPY && engine != ENGINE_XSK_ZEROCOPY ) || verify_crc || ( aead_key_bytes_given > 0 && aead_key_bytes_given != aead_key_bytes[aead] ) ) )
+    {
+        printf( "\nerror: --aead needs an xsk engine and a %d byte key, and replaces --verify-crc\n", aead_key_bytes[aead] );
+        print_usage();
+        return 1;
+    }
+
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    printf( "\n[server]\n" );
+
+    if ( parse_options( argc, argv ) != 0 )
+    {
+        return 1;
+    }
+
+    if ( config_filename && read_config( config_filename, &num_queues ) != 0 )
+    {
+        return 1;
+    }
+
+    printf( "engine: %s\n", engines[engine].name );
+
+    const char * crc32c_name = crc32c_init();
+
+    if ( verify_crc )
+        printf( "verifying crc32c tags with %s\n", crc32c_name );
+
+    if ( verify_udp_checksum )
+        printf( "verifying udp checksums in server_xdp\n" );
+
+    if ( kinds != 1 )
+    {
+        printf( "taking" );
+        for ( int i = 0; i < NUM_KINDS; i++ )
+        {
+            if ( kinds & ( 1 << i ) )
+                printf( " %s", kind_names[i] );
+        }
+        printf( " packets from the kernel\n" );
+    }
+
+    if ( aead != AEAD_NONE )
+    {
+        printf( "decrypting %s payloads\n", aead_names[aead] );
+
+        const uint64_t calibrate_tsc = __rdtsc();
+        struct timespec calibrate_start, calibrate_end;
+        clock_gettime( CLOCK_MONOTONIC, &calibrate_start );
+        usleep( 10000 );
+        clock_gettime( CLOCK_MONOTONIC, &calibrate_end );
+        tsc_per_millisecond = ( __rdtsc() - calibrate_tsc ) * 1000000.0 / ( ( calibrate_end.tv_sec - calibrate_start.tv_sec ) * 1000000000.0 + ( calibrate_end.tv_nsec - calibrate_start.tv_nsec ) );
+    }
+
+    signal( SIGINT,  interrupt_handler );
+    signal( SIGTERM, clean_shutdown_handler );
+    signal( SIGHUP,  config_filename ? reload_config_handler : clean_shutdown_handler );
+
+    if ( server_init( &server ) != 0 )
+    {
+        cleanup();
+        return 1;
+    }
+
+    struct control_t control;
+
+    if ( daemon_socket_path )
+    {
+        if ( control_init( &control, daemon_socket_path ) != 0 )
+        {
+            cleanup();
+            return 1;
+        }
+
+        printf( "waiting for commands on %s\n", daemon_socket_path );
+    }
+
+    while ( !quit )
+    {
+        if ( daemon_socket_path )
+        {
+            // answer commands while we wait for the next second
+
+            struct timespec start, now;
+            clock_gettime( CLOCK_MONOTONIC, &start );
+            do
+            {
+                control_update( &control, 10, server_control_command );
+                clock_gettime( CLOCK_MONOTONIC, &now );
+            }
+            while ( !quit && ( now.tv_sec - start.tv_sec ) * 1000000000LL + ( now.tv_nsec - start.tv_nsec ) < 1000000000LL );
+        }
+        else
+        {
+            usleep( 1000000 );
+        }
+
+        // SIGHUP re-reads the config file, and we follow 'ethtool -L' changes to the channel count
+
+        int new_num_queues = num_queues;
+
+        if ( reload_config )
+        {
+            reload_config = false;
+
+            if ( read_config( config_filename, &new_num_queues ) == 0 )
+            {
+                printf( "reloaded %s: batch size %d\n", config_filename, receive_batch_size );
+            }
+        }
+
+        if ( follow_channels )
+        {
+            int channels = server_get_channels();
+            if ( channels > 0 && channels <= MAX_QUEUES && channels != num_queues )
+            {
+                printf( "channel count changed to %d\n", channels );
+                new_num_queues = channels;
+            }
+        }
+
+        if ( server_reconfigure( &server, new_num_queues ) != 0 )
+        {
+            cleanup();
+            return 1;
+        }
+
+        uint64_t received_packets = server_get_received_packets( &server );
+
+        uint64_t received_delta = received_packets - server.previous_received_packets;
+
+        uint64_t cpu_microseconds = get_cpu_microseconds();
+
+        uint64_t softirq_ticks = get_softirq_ticks();
+
+        double cpu = ( cpu_microseconds - server.previous_cpu_microseconds ) / 10000.0;
+
+        double softirq_cpu = 100.0 * ( softirq_ticks - server.previous_softirq_ticks ) / sysconf( _SC_CLK_TCK );
+
+        // only seconds where we actually received something count towards the summary
+
+        if ( received_delta > 0 )
+        {
+            server.total_seconds++;
+            server.total_received_packets += received_delta;
+            server.total_cpu += cpu;
+            server.total_softirq_cpu += softirq_cpu;
+        }
+
+        if ( num_interfaces > 1 )
+        {
+            for ( int i = 0; i < num_interfaces; i++ )
+            {
+                struct interface_t * interface = &server.interface[i];
+                uint64_t interface_received_packets = server_get_interface_received_packets( &server, interface );
+                printf( "    %s received delta %" PRId64 "\n", interface->name, interface_received_packets - interface->previous_received_packets );
+                interface->previous_received_packets = interface_received_packets;
+            }
+        }
+
+        // only break out families once some ipv6 has turned up, so ipv4 only runs look the same as before
+
+        uint64_t family_received_packets[NUM_FAMILIES];
+        for ( int i = 0; i < NUM_FAMILIES; i++ )
+        {
+            family_received_packets[i] = server_get_family_received_packets( &server, i );
+        }
+
+        if ( family_received_packets[FAMILY_IPV6] > 0 )
+        {
+            printf( "    ipv4 received delta %" PRId64 ", ipv6 received delta %" PRId64 "\n",
+                family_received_packets[FAMILY_IPV4] - server.previous_family_received_packets[FAMILY_IPV4],
+                family_received_packets[FAMILY_IPV6] - server.previous_family_received_packets[FAMILY_IPV6] );
+        }
+
+        memcpy( server.previous_family_received_packets, family_received_packets, sizeof(family_received_packets) );
+
+        server_update_vlans( &server, true );
+
+        server_update_tunnels( &server, true );
+
+        server_update_kinds( &server, true );
+
+        server_update_crc( &server, true );
+
+        server_update_udp_checksums( &server, true );
+
+        server_update_aead( &server, true );
+
+        printf( "received delta %" PRId64 ", cpu %.1f%%, softirq cpu %.1f%%\n", received_delta, cpu, softirq_cpu );
+
+        server.last_received_delta = received_delta;
+        server.last_cpu = cpu;
+        server.last_softirq_cpu = softirq_cpu;
+
+        server.previous_received_packets = received_packets;
+        server.previous_cpu_microseconds = cpu_microseconds;
+        server.previous_softirq_ticks = softirq_ticks;
+    }
+
+    // summary for this engine. packets/sec per core counts both our cpu and softirq
+
+    if ( server.total_seconds > 0 )
+    {
+        double packets_per_second = (double) server.total_received_packets / server.total_seconds;
+        double cpu = server.total_cpu / server.total_seconds;
+        double softirq_cpu = server.total_softirq_cpu / server.total_seconds;
+        double cores = ( cpu + softirq_cpu ) / 100.0;
+
+        printf( "\n%-16s%16s%12s%16s%20s\n", "engine", "packets/sec", "cpu", "softirq cpu", "packets/sec/core" );
+        printf( "%-16s%16.0f%11.1f%%%15.1f%%%20.0f\n", engines[engine].name, packets_per_second, cpu, softirq_cpu, cores > 0.0 ? packets_per_second / cores : 0.0 );
+    }
+
+    if ( daemon_socket_path )
+    {
+        control_shutdown( &control, daemon_socket_path );
+    }
+
+    cleanup();
+
+    printf( "\n" );
+
+    return 0;
+}
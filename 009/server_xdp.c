@@ -0,0 +1,711 @@
+/*
+    UDP server XDP program
+
+    Counts IPv4 and IPv6 packets the client sends (UDP to port 40000, and if the server asks for them, TCP SYN to port 40000, ICMP echo requests and DNS queries), per kind, with up to two VLAN tags, optionally checks their UDP checksums, and decapsulates them from VXLAN, GRE or GUE, then redirects them to the AF_XDP socket for their queue if there is one, otherwise drops them
+
+    USAGE:
+
+        clang -Ilibbpf/src -g -O2 -target bpf -c server_xdp.c -o server_xdp.o
+        sudo cat /sys/kernel/debug/tracing/trace_pipe
+*/
+
+#include <linux/in.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/in6.h>
+#include <linux/udp.h>
+#include <linux/tcp.h>
+#include <linux/bpf.h>
+#include <linux/string.h>
+#include <bpf/bpf_helpers.h>
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define bpf_ntohs(x)        __builtin_bswap16(x)
+#define bpf_htons(x)        __builtin_bswap16(x)
+#define bpf_htonl(x)        __builtin_bswap32(x)
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define bpf_ntohs(x)        (x)
+#define bpf_htons(x)        (x)
+#define bpf_htonl(x)        (x)
+#else
+# error "Endianness detection needs to be set up for your compiler?!"
+#endif
+
+// #define DEBUG 1
+
+#if DEBUG
+#define debug_printf bpf_printk
+#else // #if DEBUG
+#define debug_printf(...) do { } while (0)
+#endif // #if DEBUG
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 1 );
+    __type( key, int );
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} received_packets_map SEC(".maps");
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_HASH );
+    __uint( max_entries, 64 );
+    __type( key, __u32 );                   // ingress interface index
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} interface_received_packets_map SEC(".maps");
+
+#define FAMILY_IPV4 0
+#define FAMILY_IPV6 1
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 2 );
+    __type( key, int );                     // FAMILY_IPV4 or FAMILY_IPV6
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} family_received_packets_map SEC(".maps");
+
+#define MAX_VLANS 4096
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, MAX_VLANS );
+    __type( key, __u32 );                   // innermost vlan id. 0 is untagged
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} vlan_received_packets_map SEC(".maps");
+
+#define TUNNEL_NONE 0
+#define TUNNEL_VXLAN 1
+#define TUNNEL_GRE 2
+#define TUNNEL_GUE 3
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 4 );
+    __type( key, __u32 );                   // TUNNEL_*
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} tunnel_received_packets_map SEC(".maps");
+
+#define KIND_UDP 0
+#define KIND_TCP_SYN 1
+#define KIND_ICMP_ECHO 2
+#define KIND_DNS 3
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 4 );
+    __type( key, __u32 );                   // KIND_*
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} kind_received_packets_map SEC(".maps");
+
+#define SETTING_VERIFY_UDP_CHECKSUM 0
+#define SETTING_KINDS 1                     // bit per KIND_*. anything but KIND_UDP is only taken from the kernel if its bit is set
+
+#define NUM_SETTINGS 2
+
+struct {
+    __uint( type, BPF_MAP_TYPE_ARRAY );
+    __uint( max_entries, NUM_SETTINGS );
+    __type( key, __u32 );                   // SETTING_*, written by the server at startup
+    __type( value, __u32 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} settings_map SEC(".maps");
+
+#define UDP_CHECKSUM_VALID 0
+#define UDP_CHECKSUM_FAILED 1
+#define UDP_CHECKSUM_NONE 2                 // zero over ipv4, or too long to check
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 3 );
+    __type( key, __u32 );                   // UDP_CHECKSUM_*
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} udp_checksum_packets_map SEC(".maps");
+
+#define CHECKSUM_TIME_PACKETS 0
+#define CHECKSUM_TIME_NS 1
+
+#define CHECKSUM_TIME_INTERVAL 64           // one checked packet in this many, on average, is timed
+
+struct {
+    __uint( type, BPF_MAP_TYPE_PERCPU_ARRAY );
+    __uint( max_entries, 2 );
+    __type( key, __u32 );                   // CHECKSUM_TIME_*
+    __type( value, __u64 );
+    __uint( pinning, LIBBPF_PIN_BY_NAME );
+} udp_checksum_time_map SEC(".maps");
+
+struct {
+    __uint( type, BPF_MAP_TYPE_XSKMAP );
+    __uint( max_entries, 64 );
+    __type( key, __u32 );                   // rx queue index
+    __type( value, __u32 );
+} xsks_map SEC(".maps");
+
+#define MAX_IPV6_EXTENSION_HEADERS 4
+
+#define MAX_VLAN_TAGS 2
+
+#define DNS_PORT 53
+#define DNS_HEADER_BYTES 12
+
+#define ICMP_ECHO_REQUEST 8
+#define ICMPV6_ECHO_REQUEST 128
+#define ICMP_ECHO_BYTES 8
+
+#define VLAN_ID_MASK 0x0FFF
+
+#define CHECKSUM_CHUNK_BYTES 256            // bpf_csum_diff takes up to 512 bytes, a multiple of 4, with a size the verifier knows
+
+#define MAX_CHECKSUM_CHUNKS 6               // enough for a 1500 byte mtu
+
+struct vlan_hdr
+{
+    __be16 h_vlan_TCI;
+    __be16 h_vlan_encapsulated_proto;
+};
+
+#define VXLAN_PORT 4789
+
+#define GUE_PORT 6080
+
+#define GRE_FLAG_CHECKSUM 0x8000
+#define GRE_FLAG_ROUTING 0x4000
+#define GRE_FLAG_KEY 0x2000
+#define GRE_FLAG_SEQUENCE 0x1000
+#define GRE_VERSION_MASK 0x0007
+
+struct gre_hdr
+{
+    __be16 flags;
+    __be16 protocol;
+};
+
+static __always_inline void * parse_ipv4( void * data, void * data_end, __u8 * l4_protocol )
+{
+    struct iphdr * ip = data;
+
+    if ( (void*)ip + sizeof(struct iphdr) > data_end )
+        return NULL;
+
+    *l4_protocol = ip->protocol;
+
+    return (void*) ip + sizeof(struct iphdr);
+}
+
+static __always_inline int is_ipv6_extension_header( __u8 next_header )
+{
+    return next_header == IPPROTO_HOPOPTS || next_header == IPPROTO_ROUTING || next_header == IPPROTO_DSTOPTS || next_header == IPPROTO_FRAGMENT;
+}
+
+static __always_inline void * parse_ipv6( void * data, void * data_end, __u8 * l4_protocol )
+{
+    struct ipv6hdr * ip6 = data;
+
+    if ( (void*)ip6 + sizeof(struct ipv6hdr) > data_end )
+        return NULL;
+
+    __u8 next_header = ip6->nexthdr;
+
+    void * header = (void*) ip6 + sizeof(struct ipv6hdr);
+
+    // skip a bounded number of extension headers, so the verifier can see the loop ends
+
+    #pragma unroll
+    for ( int i = 0; i < MAX_IPV6_EXTENSION_HEADERS; i++ )
+    {
+        if ( !is_ipv6_extension_header( next_header ) )
+            break;
+
+        struct ipv6_opt_hdr * option = header;
+
+        if ( (void*)option + 8 > data_end )
+            return NULL;
+
+        if ( next_header == IPPROTO_FRAGMENT )
+        {
+            // fragment headers are always 8 bytes. only the first fragment has the l4 header
+
+            __be16 fragment_offset = *(__be16*) ( header + 2 );
+            if ( fragment_offset & __constant_htons(0xFFF8) )
+                return NULL;
+
+            next_header = option->nexthdr;
+            header += 8;
+        }
+        else
+        {
+            next_header = option->nexthdr;
+            header += ( option->hdrlen + 1 ) * 8;
+        }
+    }
+
+    if ( is_ipv6_extension_header( next_header ) )
+        return NULL;
+
+    *l4_protocol = next_header;
+
+    return header;
+}
+
+static __always_inline int classify( void * l4, void * data_end, __u8 l4_protocol )
+{
+    // returns the KIND_* of a packet the client sends, or -1 if it's not one of ours
+
+    if ( l4_protocol == IPPROTO_UDP )
+    {
+        struct udphdr * udp = l4;
+
+        if ( (void*)udp + sizeof(struct udphdr) > data_end )
+            return -1;
+
+        if ( udp->dest == __constant_htons(40000) )
+            return KIND_UDP;
+
+        if ( udp->dest == __constant_htons(DNS_PORT) )
+        {
+            // standard query: qr bit clear and at least one question
+
+            __u8 * dns = (void*) udp + sizeof(struct udphdr);
+
+            if ( (void*)dns + DNS_HEADER_BYTES > data_end )
+                return -1;
+
+            if ( ( dns[2] & 0x80 ) == 0 && ( dns[4] | dns[5] ) != 0 )
+                return KIND_DNS;
+        }
+
+        return -1;
+    }
+
+    if ( l4_protocol == IPPROTO_TCP )
+    {
+        struct tcphdr * tcp = l4;
+
+        if ( (void*)tcp + sizeof(struct tcphdr) > data_end )
+            return -1;
+
+        if ( tcp->dest == __constant_htons(40000) && tcp->syn && !tcp->ack )
+            return KIND_TCP_SYN;
+
+        return -1;
+    }
+
+    if ( l4_protocol == IPPROTO_ICMP || l4_protocol == IPPROTO_ICMPV6 )
+    {
+        __u8 * icmp = l4;
+
+        if ( (void*)icmp + ICMP_ECHO_BYTES > data_end )
+            return -1;
+
+        if ( icmp[0] == ( l4_protocol == IPPROTO_ICMP ? ICMP_ECHO_REQUEST : ICMPV6_ECHO_REQUEST ) )
+            return KIND_ICMP_ECHO;
+
+        return -1;
+    }
+
+    return -1;
+}
+
+static __always_inline void * parse_tunnel( void * data, void * data_end, __be16 protocol, __u32 * tunnel, __be16 * inner_protocol )
+{
+    // outer ipv4, then gre, or udp to the vxlan or gue port. returns the inner ip header, or NULL if it's not a tunnel we know
+
+    if ( protocol != __constant_htons(ETH_P_IP) )
+        return NULL;
+
+    struct iphdr * ip = data;
+
+    if ( (void*)ip + sizeof(struct iphdr) > data_end )
+        return NULL;
+
+    if ( ip->protocol == IPPROTO_GRE )
+    {
+        struct gre_hdr * gre = (void*) ip + sizeof(struct iphdr);
+
+        if ( (void*)gre + sizeof(struct gre_hdr) > data_end )
+            return NULL;
+
+        __u16 flags = bpf_ntohs( gre->flags );
+
+        if ( flags & ( GRE_FLAG_ROUTING | GRE_VERSION_MASK ) )
+            return NULL;
+
+        // checksum, key and sequence number are 4 bytes each, if present
+
+        int gre_bytes = sizeof(struct gre_hdr);
+        if ( flags & GRE_FLAG_CHECKSUM )
+            gre_bytes += 4;
+        if ( flags & GRE_FLAG_KEY )
+            gre_bytes += 4;
+        if ( flags & GRE_FLAG_SEQUENCE )
+            gre_bytes += 4;
+
+        *tunnel = TUNNEL_GRE;
+        *inner_protocol = gre->protocol;
+        return (void*) gre + gre_bytes;
+    }
+
+    if ( ip->protocol != IPPROTO_UDP )
+        return NULL;
+
+    struct udphdr * udp = (void*) ip + sizeof(struct iphdr);
+
+    if ( (void*)udp + sizeof(struct udphdr) > data_end )
+        return NULL;
+
+    __u8 * tunnel_header = (void*) udp + sizeof(struct udphdr);
+
+    if ( udp->dest == __constant_htons(VXLAN_PORT) )
+    {
+        // 8 byte vxlan header with the vni present flag, then the inner ethernet header
+
+        struct ethhdr * inner_eth = (void*) tunnel_header + 8;
+
+        if ( (void*)inner_eth + sizeof(struct ethhdr) > data_end )
+            return NULL;
+
+        if ( ( tunnel_header[0] & 0x08 ) == 0 )
+            return NULL;
+
+        *tunnel = TUNNEL_VXLAN;
+        *inner_protocol = inner_eth->h_proto;
+        return (void*) inner_eth + sizeof(struct ethhdr);
+    }
+
+    if ( udp->dest == __constant_htons(GUE_PORT) )
+    {
+        // gue variant 0 data message: version and control bit zero, then the header length in words and the inner ip protocol
+
+        if ( (void*)tunnel_header + 4 > data_end )
+            return NULL;
+
+        if ( tunnel_header[0] & 0xE0 )
+            return NULL;
+
+        int gue_bytes = 4 + ( tunnel_header[0] & 0x1F ) * 4;
+
+        if ( tunnel_header[1] == IPPROTO_IPIP )
+            *inner_protocol = __constant_htons(ETH_P_IP);
+        else if ( tunnel_header[1] == IPPROTO_IPV6 )
+            *inner_protocol = __constant_htons(ETH_P_IPV6);
+        else
+            return NULL;
+
+        *tunnel = TUNNEL_GUE;
+        return (void*) tunnel_header + gue_bytes;
+    }
+
+    return NULL;
+}
+
+static __always_inline int udp_checksum( void * ip, void * l4, void * data_end, int family )
+{
+    // returns UDP_CHECKSUM_*. sums the pseudo header, then the udp header and payload in constant sized chunks, from udp->len rather
+    // than the end of the frame, which can have padding. a correct checksum makes the whole sum come to all ones
+
+    struct udphdr * udp = l4;
+
+    if ( (void*)udp + sizeof(struct udphdr) > data_end )
+        return UDP_CHECKSUM_FAILED;
+
+    if ( udp->check == 0 )
+        return ( family == FAMILY_IPV4 ) ? UDP_CHECKSUM_NONE : UDP_CHECKSUM_FAILED;
+
+    __u32 remaining = bpf_ntohs( udp->len );
+
+    if ( remaining < sizeof(struct udphdr) )
+        return UDP_CHECKSUM_FAILED;
+
+    __be32 pseudo = bpf_htonl( ( IPPROTO_UDP << 16 ) | remaining );
+
+    __s64 sum = bpf_csum_diff( 0, 0, &pseudo, 4, 0 );
+
+    if ( family == FAMILY_IPV4 )
+    {
+        struct iphdr * ipv4 = ip;
+        if ( (void*)ipv4 + sizeof(struct iphdr) > data_end )
+            return UDP_CHECKSUM_FAILED;
+        sum = bpf_csum_diff( 0, 0, (__be32*) &ipv4->saddr, 8, sum );
+    }
+    else
+    {
+        struct ipv6hdr * ipv6 = ip;
+        if ( (void*)ipv6 + sizeof(struct ipv6hdr) > data_end )
+            return UDP_CHECKSUM_FAILED;
+        sum = bpf_csum_diff( 0, 0, (__be32*) &ipv6->saddr, 32, sum );
+    }
+
+    void * p = udp;
+
+    #pragma unroll
+    for ( int i = 0; i < MAX_CHECKSUM_CHUNKS; i++ )
+    {
+        if ( remaining < CHECKSUM_CHUNK_BYTES )
+            break;
+        if ( p + CHECKSUM_CHUNK_BYTES > data_end )
+            return UDP_CHECKSUM_FAILED;
+        sum = bpf_csum_diff( 0, 0, p, CHECKSUM_CHUNK_BYTES, sum );
+        p += CHECKSUM_CHUNK_BYTES;
+        remaining -= CHECKSUM_CHUNK_BYTES;
+    }
+
+    if ( remaining >= CHECKSUM_CHUNK_BYTES )
+        return UDP_CHECKSUM_NONE;
+
+    // what's left is under a chunk. take it in halving sizes, so each call still has a constant size
+
+    #pragma unroll
+    for ( int bytes = CHECKSUM_CHUNK_BYTES / 2; bytes >= 4; bytes /= 2 )
+    {
+        if ( remaining >= bytes )
+        {
+            if ( p + bytes > data_end )
+                return UDP_CHECKSUM_FAILED;
+            sum = bpf_csum_diff( 0, 0, p, bytes, sum );
+            p += bytes;
+            remaining -= bytes;
+        }
+    }
+
+    // up to three bytes left, padded with zeros to a word
+
+    if ( remaining > 0 )
+    {
+        __u8 tail[4] = { 0, 0, 0, 0 };
+
+        #pragma unroll
+        for ( int i = 0; i < 3; i++ )
+        {
+            if ( i < remaining )
+            {
+                if ( p + i + 1 > data_end )
+                    return UDP_CHECKSUM_FAILED;
+                tail[i] = *(__u8*) ( p + i );
+            }
+        }
+
+        sum = bpf_csum_diff( 0, 0, (__be32*) tail, 4, sum );
+    }
+
+    __u32 folded = (__u32) sum;
+    folded = ( folded & 0xFFFF ) + ( folded >> 16 );
+    folded = ( folded & 0xFFFF ) + ( folded >> 16 );
+
+    return ( folded == 0xFFFF ) ? UDP_CHECKSUM_VALID : UDP_CHECKSUM_FAILED;
+}
+
+SEC("server_xdp") int server_xdp_filter( struct xdp_md *ctx ) 
+{ 
+    void * data = (void*) (long) ctx->data; 
+
+    void * data_end = (void*) (long) ctx->data_end; 
+
+    struct ethhdr * eth = data;
+
+    if ( (void*)eth + sizeof(struct ethhdr) > data_end )
+        return XDP_PASS;
+
+    // skip an 802.1Q tag, or an 802.1ad service tag followed by an 802.1Q tag. count by the innermost vlan id
+
+    __be16 protocol = eth->h_proto;
+
+    void * header = (void*)eth + sizeof(struct ethhdr);
+
+    __u32 vlan_id = 0;
+
+    #pragma unroll
+    for ( int i = 0; i < MAX_VLAN_TAGS; i++ )
+    {
+        if ( protocol != __constant_htons(ETH_P_8021Q) && protocol != __constant_htons(ETH_P_8021AD) )
+            break;
+
+        struct vlan_hdr * vlan = header;
+
+        if ( (void*)vlan + sizeof(struct vlan_hdr) > data_end )
+            return XDP_PASS;
+
+        vlan_id = bpf_ntohs( vlan->h_vlan_TCI ) & VLAN_ID_MASK;
+        protocol = vlan->h_vlan_encapsulated_proto;
+        header = (void*)vlan + sizeof(struct vlan_hdr);
+    }
+
+    // if it's a tunnel, look at the inner packet instead
+
+    __u32 tunnel = TUNNEL_NONE;
+
+    __be16 inner_protocol = 0;
+
+    void * inner = parse_tunnel( header, data_end, protocol, &tunnel, &inner_protocol );
+
+    if ( inner )
+    {
+        header = inner;
+        protocol = inner_protocol;
+    }
+
+    void * l4 = NULL;
+
+    __u8 l4_protocol = 0;
+
+    int family = FAMILY_IPV4;
+
+    if ( protocol == __constant_htons(ETH_P_IP) ) // IPV4
+    {
+        l4 = parse_ipv4( header, data_end, &l4_protocol );
+        family = FAMILY_IPV4;
+    }
+    else if ( protocol == __constant_htons(ETH_P_IPV6) ) // IPV6
+    {
+        l4 = parse_ipv6( header, data_end, &l4_protocol );
+        family = FAMILY_IPV6;
+    }
+
+    if ( !l4 )
+        return XDP_PASS;
+
+    int kind = classify( l4, data_end, l4_protocol );
+
+    if ( kind < 0 )
+        return XDP_PASS;
+
+    // pings, dns and tcp to this box are real traffic unless the server says it's running that client profile
+
+    if ( kind != KIND_UDP )
+    {
+        __u32 setting = SETTING_KINDS;
+        __u32 * kinds = (__u32*) bpf_map_lookup_elem( &settings_map, &setting );
+        if ( !kinds || !( *kinds & ( 1 << kind ) ) )
+            return XDP_PASS;
+    }
+
+    debug_printf( "server received %d byte packet of kind %d", (int) ( data_end - l4 ), kind );
+
+    // checking udp checksums is optional, so its cost can be measured on its own. do it before decap moves the headers
+
+    if ( kind == KIND_UDP || kind == KIND_DNS )
+    {
+        __u32 setting = SETTING_VERIFY_UDP_CHECKSUM;
+        __u32 * verify_udp_checksum = (__u32*) bpf_map_lookup_elem( &settings_map, &setting );
+        if ( verify_udp_checksum && *verify_udp_checksum )
+        {
+            // time a sample of packets, so the server can print what checking costs. the gap between two back to back clock reads is taken
+            // off, so the cost of reading the clock isn't counted
+
+            const int timed = ( bpf_get_prandom_u32() & ( CHECKSUM_TIME_INTERVAL - 1 ) ) == 0;
+
+            __u64 clock_start = 0;
+            __u64 checksum_start = 0;
+
+            if ( timed )
+            {
+                clock_start = bpf_ktime_get_ns();
+                checksum_start = bpf_ktime_get_ns();
+            }
+
+            __u32 result = udp_checksum( header, l4, data_end, family );
+
+            if ( timed )
+            {
+                const __u64 checksum_ns = bpf_ktime_get_ns() - checksum_start;
+                const __u64 clock_ns = checksum_start - clock_start;
+
+                __u32 key = CHECKSUM_TIME_PACKETS;
+                __u64 * time_packets = (__u64*) bpf_map_lookup_elem( &udp_checksum_time_map, &key );
+                key = CHECKSUM_TIME_NS;
+                __u64 * time_ns = (__u64*) bpf_map_lookup_elem( &udp_checksum_time_map, &key );
+                if ( time_packets && time_ns )
+                {
+                    __sync_fetch_and_add( time_packets, 1 );
+                    __sync_fetch_and_add( time_ns, ( checksum_ns > clock_ns ) ? checksum_ns - clock_ns : 0 );
+                }
+            }
+            __u64 * checksum_packets = (__u64*) bpf_map_lookup_elem( &udp_checksum_packets_map, &result );
+            if ( checksum_packets )
+            {
+                __sync_fetch_and_add( checksum_packets, 1 );
+            }
+        }
+    }
+
+    if ( tunnel != TUNNEL_NONE )
+    {
+        // strip the outer headers and any vlan tags, and put an ethernet header with the outer macs in front of the inner ip header
+
+        __u8 addresses[ETH_ALEN * 2];
+        __builtin_memcpy( addresses, eth, sizeof(addresses) );
+
+        int outer_bytes = header - data - sizeof(struct ethhdr);
+
+        if ( bpf_xdp_adjust_head( ctx, outer_bytes ) )
+            return XDP_PASS;
+
+        data = (void*) (long) ctx->data;
+        data_end = (void*) (long) ctx->data_end;
+        eth = data;
+
+        if ( (void*)eth + sizeof(struct ethhdr) > data_end )
+            return XDP_DROP;
+
+        __builtin_memcpy( eth, addresses, sizeof(addresses) );
+        eth->h_proto = protocol;
+    }
+
+    int zero = 0;
+    __u64 * packets_received = (__u64*) bpf_map_lookup_elem( &received_packets_map, &zero );
+    if ( packets_received ) 
+    {
+        __sync_fetch_and_add( packets_received, 1 );
+    }
+
+    __u64 * family_packets_received = (__u64*) bpf_map_lookup_elem( &family_received_packets_map, &family );
+    if ( family_packets_received )
+    {
+        __sync_fetch_and_add( family_packets_received, 1 );
+    }
+
+    __u32 kind_index = kind;
+    __u64 * kind_packets_received = (__u64*) bpf_map_lookup_elem( &kind_received_packets_map, &kind_index );
+    if ( kind_packets_received )
+    {
+        __sync_fetch_and_add( kind_packets_received, 1 );
+    }
+
+    __u64 * tunnel_packets_received = (__u64*) bpf_map_lookup_elem( &tunnel_received_packets_map, &tunnel );
+    if ( tunnel_packets_received )
+    {
+        __sync_fetch_and_add( tunnel_packets_received, 1 );
+    }
+
+    __u64 * vlan_packets_received = (__u64*) bpf_map_lookup_elem( &vlan_received_packets_map, &vlan_id );
+    if ( vlan_packets_received )
+    {
+        __sync_fetch_and_add( vlan_packets_received, 1 );
+    }
+
+    __u32 interface_index = ctx->ingress_ifindex;
+    __u64 * interface_packets_received = (__u64*) bpf_map_lookup_elem( &interface_received_packets_map, &interface_index );
+    if ( interface_packets_received )
+    {
+        __sync_fetch_and_add( interface_packets_received, 1 );
+    }
+    else
+    {
+        __u64 one = 1;
+        bpf_map_update_elem( &interface_received_packets_map, &interface_index, &one, BPF_NOEXIST );
+    }
+
+    return bpf_redirect_map( &xsks_map, ctx->rx_queue_index, XDP_DROP );
+}
+
+char _license[] SEC("license") = "GPL";